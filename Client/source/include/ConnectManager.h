@@ -22,7 +22,10 @@ public:
     static ConnectManager* Instance();
     void Login(const QString& IP,quint16 port);
     void Logout();
-    void Send(const QByteArray &buf);
+    // 已断开时返回false；队列已满时阻塞等待连接线程写出，不丢弃消息
+    bool Send(const QByteArray &buf);
+    bool Send(Buffer &&buf);          // 接管已序列化的消息，跨线程传递时不再拷贝
+    bool Send(CustomTcpFrame &&frame); // 各线程的消息在发送队列中排队，由连接线程批量写出后一次flush
     ConnectStatus connectStatus();
 
 public:
@@ -34,14 +37,14 @@ signals:
     void initialized();
     void signal_Login(const QString& IP,quint16 port);
     void signal_Logout();
-    void signal_Send(const QByteArray &buf);
+    void signal_FlushSend();
     void signal_PeerClose();
     void signal_RecvMessage(QByteArray& recv);
 
 public slots:
     void slots_Login(const QString& IP,quint16 port);
     void slots_Logout();
-    void slots_Send(const QByteArray &buf);
+    void slots_FlushSend();
     void slots_PeerClose();
     void slots_RecvMessage(QByteArray& recv);
 
@@ -52,6 +55,9 @@ private:
 private:
     ConnectStatus status = ConnectStatus::disconnect;
     CustomTcpSession* session=nullptr;
+
+    MPSCQueue<CustomTcpFrame> sendqueue{1024, QueueOverflowPolicy::Wait}; // 各线程入队，连接线程单独消费
+    std::atomic<bool> flushscheduled{false}; // 已投递slots_FlushSend且尚未开始处理
 };
 
 #define CONNECTMANAGER ConnectManager::Instance()
@@ -40,4 +40,13 @@ bool AnalysisMessagePackageFromBuffer(Buffer* buf, MessagePackage* package);
 
 // input package
 // output buf
-void GenerateMessagePackageToBuffer(MessagePackage* package, Buffer* buf);
+// headroom: 为之后添加的协议头预留的头部空间
+void GenerateMessagePackageToBuffer(MessagePackage* package, Buffer* buf, uint64_t headroom = 0);
+
+// 直接由json与流数据序列化，二者各只拷贝一次
+void GenerateMessagePackageToBuffer(const Buffer& jsondata, const Buffer& bufferdata, Buffer* buf, uint64_t headroom = 0);
+
+// input jsondata, bufferlen
+// output buf
+// 只写入消息头和json部分，bufferlen字节的流数据由调用方随后写入，或作为切片紧随其后发送
+void GenerateMessagePackageHeaderToBuffer(const Buffer& jsondata, uint64_t bufferlen, Buffer* buf, uint64_t headroom = 0);
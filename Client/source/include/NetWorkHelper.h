@@ -11,5 +11,9 @@ namespace NetWorkHelper
     bool SendMessagePackage(Buffer* buf);
     bool SendMessagePackage(json* json, Buffer* buf);
     bool SendMessagePackage(QJsonObject* jsonObj, Buffer* buf);
+    bool SendMessagePackage(json* json, Buffer&& buf);         // 接管buf，流数据不拷贝
+    bool SendMessagePackage(QJsonObject* jsonObj, Buffer&& buf);
     bool SendMessagePackage(MessagePackage* package);
+    bool SendMessageBuffers(const Buffer& jsondata, const Buffer& bufferdata); // 已序列化的json与流数据
+    bool SendMessageSlices(const Buffer& jsondata, Buffer&& bufferdata);       // 流数据以切片发送
 }
\ No newline at end of file
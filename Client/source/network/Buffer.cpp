@@ -1,5 +1,30 @@
 #include "Buffer.h"
 
+BufferSlice::BufferSlice()
+{
+}
+
+const char *BufferSlice::Data() const
+{
+    return _data;
+}
+
+uint64_t BufferSlice::Length() const
+{
+    return _length;
+}
+
+BufferSlice BufferSlice::Slice(uint64_t offset, uint64_t length) const
+{
+    BufferSlice slice;
+    if (offset >= _length)
+        return slice;
+    slice._storage = _storage;
+    slice._data = _data + offset;
+    slice._length = std::min(length, _length - offset);
+    return slice;
+}
+
 Buffer::Buffer()
 {
     _buf = nullptr;
@@ -19,7 +44,7 @@ Buffer::Buffer(Buffer &&other)
 
 Buffer::Buffer(const uint64_t length)
 {
-    _buf = new char[length + 1];
+    Reallocate(0, length);
     memset(_buf, '\0', length);
     _length = length;
 }
@@ -56,9 +81,12 @@ Buffer &Buffer::operator=(Buffer &&other)
 
 void Buffer::Release()
 {
-    SAFE_DELETE_ARRAY(_buf);
+    _storage.reset();
+    _buf = nullptr;
     _pos = 0;
     _length = 0;
+    _capacity = 0;
+    _reservedheadroom = 0;
 }
 
 void *Buffer::Data() const
@@ -85,37 +113,50 @@ uint64_t Buffer::Remain() const
     return std::max((uint64_t)0, _length - _pos);
 }
 
-void Buffer::CopyFromBuf(const Buffer &other)
+uint64_t Buffer::Capacity() const
 {
-    SAFE_DELETE_ARRAY(_buf);
+    return _capacity - Headroom();
+}
 
-    _buf = new char[other._length + 1];
-    memcpy(_buf, other._buf, other._length);
-    _length = other._length;
-    _pos = 0;
+uint64_t Buffer::Headroom() const
+{
+    return _buf ? _buf - _storage.get() : 0;
 }
 
-void Buffer::CopyFromBuf(const char *buf, uint64_t length)
+void Buffer::CopyFromBuf(const Buffer &other)
 {
-    SAFE_DELETE_ARRAY(_buf);
+    CopyFromBuf(other.Byte(), other.Length());
+}
 
+// 先分配再拷贝，源数据位于自身存储内时也不会读到已释放的内存
+void Buffer::CopyFromBuf(const char *buf, uint64_t length)
+{
     length = std::max((uint64_t)0, length);
 
-    _buf = new char[length + 1];
-    memcpy(_buf, buf, length);
+    std::shared_ptr<char[]> storage(new char[length + 1]);
+    if (length > 0)
+        memcpy(storage.get(), buf, length);
+
+    _storage = std::move(storage);
+    _buf = _storage.get();
+    _capacity = length;
     _length = length;
     _pos = 0;
 }
 
 void Buffer::QuoteFromBuf(Buffer &other)
 {
-    SAFE_DELETE_ARRAY(_buf);
-
+    this->_storage = std::move(other._storage);
     this->_buf = other._buf;
     this->_length = other._length;
+    this->_capacity = other._capacity;
+    this->_reservedheadroom = other._reservedheadroom;
     this->_pos = 0;
+    other._storage.reset();
     other._buf = nullptr;
     other._length = 0;
+    other._capacity = 0;
+    other._reservedheadroom = 0;
     other._pos = 0;
 }
 
@@ -133,16 +174,11 @@ uint64_t Buffer::Write(const void *buf, const uint64_t length)
 {
     if (length <= 0)
         return 0;
-    if (_pos + length > this->_length)
-    {
-        char *newBuf = new char[_pos + length + 1];
-        memcpy(newBuf, _buf, this->_length);
-        SAFE_DELETE_ARRAY(this->_buf);
-        this->_buf = newBuf;
-        this->_length = _pos + length;
-    }
+    uint64_t end = _pos + length;
+    EnsureTailroom(end > _length ? end - _length : 0);
     memcpy(_buf + _pos, buf, length);
-    _pos += length;
+    _length = std::max(_length, end);
+    _pos = end;
     return length;
 }
 
@@ -157,14 +193,8 @@ uint64_t Buffer::Append(Buffer &other, uint64_t length)
     if (truthAppend <= 0)
         return 0;
 
-    char *newBuf = new char[_length + truthAppend + 1];
-
-    if (_buf)
-        memcpy(newBuf, _buf, _length);
-    memcpy(newBuf + _length, other.Byte() + other.Position(), truthAppend);
-
-    SAFE_DELETE_ARRAY(_buf);
-    _buf = newBuf;
+    EnsureTailroom(truthAppend);
+    memcpy(_buf + _length, other.Byte() + other.Position(), truthAppend);
     _length = _length + truthAppend;
 
     other.Seek(other.Position() + truthAppend);
@@ -204,61 +234,105 @@ uint64_t Buffer::Seek(const uint64_t index)
     return _pos;
 }
 
+// 缩小时只修改长度，保留容量供之后的写入复用；扩大部分的内容未初始化
 void Buffer::ReSize(const uint64_t length)
 {
-    uint64_t truthlength = std::max(length, (uint64_t)0);
     if (length == _length)
         return;
 
-    char *oribuf = _buf;
-    uint64_t oriLength = _length;
-
-    _buf = new char[length + 1];
-    if (oribuf)
-        memcpy(_buf, oribuf, std::min(oriLength, length));
+    if (length > _length)
+        EnsureTailroom(length - _length);
     _length = length;
     _pos = 0;
-
-    SAFE_DELETE_ARRAY(oribuf);
 }
 
+// 只移动数据起点，被跳过的空间在之后追加空间不足时回收
 void Buffer::Shift(const uint64_t length)
 {
     uint64_t truthShift = std::min(_length, length);
     if (truthShift <= 0)
         return;
 
-    char *oribuf = _buf;
-    uint64_t oriLength = _length;
+    _buf += truthShift;
+    _length -= truthShift;
+    if (_length == 0)
+        _buf = _storage.get() + std::min(Headroom(), _reservedheadroom);
+    _pos = 0;
+}
 
-    uint64_t newlength = oriLength - truthShift;
-    _buf = new char[newlength + 1];
-    if (oribuf)
-        memcpy(_buf, oribuf + truthShift, newlength);
+void Buffer::Unshift(const void *buf, const uint64_t length)
+{
+    if (length <= 0)
+        return;
 
-    _length = newlength;
+    if (_storage.use_count() > 1 || Headroom() < length)
+        Reallocate(std::max(length, _reservedheadroom), Capacity());
+
+    _buf -= length;
+    memcpy(_buf, buf, length);
+    _length += length;
     _pos = 0;
+}
 
-    SAFE_DELETE_ARRAY(oribuf);
+void Buffer::Reserve(const uint64_t capacity)
+{
+    if (capacity <= Capacity())
+        return;
+    Reallocate(Headroom(), capacity);
 }
 
-void Buffer::Unshift(const void *buf, const uint64_t length)
+void Buffer::ReserveHeadroom(const uint64_t length)
 {
-    if (length <= 0)
+    _reservedheadroom = length;
+    if (Headroom() >= length)
         return;
+    Reallocate(length, Capacity());
+}
 
-    char *oribuf = _buf;
+BufferSlice Buffer::Slice(uint64_t offset, uint64_t length) const
+{
+    BufferSlice slice;
+    if (offset >= _length)
+        return slice;
+    slice._storage = _storage;
+    slice._data = _buf + offset;
+    slice._length = std::min(length, _length - offset);
+    return slice;
+}
 
-    uint64_t oriLength = _length;
-    uint64_t newLength = length + oriLength;
+void Buffer::EnsureTailroom(const uint64_t length)
+{
+    uint64_t headroom = Headroom();
+    uint64_t required = _length + length;
+    bool shared = _storage.use_count() > 1;
+    if (!shared && headroom + required <= _capacity)
+        return;
 
-    _buf = new char[newLength + 1];
-    memcpy(_buf, buf, length);
-    if (oribuf)
-        memcpy(_buf + length, oribuf, oriLength);
+    // Shift留下的空间不少于现有数据时原地前移，搬移的开销由回收的空间分摊
+    uint64_t keephead = std::min(headroom, _reservedheadroom);
+    if (!shared && headroom - keephead >= _length && keephead + required <= _capacity)
+    {
+        memmove(_storage.get() + keephead, _buf, _length);
+        _buf = _storage.get() + keephead;
+        return;
+    }
 
-    _length = newLength;
-    _pos = 0;
+    uint64_t datacapacity = _capacity - headroom;
+    if (required > datacapacity)
+        datacapacity = std::max(required, datacapacity * 2);
+    Reallocate(keephead, datacapacity);
+}
+
+// 总是分配新的存储并迁移数据，原存储仍被切片引用时由切片继续持有
+void Buffer::Reallocate(const uint64_t headroom, uint64_t datacapacity)
+{
+    datacapacity = std::max(datacapacity, _length);
+
+    std::shared_ptr<char[]> storage(new char[headroom + datacapacity + 1]);
+    if (_length > 0)
+        memcpy(storage.get() + headroom, _buf, _length);
 
-    SAFE_DELETE_ARRAY(oribuf);
+    _storage = std::move(storage);
+    _buf = _storage.get() + headroom;
+    _capacity = headroom + datacapacity;
 }
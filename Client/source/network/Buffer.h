@@ -2,6 +2,7 @@
 
 #include <string.h>
 #include <iostream>
+#include <memory>
 
 
 
@@ -11,6 +12,24 @@
 #define EXPORT_FUNC
 #endif
 
+// 共享Buffer存储的只读切片，以引用计数保持存储有效，不拷贝数据
+// 源Buffer之后通过自身接口写入时，若存储仍被切片共享会先复制出新的存储，切片内容不受影响
+class BufferSlice
+{
+public:
+    EXPORT_FUNC BufferSlice();
+
+    EXPORT_FUNC const char *Data() const;
+    EXPORT_FUNC uint64_t Length() const;
+    EXPORT_FUNC BufferSlice Slice(uint64_t offset, uint64_t length) const; // 超出范围的部分被截断
+
+private:
+    friend class Buffer;
+    std::shared_ptr<char[]> _storage;
+    const char *_data = nullptr;
+    uint64_t _length = 0;
+};
+
 class Buffer
 {
 
@@ -60,10 +79,27 @@ public:
     EXPORT_FUNC void Shift(const uint64_t length);                    // 从流的头部开始，移除该流的前n个字节
     EXPORT_FUNC void Unshift(const void *buf, const uint64_t length); // 在该流的头部添加n个字节
 
+    /**
+     * 存储按容量管理：数据前保留headroom，数据后保留tailroom，追加写入按倍数扩容，
+     * Shift只移动数据起点，Unshift在headroom足够时直接写入头部，均不再拷贝整段数据
+     */
+    EXPORT_FUNC uint64_t Capacity() const;                  // 不重新分配时数据可达到的长度
+    EXPORT_FUNC uint64_t Headroom() const;                  // 数据之前可直接Unshift的字节数
+    EXPORT_FUNC void Reserve(const uint64_t capacity);      // 预留容量，之后长度不超过capacity的写入与追加不再重新分配
+    EXPORT_FUNC void ReserveHeadroom(const uint64_t length); // 预留头部空间，扩容与Shift后也保持，用于之后Unshift协议头
+    EXPORT_FUNC BufferSlice Slice(uint64_t offset, uint64_t length) const; // 共享存储的切片，经Byte()直接改写的内容对切片可见
+
+private:
+    void EnsureTailroom(const uint64_t length); // 保证数据末尾之后还有length字节可写，且存储不被切片共享
+    void Reallocate(const uint64_t headroom, uint64_t datacapacity);
+
 private:
-    char *_buf = nullptr;
+    std::shared_ptr<char[]> _storage;
+    char *_buf = nullptr;          // 数据起点，位于_storage之内
     uint64_t _length = 0;
     uint64_t _pos = 0;
+    uint64_t _capacity = 0;        // 存储总大小，含headroom
+    uint64_t _reservedheadroom = 0;
 };
 
 #define SAFE_DELETE(x) \
@@ -1,8 +1,16 @@
 #include "CRC32Helper.h"
+#include <cstring>
 
-uint32_t CRC32Helper::crc_table[256];
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRC32_PCLMUL_ENABLE 1
+#include <immintrin.h>
+#endif
+
+uint32_t CRC32Helper::crc_table[8][256];
 bool CRC32Helper::table_initialized = false;
 
+constexpr size_t crc32_pclmul_min_len = 64; // 折叠需要至少4个128位分组，更短的数据查表更快
+
 void CRC32Helper::init_table()
 {
     for (uint32_t i = 0; i < 256; i++)
@@ -12,28 +20,182 @@ void CRC32Helper::init_table()
         {
             c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
         }
-        crc_table[i] = c;
+        crc_table[0][i] = c;
+    }
+    // crc_table[k][i]为字节i之后再跟k个零字节时的寄存器值
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        for (int k = 1; k < 8; k++)
+        {
+            uint32_t c = crc_table[k - 1][i];
+            crc_table[k][i] = crc_table[0][c & 0xFF] ^ (c >> 8);
+        }
     }
     table_initialized = true;
 }
 
-uint32_t CRC32Helper::calculate(const uint8_t *data, size_t len,
-                                uint32_t crc)
+uint32_t CRC32Helper::update_bytewise(uint32_t crc, const uint8_t *data, size_t len)
 {
-    if (!table_initialized)
+    for (size_t i = 0; i < len; i++)
     {
-        init_table();
+        crc = crc_table[0][(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
     }
+    return crc;
+}
 
-    crc = crc ^ 0xFFFFFFFF;
-    for (size_t i = 0; i < len; i++)
+// 每次处理8字节，按小端读取
+uint32_t CRC32Helper::update_slice8(uint32_t crc, const uint8_t *data, size_t len)
+{
+    while (len >= 8)
     {
-        crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        uint32_t one, two;
+        memcpy(&one, data, sizeof(one));
+        memcpy(&two, data + 4, sizeof(two));
+        one ^= crc;
+        crc = crc_table[7][one & 0xFF] ^
+              crc_table[6][(one >> 8) & 0xFF] ^
+              crc_table[5][(one >> 16) & 0xFF] ^
+              crc_table[4][one >> 24] ^
+              crc_table[3][two & 0xFF] ^
+              crc_table[2][(two >> 8) & 0xFF] ^
+              crc_table[1][(two >> 16) & 0xFF] ^
+              crc_table[0][two >> 24];
+        data += 8;
+        len -= 8;
     }
+    return update_bytewise(crc, data, len);
+}
+
+#ifdef CRC32_PCLMUL_ENABLE
+// 无进位乘法折叠，同时折叠4个128位分组，最后经Barrett约简得到32位结果
+// 常量为反射多项式0xEDB88320对应的x^(n) mod P(x)
+__attribute__((target("pclmul,sse4.1"))) static uint32_t crc32_fold_pclmul(uint32_t crc, const uint8_t *data, size_t len)
+{
+    alignas(16) static const uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596};
+    alignas(16) static const uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e};
+    alignas(16) static const uint64_t k5k0[] = {0x0163cd6124, 0x0000000000};
+    alignas(16) static const uint64_t poly[] = {0x01db710641, 0x01f7011641};
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i *)(data + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(data + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(data + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    x0 = _mm_load_si128((const __m128i *)k1k2);
+    data += 64;
+    len -= 64;
+
+    while (len >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128((const __m128i *)(data + 0x00));
+        y6 = _mm_loadu_si128((const __m128i *)(data + 0x10));
+        y7 = _mm_loadu_si128((const __m128i *)(data + 0x20));
+        y8 = _mm_loadu_si128((const __m128i *)(data + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        data += 64;
+        len -= 64;
+    }
+
+    // 4个分组折叠为1个
+    x0 = _mm_load_si128((const __m128i *)k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // 剩余的完整分组逐个折叠
+    while (len >= 16)
+    {
+        x2 = _mm_loadu_si128((const __m128i *)data);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        data += 16;
+        len -= 16;
+    }
+
+    // 128位折叠为64位
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett约简到32位
+    x0 = _mm_load_si128((const __m128i *)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return _mm_extract_epi32(x1, 1);
+}
+#endif
+
+uint32_t CRC32Helper::update_pclmul(uint32_t crc, const uint8_t *data, size_t len)
+{
+#ifdef CRC32_PCLMUL_ENABLE
+    return crc32_fold_pclmul(crc, data, len);
+#else
+    return update_slice8(crc, data, len);
+#endif
+}
+
+bool CRC32Helper::pclmul_supported()
+{
+#ifdef CRC32_PCLMUL_ENABLE
+    static const bool supported = []()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+    }();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+uint32_t CRC32Helper::calculate(const uint8_t *data, size_t len,
+                                uint32_t crc)
+{
+    crc = crc ^ 0xFFFFFFFF;
+    crc = update(crc, data, len);
     return crc ^ 0xFFFFFFFF;
 }
 
 // 增量计算（适用于流式数据）
+// 长数据的16字节对齐部分走PCLMULQDQ折叠，其余部分走slice-by-8，结果与逐字节查表一致
 uint32_t CRC32Helper::update(uint32_t crc, const uint8_t *data, size_t len)
 {
     if (!table_initialized)
@@ -41,9 +203,12 @@ uint32_t CRC32Helper::update(uint32_t crc, const uint8_t *data, size_t len)
         init_table();
     }
 
-    for (size_t i = 0; i < len; i++)
+    if (len >= crc32_pclmul_min_len && pclmul_supported())
     {
-        crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        size_t foldlen = len & ~(size_t)15;
+        crc = update_pclmul(crc, data, foldlen);
+        data += foldlen;
+        len -= foldlen;
     }
-    return crc;
+    return update_slice8(crc, data, len);
 }
@@ -4,11 +4,17 @@
 
 class CRC32Helper {
 private:
-    static uint32_t crc_table[256];
+    static uint32_t crc_table[8][256]; // slice-by-8查表，crc_table[0]为逐字节的基础表
     static bool table_initialized;
 
     static void init_table();
 
+    // 以下均只推进CRC寄存器，不做首尾取反
+    static uint32_t update_bytewise(uint32_t crc, const uint8_t* data, size_t len);
+    static uint32_t update_slice8(uint32_t crc, const uint8_t* data, size_t len);
+    static uint32_t update_pclmul(uint32_t crc, const uint8_t* data, size_t len); // len须不小于64且为16的倍数
+    static bool pclmul_supported();
+
 public:
     static uint32_t calculate(const uint8_t* data, size_t len,
                               uint32_t crc = 0xFFFFFFFF);
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <atomic>
+#include <utility>
+#include <cstddef>
+#include <new>
+#include <mutex>
+#include <condition_variable>
+
+// 协程帧的线程本地内存池：按64字节分级缓存释放的帧，稳定运行后创建协程不再分配内存；
+// 帧可能在其他线程结束，归还到释放线程的缓存，超过上限或超过1KB的帧直接交给全局堆
+class CoroutineFramePool
+{
+public:
+    static void *Allocate(std::size_t size)
+    {
+        std::size_t index = (size - 1) / Granularity;
+        if (Exiting())
+            return ::operator new(size);
+        Cache &cache = LocalCache();
+        if (index < ClassCount && cache.heads[index])
+        {
+            Block *block = cache.heads[index];
+            cache.heads[index] = block->next;
+            cache.counts[index]--;
+            return block;
+        }
+        return ::operator new(index < ClassCount ? (index + 1) * Granularity : size);
+    }
+
+    static void Deallocate(void *ptr, std::size_t size)
+    {
+        std::size_t index = (size - 1) / Granularity;
+        if (Exiting())
+        {
+            ::operator delete(ptr);
+            return;
+        }
+        Cache &cache = LocalCache();
+        if (index < ClassCount && cache.counts[index] < MaxCached)
+        {
+            Block *block = static_cast<Block *>(ptr);
+            block->next = cache.heads[index];
+            cache.heads[index] = block;
+            cache.counts[index]++;
+            return;
+        }
+        ::operator delete(ptr);
+    }
+
+private:
+    static constexpr std::size_t Granularity = 64;
+    static constexpr std::size_t ClassCount = 16;
+    static constexpr std::size_t MaxCached = 256; // 每级每线程最多缓存的帧数
+
+    struct Block
+    {
+        Block *next;
+    };
+
+    struct Cache
+    {
+        Block *heads[ClassCount] = {};
+        std::size_t counts[ClassCount] = {};
+
+        ~Cache()
+        {
+            Exiting() = true;
+            for (auto &head : heads)
+            {
+                while (head)
+                {
+                    Block *next = head->next;
+                    ::operator delete(head);
+                    head = next;
+                }
+            }
+        }
+    };
+
+    static Cache &LocalCache()
+    {
+        thread_local Cache cache;
+        return cache;
+    }
+
+    // 缓存析构后不能再访问，线程退出过程中分配与释放的帧直接交给全局堆；
+    // 该标志可平凡析构，在线程的整个退出过程中始终有效
+    static bool &Exiting()
+    {
+        thread_local bool exiting = false;
+        return exiting;
+    }
+};
+
+// 与服务端publicShare的Task<T>用法一致的协程任务；客户端没有协程调度器，创建后立即执行，
+// 在co_await处挂起，由唤醒方所在的线程恢复
+template <typename T>
+class Task;
+
+template <typename T>
+struct TaskPromiseBase
+{
+    enum State
+    {
+        RUNNING = 0,
+        AWAITED = 1,    // 已登记等待方，结束时恢复它
+        SYNCWAITED = 2, // 有线程在sync_wait中阻塞，结束时唤醒它
+        DETACHED = 3,   // Task先于协程结束被析构，结束时自行销毁
+        DONE = 4
+    };
+
+    // sync_wait时在调用方栈上创建，不等待的协程没有同步对象
+    struct SyncWaiter
+    {
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool done = false;
+    };
+
+    std::exception_ptr exception_;
+    std::coroutine_handle<> continuation_;
+    SyncWaiter *syncwaiter_ = nullptr;
+    std::atomic<int> state_{RUNNING};
+
+    static void *operator new(std::size_t size) { return CoroutineFramePool::Allocate(size); }
+    static void operator delete(void *ptr, std::size_t size) { CoroutineFramePool::Deallocate(ptr, size); }
+
+    std::suspend_never initial_suspend() noexcept { return {}; }
+
+    auto final_suspend() noexcept
+    {
+        struct FinalAwaiter
+        {
+            TaskPromiseBase *promise;
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> completed_coro) noexcept
+            {
+                int prev = promise->state_.exchange(DONE);
+                if (prev == AWAITED)
+                    return promise->continuation_;
+                if (prev == SYNCWAITED)
+                {
+                    // 持锁通知，等待方拿到锁之前不会返回并销毁waiter
+                    SyncWaiter *waiter = promise->syncwaiter_;
+                    std::lock_guard<std::mutex> lock(waiter->mtx);
+                    waiter->done = true;
+                    waiter->cv.notify_all();
+                }
+                if (prev == DETACHED)
+                    completed_coro.destroy();
+                return std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+        return FinalAwaiter{this};
+    }
+
+    void unhandled_exception() noexcept
+    {
+        exception_ = std::current_exception();
+    }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase<T>
+{
+    std::optional<T> value_;
+
+    Task<T> get_return_object() noexcept;
+
+    void return_value(T &&value) { value_.emplace(std::move(value)); }
+    void return_value(const T &value) { value_.emplace(value); }
+
+    T result()
+    {
+        if (this->exception_)
+            std::rethrow_exception(this->exception_);
+        return std::move(value_.value());
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase<void>
+{
+    Task<void> get_return_object() noexcept;
+
+    void return_void() noexcept {}
+
+    void result()
+    {
+        if (exception_)
+            std::rethrow_exception(exception_);
+    }
+};
+
+template <typename T>
+class Task
+{
+public:
+    using promise_type = TaskPromise<T>;
+    using value_type = T;
+
+    explicit Task(std::coroutine_handle<promise_type> coroutine) noexcept
+        : coroutine_(coroutine) {}
+
+    Task(Task &&other) noexcept
+        : coroutine_(std::exchange(other.coroutine_, nullptr)) {}
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            Detach();
+            coroutine_ = std::exchange(other.coroutine_, nullptr);
+        }
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    // 未完成的协程继续执行，结束时自行销毁
+    ~Task()
+    {
+        Detach();
+    }
+
+    auto operator co_await() const noexcept
+    {
+        struct TaskAwaiter
+        {
+            std::coroutine_handle<promise_type> coroutine_;
+
+            bool await_ready() noexcept
+            {
+                return coroutine_.promise().state_ == promise_type::DONE;
+            }
+
+            bool await_suspend(std::coroutine_handle<> awaiting_coroutine) noexcept
+            {
+                auto &promise = coroutine_.promise();
+                promise.continuation_ = awaiting_coroutine;
+                int expected = promise_type::RUNNING;
+                return promise.state_.compare_exchange_strong(expected, promise_type::AWAITED); // 已结束则不挂起
+            }
+
+            T await_resume()
+            {
+                return coroutine_.promise().result();
+            }
+        };
+        return TaskAwaiter{coroutine_};
+    }
+
+    // 阻塞到协程结束并取得结果，不能与co_await同时使用
+    T sync_wait()
+    {
+        auto &promise = coroutine_.promise();
+        typename promise_type::SyncWaiter waiter;
+        promise.syncwaiter_ = &waiter;
+        int expected = promise_type::RUNNING;
+        if (promise.state_.compare_exchange_strong(expected, promise_type::SYNCWAITED))
+        {
+            std::unique_lock<std::mutex> lock(waiter.mtx);
+            waiter.cv.wait(lock, [&waiter]()
+                           { return waiter.done; });
+        }
+        return promise.result();
+    }
+
+    bool is_done() const noexcept
+    {
+        return !coroutine_ || coroutine_.promise().state_ == promise_type::DONE;
+    }
+
+private:
+    void Detach()
+    {
+        if (!coroutine_)
+            return;
+        if (coroutine_.promise().state_.exchange(promise_type::DETACHED) == promise_type::DONE)
+            coroutine_.destroy();
+        coroutine_ = nullptr;
+    }
+
+private:
+    std::coroutine_handle<promise_type> coroutine_;
+};
+
+template <typename T>
+inline Task<T> TaskPromise<T>::get_return_object() noexcept
+{
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept
+{
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
@@ -1,6 +1,8 @@
 #include "FileIOHandler.h"
 #include <QDebug>
 #include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
 
 FileIOHandler::FileIOHandler()
     : mode_(READ_ONLY), offset_(0)
@@ -223,6 +225,22 @@ qint64 FileIOHandler::GetSize() const
     return size;
 }
 
+qint64 FileIOHandler::GetModifyTime() const
+{
+    mutex_.Enter();
+
+    qint64 mtime = 0;
+    try {
+        if (file_.isOpen()) {
+            mtime = QFileInfo(file_).lastModified().toMSecsSinceEpoch();
+        }
+    } catch (...) {
+    }
+
+    mutex_.Leave();
+    return mtime;
+}
+
 bool FileIOHandler::Truncate(qint64 size)
 {
     mutex_.Enter();
@@ -44,6 +44,7 @@ public:
 
     bool Flush();
     qint64 GetSize() const;
+    qint64 GetModifyTime() const; // 毫秒，失败时为0
     bool Truncate(qint64 size);
 
 public:
@@ -32,6 +32,8 @@ FileReqRecord::FileReqRecord(const QString& id, const QString& path, uint64_t& s
 FileTransManager::FileTransManager()
 {
 	FileIOHandler::CreateFolder(DownloadDir());
+	// 上传文件时根据RTT与吞吐动态调整分片大小
+	SetChunkSizePolicyType(ChunkSizePolicyType::ADAPTIVE);
 }
 
 FileTransManager* FileTransManager::Instance()
@@ -49,6 +51,10 @@ bool FileTransManager::ProcessMsg(const json& js, Buffer& buf)
 		AckTaskRes(js);
 		return true;
 		break;
+	case 5003:
+		AckFileRange(js, buf);
+		return true;
+		break;
 	default:
 		return DistributeMsg(js, buf);
 		break;
@@ -248,6 +254,59 @@ void FileTransManager::ReqDownloadFile(const QString& fileid)
 	NetWorkHelper::SendMessagePackage(&js);
 }
 
+void FileTransManager::ReqFileRange(const QString& fileid, uint64_t offset, uint64_t length, FileRangeCallBack callback)
+{
+	QString requestid = QUuid::createUuid().toString();
+	m_rangereqs.Insert(requestid, callback);
+
+	json js;
+	js["command"] = 4003;
+	js["fileid"] = fileid.toStdString();
+	js["requestid"] = requestid.toStdString();
+	js["offset"] = offset;
+	js["length"] = length;
+	js["jwt"] = USERINFOMODEL->userjwt().toStdString();
+
+	if (!NetWorkHelper::SendMessagePackage(&js))
+	{
+		m_rangereqs.Erase(requestid);
+		if (callback)
+			callback(false, offset, 0, Buffer());
+	}
+}
+
+void FileTransManager::AckFileRange(const json& js, Buffer& buf)
+{
+	if (!js.contains("requestid") || !js.at("requestid").is_string())
+		return;
+
+	QString requestid = QString::fromStdString(js["requestid"]);
+	FileRangeCallBack callback;
+	if (!m_rangereqs.Find(requestid, callback))
+		return;
+	m_rangereqs.Erase(requestid);
+
+	bool success = js.contains("result") && js.at("result").is_number() && js["result"] == 1 &&
+		js.contains("offset") && js.at("offset").is_number_unsigned() &&
+		js.contains("length") && js.at("length").is_number_unsigned() &&
+		js.contains("filesize") && js.at("filesize").is_number_unsigned();
+	uint64_t offset = success ? (uint64_t)js["offset"] : 0;
+	uint64_t length = success ? (uint64_t)js["length"] : 0;
+	uint64_t filesize = success ? (uint64_t)js["filesize"] : 0;
+	if (success && buf.Remain() < length)
+		success = false;
+
+	if (!callback)
+		return;
+	if (!success)
+	{
+		callback(false, offset, filesize, Buffer());
+		return;
+	}
+	Buffer data(buf.Byte() + buf.Position(), length);
+	callback(true, offset, filesize, data);
+}
+
 void FileTransManager::InterruptTask(const QString& fileid)
 {
 	FileTransTaskContent* content = nullptr;
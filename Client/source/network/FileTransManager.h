@@ -33,6 +33,9 @@ struct FileReqRecord
 	FileReqRecord(const QString& id, const QString& path, uint64_t& size, const QString& md5);
 };
 
+// 区间读取的结果，success为false时data为空；在网络线程中回调
+using FileRangeCallBack = std::function<void(bool success, uint64_t offset, uint64_t filesize, const Buffer& data)>;
+
 class FileTransManager
 {
 public:
@@ -45,6 +48,7 @@ public:
 
 protected:
 	void AckTaskRes(const json& js);
+	void AckFileRange(const json& js, Buffer& buf);
 
 public:
 	void OnUploadFinish(FileTransferUploadTask* task);
@@ -62,6 +66,9 @@ public:
 
 	void ReqUploadFile(const QString& fileid);
 	void ReqDownloadFile(const QString& fileid);
+	// 读取服务器上文件的[offset, offset + length)，供预览窗口读取文件头或媒体跳转
+	// 服务器单次最多返回4MB，实际返回的长度以回调中data的长度为准
+	void ReqFileRange(const QString& fileid, uint64_t offset, uint64_t length, FileRangeCallBack callback);
 
 	void InterruptTask(const QString& fileid);
 
@@ -78,6 +85,7 @@ private:
 private:
 	SafeMap<QString, FileTransTaskContent*> m_tasks; // taskid->content
 	SafeMap<QString, FileReqRecord*> m_reqrecords; // taskid->record
+	SafeMap<QString, FileRangeCallBack> m_rangereqs; // requestid->callback
 };
 
 #define FILETRANSMANAGER FileTransManager::Instance()
@@ -2,6 +2,7 @@
 #include "ConnectManager.h"
 #include "NetWorkHelper.h"
 #include "MD5Helper.h"
+#include <QSaveFile>
 
 void displayTransferProgress(uint64_t totalSize, const std::vector<FileTransferChunkInfo>& transferredChunks, int barWidth = 160)
 {
@@ -81,6 +82,23 @@ void displayTransferProgress(uint64_t totalSize, const std::vector<FileTransferC
 	// sleep(1);
 }
 
+// __chunks文件格式: [ChunkFileHeader] 之后每接收一个分片追加一条ChunkFileRecord
+// 打开时合并全部记录并重写，避免文件无限增长
+constexpr uint32_t ChunkFileMagic = 0x4B4E4843; // "CHNK"
+constexpr uint32_t ChunkFileVersion = 1;
+
+struct ChunkFileHeader
+{
+	uint32_t magic = ChunkFileMagic;
+	uint32_t version = ChunkFileVersion;
+};
+
+struct ChunkFileRecord
+{
+	uint64_t range_left;
+	uint64_t range_right;
+};
+
 QString getChunkFilePath(const QString& filepath)
 {
 	return filepath + "__chunks";
@@ -96,6 +114,37 @@ MD5CheckPoint::MD5CheckPoint()
     progress = 0;
 }
 
+constexpr uint32_t MD5CheckPointMagic = 0x4B48434D; // "MCHK"
+constexpr uint32_t MD5CheckPointVersion = 1;
+
+MD5CheckPointRecord::MD5CheckPointRecord()
+{
+    memset(this, 0, sizeof(MD5CheckPointRecord)); // 填充字节也参与校验，需要清零
+    magic = MD5CheckPointMagic;
+    version = MD5CheckPointVersion;
+}
+
+// FNV-1a
+uint32_t MD5CheckPointRecord::CalcChecksum() const
+{
+    const uint8_t *ptr = reinterpret_cast<const uint8_t *>(this);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(MD5CheckPointRecord, checksum); i++)
+    {
+        hash ^= ptr[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool MD5CheckPointRecord::IsValid() const
+{
+    return magic == MD5CheckPointMagic &&
+           version == MD5CheckPointVersion &&
+           cachesize < sizeof(cache) &&
+           checksum == CalcChecksum();
+}
+
 FileTransferDownLoadTask::FileTransferDownLoadTask(const QString& taskid, const QString& filepath, const QString& md5)
     : FileTransferTask(taskid, filepath, md5)
 {
@@ -134,95 +183,57 @@ void FileTransferDownLoadTask::InterruptTrans()
 }
 
 
+// 通过QSaveFile先写临时文件再替换，保证__check文件要么是旧记录要么是完整的新记录
 void FileTransferDownLoadTask::WriteToMD5CheckFile()
 {
     uint32_t curprogress = Progress();
     uint32_t lastcheckprogress = _MD5CheckPoint.progress;
     if (curprogress - lastcheckprogress < 20)
         return;
-    else
-    {
-        json js_checkfile;
-        {
-            json js_md5checkpoint;
-            {
-                json js_md5state;
-                std::shared_ptr<MD5SnapShot> shot = std::make_shared<MD5SnapShot>(_asyncmd5.SnapShot());
-                js_md5state["status0"] = shot->status[0];
-                js_md5state["status1"] = shot->status[1];
-                js_md5state["status2"] = shot->status[2];
-                js_md5state["status3"] = shot->status[3];
-                js_md5state["count"] = shot->count;
-
-                {
-                    json cache;
-                    {
-                        json data_array = json::array();
-
-                        uint8_t *ptr = (uint8_t *)(shot->cacheBuffer.Data());
-                        uint64_t length = shot->cacheBuffer.Length();
-                        for (uint64_t i = 0; i < length; i++)
-                            data_array.push_back(ptr[i]);
-
-                        cache["data"] = data_array;
-                        cache["size"] = length;
-                    }
-                    js_md5state["cache"] = cache;
-                }
-
-                js_md5state["isfinish"] = shot->isfinish;
-                js_md5state["md5string"] = shot->md5string;
-
-                _MD5CheckPoint.progress = curprogress;
-                _MD5CheckPoint.snap = shot;
-
-                js_md5checkpoint["md5state"] = js_md5state;
-                js_md5checkpoint["checkprogress"] = curprogress;
-            }
-            js_checkfile["md5checkpoint"] = js_md5checkpoint;
-        }
-
-        Buffer buf(js_checkfile.dump());
-
-        QString CheckPointFilePath = getMD5CheckPointFilePath(file_path);
-        FileIOHandler md5checkfile_io(CheckPointFilePath, FileIOHandler::OpenMode::WRITE_ONLY);
-
-        md5checkfile_io.Seek(0);
-        long writecount = md5checkfile_io.Write(buf);
-        if (writecount != buf.Length())
-        {
-            FileIOHandler::Remove(CheckPointFilePath);
-            return;
-        }
 
-        if (md5checkfile_io.GetSize() > buf.Length())
-            md5checkfile_io.Truncate(buf.Length());
+    std::shared_ptr<MD5SnapShot> shot = std::make_shared<MD5SnapShot>(_asyncmd5.SnapShot());
+    if (shot->cacheBuffer.Length() >= sizeof(MD5CheckPointRecord::cache))
+        return;
 
+    MD5CheckPointRecord record;
+    record.progress = curprogress;
+    memcpy(record.status, shot->status, sizeof(record.status));
+    record.count = shot->count;
+    record.cachesize = shot->cacheBuffer.Length();
+    memcpy(record.cache, shot->cacheBuffer.Data(), record.cachesize);
+    record.isfinish = shot->isfinish ? 1 : 0;
+    memcpy(record.md5string, shot->md5string.data(), std::min(shot->md5string.size(), sizeof(record.md5string)));
+    record.checksum = record.CalcChecksum();
+
+    QSaveFile md5checkfile(getMD5CheckPointFilePath(file_path));
+    if (!md5checkfile.open(QIODevice::WriteOnly))
+        return;
+    if (md5checkfile.write((const char *)&record, sizeof(record)) != sizeof(record))
+    {
+        md5checkfile.cancelWriting();
         return;
     }
+    if (!md5checkfile.commit())
+        return;
+
+    _MD5CheckPoint.progress = curprogress;
+    _MD5CheckPoint.snap = shot;
 }
 
+// 以当前chunk_map重写整个__chunks文件
 bool FileTransferDownLoadTask::WriteToChunkFile()
 {
 	if (!IsChunkFileEnable)
 		return false;
 
-	json js_chunkfile;
-	json js_chunkmap = json::array();
+	Buffer buf;
+	ChunkFileHeader header;
+	buf.Write(&header, sizeof(header));
 	for (auto& chunkinfo : chunk_map)
 	{
-		json js_info;
-		js_info["index"] = chunkinfo.index;
-
-		json js_range = json::array();
-		js_range.emplace_back(chunkinfo.range_left);
-		js_range.emplace_back(chunkinfo.range_right);
-		js_info["range"] = js_range;
-		js_chunkmap.emplace_back(js_info);
+		ChunkFileRecord record{ chunkinfo.range_left, chunkinfo.range_right };
+		buf.Write(&record, sizeof(record));
 	}
-	js_chunkfile["chunk_map"] = js_chunkmap;
-
-	Buffer buf(js_chunkfile.dump());
 
 	chunkfile_io.Seek();
 	long writecount = chunkfile_io.Write(buf);
@@ -235,6 +246,38 @@ bool FileTransferDownLoadTask::WriteToChunkFile()
 	return true;
 }
 
+// 每个分片只追加一条定长记录
+bool FileTransferDownLoadTask::AppendToChunkFile(uint64_t range_left, uint64_t range_right)
+{
+	if (!IsChunkFileEnable)
+		return false;
+
+	ChunkFileRecord record{ range_left, range_right };
+	chunkfile_io.Seek(chunkfile_io.GetSize());
+	return chunkfile_io.Write((const char*)&record, sizeof(record)) == sizeof(record);
+}
+
+void FileTransferDownLoadTask::ParseChunkMapEncoding(const json& js)
+{
+	IsBinaryChunkMap = js.contains("chunkmap_encoding") && js.at("chunkmap_encoding").is_number_unsigned() && js["chunkmap_encoding"] == ChunkMapEncodingBinary;
+}
+
+// 发送端提供的块大小与本端一致时才接受分片哈希，否则回退到MD5
+void FileTransferDownLoadTask::ParseChunkHash(const json& js)
+{
+	IsChunkHash = false;
+	if (!js.contains("chunk_hash") || !js.at("chunk_hash").is_number_unsigned() || js["chunk_hash"] != ChunkHashXXH64)
+		return;
+	if (!js.contains("merkle_block") || !js.at("merkle_block").is_number_unsigned() || js["merkle_block"] != MerkleBlockSize)
+		return;
+	if (!js.contains("merkle_root") || !js.at("merkle_root").is_string() ||
+		!ChunkHashHelper::FromHex(js.at("merkle_root").get<std::string>(), merkle_root))
+		return;
+
+	merkle_tree.Reset(file_size, MerkleBlockSize);
+	IsChunkHash = true;
+}
+
 bool FileTransferDownLoadTask::ParseChunkMap(const json& js)
 {
 	bool parseresult = true;
@@ -278,83 +321,23 @@ bool FileTransferDownLoadTask::ParseChunkMap(const json& js)
 	return parseresult;
 }
 
-bool FileTransferDownLoadTask::ParseMd5CheckPoint(const json &js)
+bool FileTransferDownLoadTask::ParseMd5CheckPoint(const MD5CheckPointRecord &record)
 {
-    bool success = true;
-    if (js.contains("md5checkpoint") && js.at("md5checkpoint").is_object())
-    {
-        json js_md5checkpoint = js["md5checkpoint"];
-        if (js_md5checkpoint.contains("md5state") && js_md5checkpoint.at("md5state").is_object() &&
-            js_md5checkpoint.contains("checkprogress") && js_md5checkpoint.at("checkprogress").is_number_unsigned())
-        {
-            std::shared_ptr<MD5SnapShot> shot = std::make_shared<MD5SnapShot>();
-            auto js_md5state = js_md5checkpoint["md5state"];
-            uint32_t progress = js_md5checkpoint["checkprogress"];
-
-            static std::vector<std::string> status_list{"status0", "status1", "status2", "status3"};
-
-            if (success)
-            {
-                for (int i = 0; i < status_list.size(); i++)
-                {
-                    if (js_md5state.contains(status_list[i]) && js_md5state.at(status_list[i]).is_number_unsigned())
-                        shot->status[i] = js_md5state[status_list[i]];
-                    else
-                    {
-                        success = false;
-                        break;
-                    }
-                }
-            }
-            if (success)
-            {
-                if (js_md5state.contains("count") && js_md5state.at("count").is_number_unsigned())
-                    shot->count = js_md5state["count"];
-                else
-                    success = false;
-            }
-            if (success)
-            {
-                if (js_md5state.contains("cache") && js_md5state.at("cache").is_object())
-                {
-                    json js_cache = js_md5state["cache"];
-                    if (js_cache.contains("data") && js_cache.at("data").is_array() && js_cache.contains("size") && js_cache.at("size").is_number_unsigned())
-                    {
-                        json js_data = js_cache["data"];
-                        uint64_t size = js_cache["size"];
-                        std::vector<uint8_t> data = js_data.get<std::vector<uint8_t>>();
-                        if (size == data.size())
-                            shot->cacheBuffer.Write(data.data(), data.size());
-                        else
-                            success = false;
-                    }
-                    else
-                        success = false;
-                }
-                else
-                    success = false;
-            }
-            if (success)
-            {
-                if (js_md5state.contains("isfinish") && js_md5state.at("isfinish").is_boolean())
-                    shot->isfinish = js_md5state["isfinish"];
-                else
-                    success = false;
-            }
-            if (success)
-            {
-                _asyncmd5.LoadSnapShot(*shot);
-                _MD5CheckPoint.progress = progress;
-                _MD5CheckPoint.snap = shot;
-            }
-        }
-        else
-            success = false;
-    }
-    else
-        success = false;
+    if (!record.IsValid())
+        return false;
 
-    return success;
+    std::shared_ptr<MD5SnapShot> shot = std::make_shared<MD5SnapShot>();
+    memcpy(shot->status, record.status, sizeof(shot->status));
+    shot->count = record.count;
+    shot->cacheBuffer.Write(record.cache, record.cachesize);
+    shot->isfinish = record.isfinish != 0;
+    if (shot->isfinish)
+        shot->md5string = std::string(record.md5string, sizeof(record.md5string));
+
+    _asyncmd5.LoadSnapShot(*shot);
+    _MD5CheckPoint.progress = record.progress;
+    _MD5CheckPoint.snap = shot;
+    return true;
 }
 
 bool FileTransferDownLoadTask::ReadChunkFile()
@@ -370,22 +353,40 @@ bool FileTransferDownLoadTask::ReadChunkFile()
 		Buffer buf;
 		chunkfile_io.Seek();
 		chunkfile_io.Read(buf, chunkfile_io.GetSize());
-        std::string js_str(buf.Byte(), buf.Length());
-		json js;
-		try
+
+		ChunkFileHeader header;
+		if (buf.Length() >= sizeof(header) && ((ChunkFileHeader*)buf.Byte())->magic == ChunkFileMagic)
 		{
-			js = json::parse(js_str);
+			buf.Read(&header, sizeof(header));
+			ChunkFileRecord record;
+			while (buf.Remain() >= sizeof(record)) // 末尾不完整的记录直接丢弃
+			{
+				buf.Read(&record, sizeof(record));
+				if (record.range_left <= record.range_right && record.range_right < file_size)
+					insertChunk(chunk_map, record.range_left, record.range_right);
+			}
 		}
-		catch (...)
+		else if (buf.Length() > 0)
 		{
-		}
+			// 兼容旧版本的json格式
+			std::string js_str(buf.Byte(), buf.Length());
+			json js;
+			try
+			{
+				js = json::parse(js_str);
+			}
+			catch (...)
+			{
+			}
 
-		ParseChunkMap(js);
+			ParseChunkMap(js);
+		}
 	}
+	if (IsChunkFileEnable)
+		WriteToChunkFile();
 	return IsChunkFileEnable;
 }
 
-
 bool FileTransferDownLoadTask::ReadMD5ChcekPointFile()
 {
     QString CheckPointFilePath = getMD5CheckPointFilePath(file_path);
@@ -394,26 +395,17 @@ bool FileTransferDownLoadTask::ReadMD5ChcekPointFile()
     if (!exist)
         return false;
 
+    // 旧版本的json格式或损坏的记录直接丢弃，结束传输时会从文件重新计算MD5
     FileIOHandler md5checkfile_io(CheckPointFilePath, FileIOHandler::OpenMode::READ_ONLY);
-    bool isopen = md5checkfile_io.IsOpen();
-    if (isopen)
-    {
-        Buffer buf;
-        md5checkfile_io.Seek(0);
-        md5checkfile_io.Read(buf, md5checkfile_io.GetSize());
-        md5checkfile_io.Close();
-        std::string js_str(buf.Byte(), buf.Length());
-        json js;
-        try
-        {
-            js = json::parse(js_str);
-        }
-        catch (...)
-        {
-        }
-        ParseMd5CheckPoint(js);
-    }
-    return isopen;
+    if (!md5checkfile_io.IsOpen() || md5checkfile_io.GetSize() != sizeof(MD5CheckPointRecord))
+        return false;
+
+    MD5CheckPointRecord record;
+    if (md5checkfile_io.Read((char *)&record, sizeof(record)) != sizeof(record))
+        return false;
+    md5checkfile_io.Close();
+
+    return ParseMd5CheckPoint(record);
 }
 
 bool FileTransferDownLoadTask::ParseFile()
@@ -471,6 +463,71 @@ std::string FileTransferDownLoadTask::AsyncMD5Final()
     return _asyncmd5.Final();
 }
 
+// 分片写入后，被chunk_map完整覆盖的块立即计算叶子；分片本身覆盖整块时直接使用消息中的数据
+void FileTransferDownLoadTask::MerkleUpdate(uint64_t range_left, uint64_t range_right, const char* data)
+{
+    size_t first = range_left / MerkleBlockSize;
+    size_t last = range_right / MerkleBlockSize;
+    std::vector<char> block;
+    for (size_t i = first; i <= last && i < merkle_tree.BlockCount(); i++)
+    {
+        if (merkle_tree.IsLeafReady(i))
+            continue;
+
+        uint64_t blockleft = merkle_tree.BlockLeft(i);
+        uint64_t blockright = merkle_tree.BlockRight(i);
+        uint64_t length = blockright - blockleft + 1;
+        if (blockleft >= range_left && blockright <= range_right)
+        {
+            merkle_tree.SetLeaf(i, ChunkHashHelper::XXH64(data + (blockleft - range_left), length));
+            continue;
+        }
+
+        bool covered = false;
+        for (auto& chunk : chunk_map)
+        {
+            if (chunk.range_left <= blockleft && chunk.range_right >= blockright)
+            {
+                covered = true;
+                break;
+            }
+        }
+        if (!covered)
+            continue;
+
+        block.resize(length);
+        file_io.Seek(blockleft);
+        if (file_io.Read(block.data(), length) == (qint64)length)
+            merkle_tree.SetLeaf(i, ChunkHashHelper::XXH64(block.data(), length));
+    }
+}
+
+// 补算恢复传输前已接收部分的叶子，再与发送端的Merkle根比较
+bool FileTransferDownLoadTask::MerkleFinal()
+{
+    std::vector<char> block(MerkleBlockSize);
+    for (size_t i = 0; i < merkle_tree.BlockCount(); i++)
+    {
+        if (merkle_tree.IsLeafReady(i))
+            continue;
+
+        uint64_t blockleft = merkle_tree.BlockLeft(i);
+        uint64_t length = merkle_tree.BlockRight(i) - blockleft + 1;
+        file_io.Seek(blockleft);
+        if (file_io.Read(block.data(), length) != (qint64)length)
+            return false;
+        merkle_tree.SetLeaf(i, ChunkHashHelper::XXH64(block.data(), length));
+    }
+    return merkle_tree.Root() == merkle_root;
+}
+
+bool FileTransferDownLoadTask::CheckFileIntegrity()
+{
+    if (IsChunkHash)
+        return MerkleFinal();
+    return _md5 == QString::fromStdString(AsyncMD5Final());
+}
+
 void FileTransferDownLoadTask::OccurError()
 {
 	if (!IsError)
@@ -528,6 +585,8 @@ void FileTransferDownLoadTask::RecvTransReq(const json& js)
 	}
 
 	ParseFile();
+	ParseChunkMapEncoding(js);
+	ParseChunkHash(js);
 
 	json js_reply;
 	js_reply["command"] = 8000;
@@ -536,24 +595,22 @@ void FileTransferDownLoadTask::RecvTransReq(const json& js)
 	js_reply["filesize"] = file_size;
 	js_reply["result"] = IsFileEnable == true ? 1 : 0;
 	js_reply["suggest_chunsize"] = GetSuggestChunsize(file_size);
+	if (js.contains("window") && js.at("window").is_number_unsigned())
+		js_reply["window"] = std::min((uint32_t)js["window"], GetTransferWindowSize());
+	if (IsChunkHash)
+		js_reply["chunk_hash"] = ChunkHashXXH64;
 
-	json js_chunkmap = json::array();
-	for (auto& chunkinfo : chunk_map)
+	Buffer buf_chunkmap;
+	if (IsBinaryChunkMap)
 	{
-		json js_info;
-		js_info["index"] = chunkinfo.index;
-
-		json js_range = json::array();
-		js_range.emplace_back(chunkinfo.range_left);
-		js_range.emplace_back(chunkinfo.range_right);
-		js_info["range"] = js_range;
-		js_chunkmap.emplace_back(js_info);
+		js_reply["chunkmap_encoding"] = ChunkMapEncodingBinary;
+		EncodeChunkMap(chunk_map, buf_chunkmap);
 	}
+	else
+		js_reply["chunk_map"] = ChunkMapToJson(chunk_map);
 	// displayTransferProgress(file_size, chunk_map);
 
-	js_reply["chunk_map"] = js_chunkmap;
-
-	if (!NetWorkHelper::SendMessagePackage(&js_reply))
+	if (!NetWorkHelper::SendMessagePackage(&js_reply, &buf_chunkmap))
 		OccurError();
 
 	OccurProgressChange();
@@ -577,6 +634,8 @@ void FileTransferDownLoadTask::AckTransReq(const json& js)
 
 	if (ackresult)
 		ParseFile();
+	ParseChunkMapEncoding(js);
+	ParseChunkHash(js);
 
 	json js_reply;
 	js_reply["command"] = 8000;
@@ -584,27 +643,25 @@ void FileTransferDownLoadTask::AckTransReq(const json& js)
 	js_reply["filesize"] = file_size;
 	js_reply["result"] = (ackresult && IsFileEnable) == true ? 1 : 0;
 	js_reply["suggest_chunsize"] = GetSuggestChunsize(file_size);
+	if (js.contains("window") && js.at("window").is_number_unsigned())
+		js_reply["window"] = std::min((uint32_t)js["window"], GetTransferWindowSize());
+	if (IsChunkHash)
+		js_reply["chunk_hash"] = ChunkHashXXH64;
 
+	Buffer buf_chunkmap;
 	if (ackresult)
 	{
-		json js_chunkmap = json::array();
-		for (auto& chunkinfo : chunk_map)
+		if (IsBinaryChunkMap)
 		{
-			json js_info;
-			js_info["index"] = chunkinfo.index;
-
-			json js_range = json::array();
-			js_range.emplace_back(chunkinfo.range_left);
-			js_range.emplace_back(chunkinfo.range_right);
-			js_info["range"] = js_range;
-			js_chunkmap.emplace_back(js_info);
+			js_reply["chunkmap_encoding"] = ChunkMapEncodingBinary;
+			EncodeChunkMap(chunk_map, buf_chunkmap);
 		}
+		else
+			js_reply["chunk_map"] = ChunkMapToJson(chunk_map);
 		// displayTransferProgress(file_size, chunk_map);
-
-		js_reply["chunk_map"] = js_chunkmap;
 	}
 
-	if (!NetWorkHelper::SendMessagePackage(&js_reply))
+	if (!NetWorkHelper::SendMessagePackage(&js_reply, &buf_chunkmap))
 		OccurError();
 
 	if (ackresult)
@@ -637,13 +694,36 @@ void FileTransferDownLoadTask::RecvChunkDataAndAck(const json& js, Buffer& buf)
 	chunkdata.range_left = js.at("range").at(0);
 	chunkdata.range_right = js.at("range").at(1);
 
-    if (buf.Remain() < chunksize)
+    if (buf.Remain() < chunksize + (IsChunkHash ? ChunkHashSize : 0))
 	{
 		error = true;
 		OccurError();
 		return;
 	}
 
+	// 分片损坏时不写入，只要求发送端重发该分片
+	if (IsChunkHash)
+	{
+		uint64_t expected = 0;
+		memcpy(&expected, buf.Byte() + buf.Position() + chunksize, sizeof(expected));
+		if (ChunkHashHelper::XXH64(buf.Byte() + buf.Position(), chunksize) != expected)
+		{
+			json js_nak;
+			js_nak["command"] = 8001;
+			js_nak["taskid"] = task_id.toStdString();
+			js_nak["chunk_size"] = chunksize;
+			json js_range = json::array();
+			js_range.emplace_back(chunkdata.range_left);
+			js_range.emplace_back(chunkdata.range_right);
+			js_nak["range"] = js_range;
+			js_nak["result"] = 0;
+			js_nak["hash_mismatch"] = 1;
+			if (!NetWorkHelper::SendMessagePackage(&js_nak))
+				OccurError();
+			return;
+		}
+	}
+
 	chunkdata.buf.Append(buf, chunksize);
 
 	if (IsFileEnable)
@@ -667,10 +747,12 @@ void FileTransferDownLoadTask::RecvChunkDataAndAck(const json& js, Buffer& buf)
 
 		if (!error)
 		{
-            chunk_map.emplace_back(0, chunkdata.range_left, chunkdata.range_right);
-            chunk_map = mergeChunks(chunk_map);
+            insertChunk(chunk_map, chunkdata.range_left, chunkdata.range_right);
 			// displayTransferProgress(file_size, chunk_map);
-            AsyncMD5Update();
+            if (IsChunkHash)
+                MerkleUpdate(chunkdata.range_left, chunkdata.range_right, chunkdata.buf.Byte());
+            else
+                AsyncMD5Update();
         }
 	}
 	else
@@ -680,15 +762,16 @@ void FileTransferDownLoadTask::RecvChunkDataAndAck(const json& js, Buffer& buf)
 	}
 
 	if (IsChunkFileEnable)
-		WriteToChunkFile();
-    WriteToMD5CheckFile();
+		AppendToChunkFile(chunkdata.range_left, chunkdata.range_right);
+    if (!IsChunkHash)
+        WriteToMD5CheckFile();
 
 	json js_reply;
     bool finished = CheckTransFinish();
 	if (finished)
 	{
 		file_io.Truncate(file_size);
-        if (_md5 != QString::fromStdString(AsyncMD5Final()))
+        if (!CheckFileIntegrity())
         {
             OccurError();
             return;
@@ -710,20 +793,8 @@ void FileTransferDownLoadTask::RecvChunkDataAndAck(const json& js, Buffer& buf)
 		js_range.emplace_back(chunkdata.range_right);
 		js_reply["range"] = js_range;
 		js_reply["result"] = error == true ? 1 : 0;
-		json js_chunkmap = json::array();
-		for (auto& chunkinfo : chunk_map)
-		{
-			json js_info;
-			js_info["index"] = chunkinfo.index;
-
-			json js_range = json::array();
-			js_range.emplace_back(chunkinfo.range_left);
-			js_range.emplace_back(chunkinfo.range_right);
-			js_info["range"] = js_range;
-			js_chunkmap.emplace_back(js_info);
-		}
-
-		js_reply["chunk_map"] = js_chunkmap;
+		if (!IsBinaryChunkMap) // 二进制模式下发送端根据range自行累加，无需每次回传完整chunk_map
+			js_reply["chunk_map"] = ChunkMapToJson(chunk_map);
 	}
 	if (!NetWorkHelper::SendMessagePackage(&js_reply))
 	{
@@ -751,7 +822,7 @@ void FileTransferDownLoadTask::AckRecvFinished(const json& js)
 
 	if (IsFinished)
 	{
-        if (_md5 != QString::fromStdString(AsyncMD5Final()))
+        if (!CheckFileIntegrity())
         {
             OccurError();
             return;
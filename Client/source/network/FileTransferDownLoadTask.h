@@ -1,6 +1,7 @@
 #pragma once
 #include "FileTransferTask.h"
 #include "AsyncMD5.h"
+#include "ChunkHashHelper.h"
 
 struct MD5CheckPoint
 {
@@ -10,6 +11,25 @@ struct MD5CheckPoint
     MD5CheckPoint();
 };
 
+// __check文件的定长二进制记录，恢复时一次读取即可
+struct MD5CheckPointRecord
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t progress;
+    uint32_t cachesize;    // cache中有效字节数，始终小于一个MD5分组
+    uint32_t status[4];
+    uint64_t count;
+    uint8_t cache[64];
+    uint8_t isfinish;
+    char md5string[32];
+    uint32_t checksum;     // 对checksum之前的全部字节计算
+
+    MD5CheckPointRecord();
+    uint32_t CalcChecksum() const;
+    bool IsValid() const;
+};
+
 class FileTransferDownLoadTask : public FileTransferTask
 {
 public:
@@ -53,14 +73,21 @@ private:
 	bool ReadChunkFile();
     bool ReadMD5ChcekPointFile();
 	bool ParseChunkMap(const json& js);
-    bool ParseMd5CheckPoint(const json &js);
+    bool ParseMd5CheckPoint(const MD5CheckPointRecord &record);
     bool WriteToChunkFile();
+    bool AppendToChunkFile(uint64_t range_left, uint64_t range_right);
+    void ParseChunkMapEncoding(const json& js);
+    void ParseChunkHash(const json& js);
     void WriteToMD5CheckFile();
     bool CheckTransFinish();
 
     void AsyncMD5Update();
     std::string AsyncMD5Final();
 
+    void MerkleUpdate(uint64_t range_left, uint64_t range_right, const char* data);
+    bool MerkleFinal();
+    bool CheckFileIntegrity();
+
 protected:
 	std::function<void(FileTransferDownLoadTask*)> _callbackError;
 	std::function<void(FileTransferDownLoadTask*)> _callbackFinieshed;
@@ -70,6 +97,11 @@ protected:
 private:
 	bool IsChunkFileEnable = false;
 	FileIOHandler chunkfile_io;
+	bool IsBinaryChunkMap = false; // 对端支持二进制chunk_map时，8001只回复本次确认的区间
+
+	bool IsChunkHash = false;      // 协商使用分片哈希与Merkle根，此时不再计算MD5
+	uint64_t merkle_root = 0;      // 发送端提供的Merkle根
+	MerkleTree merkle_tree;        // 叶子只保存在内存中，恢复传输后缺失的叶子在结束时从文件补算
 
 	bool IsRegister = false;
     AsyncMD5 _asyncmd5;
@@ -1,4 +1,7 @@
 #include "FileTransferTask.h"
+#include "ChunkHashHelper.h"
+#include <atomic>
+#include <QHash>
 
 std::vector<uint8_t> FileTransferChunkData::ToBinary()
 {
@@ -31,6 +34,63 @@ QString getFilenameFromPath(const QString &qfilepath)
     return QString::fromStdString(filepath);
 }
 
+bool ComputeFileMerkleRoot(FileIOHandler& file, uint64_t filesize, uint64_t& root)
+{
+    MerkleTree tree;
+    tree.Reset(filesize, MerkleBlockSize);
+    std::vector<char> block(MerkleBlockSize);
+    for (size_t i = 0; i < tree.BlockCount(); i++)
+    {
+        uint64_t left = tree.BlockLeft(i);
+        uint64_t length = tree.BlockRight(i) - left + 1;
+        file.Seek(left);
+        if (file.Read(block.data(), length) != (qint64)length)
+            return false;
+        tree.SetLeaf(i, ChunkHashHelper::XXH64(block.data(), length));
+    }
+    root = tree.Root();
+    return true;
+}
+
+// 同一文件续传时每次发送7000都要读完整个文件，结果按路径缓存
+struct MerkleRootCacheEntry
+{
+    uint64_t filesize = 0;
+    qint64 mtime = 0;
+    uint64_t root = 0;
+};
+constexpr qsizetype MerkleRootCacheLimit = 1024;
+static QHash<QString, MerkleRootCacheEntry> merkle_root_cache;
+static CriticalSectionLock merkle_root_lock;
+
+bool GetFileMerkleRoot(FileIOHandler& file, uint64_t filesize, uint64_t& root)
+{
+    QString path = file.FilePath();
+    qint64 mtime = file.GetModifyTime();
+    if (mtime == 0)
+        return ComputeFileMerkleRoot(file, filesize, root);
+
+    {
+        LockGuard guard(merkle_root_lock);
+        auto it = merkle_root_cache.constFind(path);
+        if (it != merkle_root_cache.constEnd() && it->filesize == filesize && it->mtime == mtime)
+        {
+            root = it->root;
+            return true;
+        }
+    }
+
+    // 计算时不持锁，不同文件可以并行计算
+    if (!ComputeFileMerkleRoot(file, filesize, root))
+        return false;
+
+    LockGuard guard(merkle_root_lock);
+    if (merkle_root_cache.size() >= MerkleRootCacheLimit)
+        merkle_root_cache.clear();
+    merkle_root_cache.insert(path, MerkleRootCacheEntry{filesize, mtime, root});
+    return true;
+}
+
 uint64_t GetSuggestChunsize(uint64_t file_size)
 {
     const uint64_t KB = 1024;
@@ -49,6 +109,112 @@ uint64_t GetSuggestChunsize(uint64_t file_size)
 }
 
 
+static std::atomic<uint32_t> transfer_window_size{8};
+
+uint32_t GetTransferWindowSize()
+{
+    return transfer_window_size.load();
+}
+
+void SetTransferWindowSize(uint32_t window)
+{
+    transfer_window_size.store(max((uint32_t)1, window));
+}
+
+static std::atomic<ChunkSizePolicyType> chunk_size_policy_type{ChunkSizePolicyType::FIXED};
+
+constexpr uint64_t adaptiveminchunksize = 64 * 1024;
+constexpr uint64_t adaptivemaxchunksize = 8 * 1024 * 1024;
+constexpr uint64_t maxinflightbytes = 64 * 1024 * 1024; // 单个任务在途数据上限
+constexpr int64_t minsampleintervalms = 50;              // 吞吐采样的最短区间
+
+ChunkSizePolicyType GetChunkSizePolicyType()
+{
+    return chunk_size_policy_type.load();
+}
+
+void SetChunkSizePolicyType(ChunkSizePolicyType type)
+{
+    chunk_size_policy_type.store(type);
+}
+
+std::unique_ptr<ChunkSizePolicy> CreateChunkSizePolicy(uint64_t initchunksize, uint32_t window)
+{
+    if (GetChunkSizePolicyType() == ChunkSizePolicyType::ADAPTIVE)
+        return std::make_unique<AdaptiveChunkSizePolicy>(initchunksize, window);
+    return std::make_unique<FixedChunkSizePolicy>(initchunksize);
+}
+
+FixedChunkSizePolicy::FixedChunkSizePolicy(uint64_t chunksize)
+    : chunksize(std::max((uint64_t)1, chunksize))
+{
+}
+
+uint64_t FixedChunkSizePolicy::ChunkSize() const
+{
+    return chunksize;
+}
+
+void FixedChunkSizePolicy::OnChunkAcked(uint64_t, int64_t, int64_t)
+{
+}
+
+void FixedChunkSizePolicy::OnChunkTimeout()
+{
+}
+
+AdaptiveChunkSizePolicy::AdaptiveChunkSizePolicy(uint64_t initchunksize, uint32_t window)
+    : window(std::max((uint32_t)1, window))
+{
+    chunksize = std::clamp(initchunksize, adaptiveminchunksize, MaxChunkSize());
+}
+
+uint64_t AdaptiveChunkSizePolicy::MaxChunkSize() const
+{
+    return std::max(adaptiveminchunksize, std::min(adaptivemaxchunksize, maxinflightbytes / window));
+}
+
+uint64_t AdaptiveChunkSizePolicy::ChunkSize() const
+{
+    return chunksize;
+}
+
+void AdaptiveChunkSizePolicy::OnChunkAcked(uint64_t acksize, int64_t rttms, int64_t nowms)
+{
+    if (rttms >= 0)
+    {
+        rttms = std::max(rttms, (int64_t)1);
+        srtt = srtt == 0 ? rttms : (srtt * 7 + rttms) / 8;
+        minrtt = minrtt == 0 ? rttms : std::min(minrtt, rttms);
+    }
+
+    if (samplestart == 0) // 首个采样区间从该分片发出时开始
+        samplestart = nowms - std::max(rttms, (int64_t)0);
+
+    sampledbytes += acksize;
+    int64_t elapsed = nowms - samplestart;
+    if (elapsed < std::max(srtt, minsampleintervalms))
+        return;
+
+    double rate = (double)sampledbytes / elapsed;
+    btlbw = std::max(rate, btlbw * 0.9); // 取近期最大值并缓慢衰减，链路变慢时能逐步跟上
+    sampledbytes = 0;
+    samplestart = nowms;
+
+    if (minrtt == 0)
+        return;
+
+    double target = btlbw * minrtt * 2 / window;
+    uint64_t next = std::clamp((uint64_t)target, chunksize / 2, chunksize * 2);
+    chunksize = std::clamp(next, adaptiveminchunksize, MaxChunkSize());
+}
+
+void AdaptiveChunkSizePolicy::OnChunkTimeout()
+{
+    chunksize = std::max(adaptiveminchunksize, chunksize / 2);
+    btlbw /= 2;
+}
+
 // 比较函数，用于排序
 bool compareChunk(const FileTransferChunkInfo &a, const FileTransferChunkInfo &b)
 {
@@ -175,6 +341,87 @@ uint32_t CountProgress(const std::vector<FileTransferChunkInfo> &chunks, uint64_
     return progress;
 }
 
+void insertChunk(std::vector<FileTransferChunkInfo> &merged, uint64_t left, uint64_t right)
+{
+    // 第一个可能与[left,right]重叠或相邻的区间
+    auto first = std::lower_bound(merged.begin(), merged.end(), left,
+                                  [](const FileTransferChunkInfo &chunk, uint64_t value)
+                                  { return chunk.range_right + 1 < value; });
+    auto last = first;
+    while (last != merged.end() && last->range_left <= right + 1)
+    {
+        left = min(left, last->range_left);
+        right = max(right, last->range_right);
+        ++last;
+    }
+
+    size_t index = first - merged.begin();
+    if (first == last)
+    {
+        merged.insert(first, FileTransferChunkInfo(index, left, right));
+    }
+    else
+    {
+        *first = FileTransferChunkInfo(index, left, right);
+        merged.erase(first + 1, last);
+    }
+
+    // 插入或合并后其后区间的位置发生变化，index与位置保持一致
+    for (size_t i = index + 1; i < merged.size(); i++)
+        merged[i].index = i;
+}
+
+void EncodeChunkMap(const std::vector<FileTransferChunkInfo> &chunks, Buffer &buf)
+{
+    uint32_t count = chunks.size();
+    buf.Write(&count, sizeof(count));
+    for (auto &chunk : chunks)
+    {
+        buf.Write(&chunk.range_left, sizeof(chunk.range_left));
+        buf.Write(&chunk.range_right, sizeof(chunk.range_right));
+    }
+}
+
+bool DecodeChunkMap(Buffer &buf, std::vector<FileTransferChunkInfo> &chunks)
+{
+    uint32_t count = 0;
+    if (buf.Read(&count, sizeof(count)) != sizeof(count))
+        return false;
+    if (buf.Remain() < (uint64_t)count * sizeof(uint64_t) * 2)
+        return false;
+
+    std::vector<FileTransferChunkInfo> result;
+    result.reserve(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint64_t left = 0, right = 0;
+        buf.Read(&left, sizeof(left));
+        buf.Read(&right, sizeof(right));
+        if (left > right)
+            return false;
+        insertChunk(result, left, right);
+    }
+    chunks = std::move(result);
+    return true;
+}
+
+json ChunkMapToJson(const std::vector<FileTransferChunkInfo> &chunks)
+{
+    json js_chunkmap = json::array();
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        json js_info;
+        js_info["index"] = i;
+
+        json js_range = json::array();
+        js_range.emplace_back(chunks[i].range_left);
+        js_range.emplace_back(chunks[i].range_right);
+        js_info["range"] = js_range;
+        js_chunkmap.emplace_back(js_info);
+    }
+    return js_chunkmap;
+}
+
 FileTransferTask::FileTransferTask(const QString &taskid, const QString &filepath, const QString &md5)
 {
     file_path = filepath;
@@ -12,6 +12,16 @@ struct FileTransferChunkInfo
 	FileTransferChunkInfo(int index, uint64_t left, uint64_t right) : index(index), range_left(left), range_right(right) {}
 };
 
+// 已发出但尚未被对端确认的分片
+struct FileTransferInflightChunk
+{
+	uint64_t range_left;
+	uint64_t range_right;
+	int64_t sendtime;           // 发送时间(毫秒)，用于超时重传
+	bool retransmitted = false; // 重传过的分片无法区分确认对应哪次发送，不参与RTT采样
+	FileTransferInflightChunk(uint64_t left, uint64_t right, int64_t time) : range_left(left), range_right(right), sendtime(time) {}
+};
+
 struct FileTransferChunkData
 {
 	uint64_t range_left;
@@ -25,8 +35,80 @@ QString getFilenameFromPath(const QString& filepath);
 std::vector<FileTransferChunkInfo> mergeChunks(const std::vector<FileTransferChunkInfo>& chunks);
 std::vector<FileTransferChunkInfo> getUntransferredChunks(const std::vector<FileTransferChunkInfo>& transferredChunks, uint64_t totalFileSize);
 uint32_t CountProgress(const std::vector<FileTransferChunkInfo>& chunks, uint64_t totalFileSize);
+void insertChunk(std::vector<FileTransferChunkInfo>& merged, uint64_t left, uint64_t right); // 向已合并的区间表插入区间，保持有序且不重叠
+
+// chunk_map的紧凑二进制编码，随消息的buffer部分发送: [uint32 count][count * (uint64 left, uint64 right)]
+constexpr uint32_t ChunkMapEncodingBinary = 1;
+void EncodeChunkMap(const std::vector<FileTransferChunkInfo>& chunks, Buffer& buf);
+bool DecodeChunkMap(Buffer& buf, std::vector<FileTransferChunkInfo>& chunks);
+json ChunkMapToJson(const std::vector<FileTransferChunkInfo>& chunks);
 uint64_t GetSuggestChunsize(uint64_t file_size);
 
+// 分片哈希：双方在7000/8000中协商chunk_hash后，7001的buffer在分片数据后追加8字节的xxHash64(小端)，
+// 接收端到达即校验，文件按MerkleBlockSize切块得到的Merkle根在结束时代替MD5校验
+constexpr uint32_t ChunkHashXXH64 = 1;
+constexpr uint64_t MerkleBlockSize = 1024 * 1024;
+constexpr uint64_t ChunkHashSize = sizeof(uint64_t);
+bool ComputeFileMerkleRoot(FileIOHandler& file, uint64_t filesize, uint64_t& root);
+bool GetFileMerkleRoot(FileIOHandler& file, uint64_t filesize, uint64_t& root); // 按路径缓存，文件大小与修改时间不变时不再重新计算
+uint32_t GetTransferWindowSize();            // 发送端允许同时在途的最大分片数
+void SetTransferWindowSize(uint32_t window); // 设置为1时退化为停等模式
+
+enum class ChunkSizePolicyType
+{
+	FIXED = 0,   // 始终使用接收端建议的分片大小
+	ADAPTIVE = 1 // 根据确认往返时间与有效吞吐动态调整
+};
+
+// 发送端的分片大小策略，每次填充窗口前查询下一个分片的大小
+class ChunkSizePolicy
+{
+public:
+	virtual ~ChunkSizePolicy() = default;
+	virtual uint64_t ChunkSize() const = 0;
+	virtual void OnChunkAcked(uint64_t chunksize, int64_t rttms, int64_t nowms) = 0; // rttms<0表示不参与RTT采样
+	virtual void OnChunkTimeout() = 0;
+};
+
+class FixedChunkSizePolicy : public ChunkSizePolicy
+{
+public:
+	FixedChunkSizePolicy(uint64_t chunksize);
+	virtual uint64_t ChunkSize() const;
+	virtual void OnChunkAcked(uint64_t chunksize, int64_t rttms, int64_t nowms);
+	virtual void OnChunkTimeout();
+
+private:
+	uint64_t chunksize;
+};
+
+// 以最小RTT与近期最大有效吞吐估计带宽时延积，使窗口内在途数据量保持在其两倍，
+// 每次调整幅度限制在一半到两倍之间，单个任务在途数据总量受内存上限约束
+class AdaptiveChunkSizePolicy : public ChunkSizePolicy
+{
+public:
+	AdaptiveChunkSizePolicy(uint64_t initchunksize, uint32_t window);
+	virtual uint64_t ChunkSize() const;
+	virtual void OnChunkAcked(uint64_t chunksize, int64_t rttms, int64_t nowms);
+	virtual void OnChunkTimeout();
+
+private:
+	uint64_t MaxChunkSize() const;
+
+private:
+	uint64_t chunksize;
+	uint32_t window;
+	int64_t srtt = 0;		 // 平滑RTT(毫秒)
+	int64_t minrtt = 0;	   // 最小RTT(毫秒)，近似无排队时的链路时延
+	double btlbw = 0;		 // 估计的瓶颈带宽(字节/毫秒)
+	uint64_t sampledbytes = 0;
+	int64_t samplestart = 0;
+};
+
+ChunkSizePolicyType GetChunkSizePolicyType();
+void SetChunkSizePolicyType(ChunkSizePolicyType type);
+std::unique_ptr<ChunkSizePolicy> CreateChunkSizePolicy(uint64_t initchunksize, uint32_t window);
+
 class FileTransferTask
 {
 public:
@@ -1,6 +1,16 @@
-#include "FileTransferUploadTask.h"
+；同一轮的多个超时视为一次拥塞信号，分片大小只回退一次#include "FileTransferUploadTask.h"
 #include "NetWorkHelper.h"
 #include "MD5Helper.h"
+#include "ChunkHashHelper.h"
+#include <chrono>
+
+constexpr int64_t chunkretransmitms = 15 * 1000; // 在途分片超过该时间未确认则重传
+
+static int64_t GetTimestampMilliseconds()
+{
+	auto now = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+}
 
 FileTransferUploadTask::FileTransferUploadTask(const QString& taskid, const QString& filepath, const QString& md5)
     : FileTransferTask(taskid, filepath, md5)
@@ -16,6 +26,7 @@ void FileTransferUploadTask::ReleaseSource()
 	file_io.Close();
 	file_size = 0;
 	chunk_map.clear();
+	inflight_chunks.clear();
 	// file_path.clear();
 	// task_id.clear();
 }
@@ -67,11 +78,22 @@ void FileTransferUploadTask::SendTransReq()
 	js["taskid"] = task_id.toStdString();
 	js["filename"] = getFilenameFromPath(file_path).toStdString();
 	js["filesize"] = file_size;
+	js["window"] = GetTransferWindowSize();
+	js["chunkmap_encoding"] = ChunkMapEncodingBinary;
+
+	// 同时提供分片哈希与Merkle根，对端不支持时忽略这些字段，仍按MD5校验
+	uint64_t merkleroot = 0;
+	if (GetFileMerkleRoot(file_io, file_size, merkleroot))
+	{
+		js["chunk_hash"] = ChunkHashXXH64;
+		js["merkle_block"] = MerkleBlockSize;
+		js["merkle_root"] = ChunkHashHelper::ToHex(merkleroot);
+	}
 
 	NetWorkHelper::SendMessagePackage(&js);
 }
 
-void FileTransferUploadTask::AckTransReqResult(const json& js)
+void FileTransferUploadTask::AckTransReqResult(const json& js, Buffer& buf)
 {
 	if (!ParseReqResult(js))
 	{
@@ -84,18 +106,52 @@ void FileTransferUploadTask::AckTransReqResult(const json& js)
 		OccurError();
 		return;
 	}
-	if (!ParseChunkMap(js))
+	if (!ParseChunkMap(js, buf))
 	{
 		OccurError();
 		return;
 	}
+	ParseWindowSize(js);
+	ParseChunkHash(js);
+	chunk_policy = CreateChunkSizePolicy(suggest_chunksize, window_size);
+	inflight_chunks.clear();
 	OccurProgressChange();
 	SendNextChunkData();
 }
 
 void FileTransferUploadTask::RecvChunkMapAndSendNextData(const json& js)
 {
-	if (!ParseChunkMap(js))
+	if (js.contains("hash_mismatch"))
+	{
+		if (!RecvChunkHashMismatch(js))
+		{
+			OccurError();
+			return;
+		}
+	}
+	else if (js.contains("chunk_map"))
+	{
+		Buffer empty;
+		if (!ParseChunkMap(js, empty))
+		{
+			OccurError();
+			return;
+		}
+	}
+	else if (js.contains("range") && js.at("range").is_array() && js.at("range").size() == 2 &&
+		js.at("range").at(0).is_number_unsigned() && js.at("range").at(1).is_number_unsigned())
+	{
+		// 二进制模式下8001仅携带本次确认的区间
+		uint64_t left = js.at("range").at(0);
+		uint64_t right = js.at("range").at(1);
+		if (left > right || right >= file_size)
+		{
+			OccurError();
+			return;
+		}
+		insertChunk(chunk_map, left, right);
+	}
+	else
 	{
 		OccurError();
 		return;
@@ -104,6 +160,23 @@ void FileTransferUploadTask::RecvChunkMapAndSendNextData(const json& js)
 	SendNextChunkData();
 }
 
+// 分片在传输中损坏，只将该分片标记为立即超时，由RetransmitExpiredChunks单独重发
+bool FileTransferUploadTask::RecvChunkHashMismatch(const json& js)
+{
+	if (!IsChunkHash || !js.contains("range") || !js.at("range").is_array() || js.at("range").size() != 2 ||
+		!js.at("range").at(0).is_number_unsigned() || !js.at("range").at(1).is_number_unsigned())
+		return false;
+
+	uint64_t left = js.at("range").at(0);
+	uint64_t right = js.at("range").at(1);
+	for (auto& inflight : inflight_chunks)
+	{
+		if (inflight.range_left == left && inflight.range_right == right)
+			inflight.sendtime = 0;
+	}
+	return true;
+}
+
 bool FileTransferUploadTask::ParseReqResult(const json& js)
 {
 	if (js.contains("result") && js.at("result").is_number_unsigned())
@@ -125,10 +198,32 @@ bool FileTransferUploadTask::ParseSuggestChunkSize(const json& js)
 		return false;
 }
 
-bool FileTransferUploadTask::ParseChunkMap(const json& js)
+// 对端未携带window字段时视为旧版本，按停等模式发送
+void FileTransferUploadTask::ParseWindowSize(const json& js)
+{
+	window_size = 1;
+	if (js.contains("window") && js.at("window").is_number_unsigned())
+	{
+		uint32_t window = js["window"];
+		window_size = std::clamp(window, (uint32_t)1, GetTransferWindowSize());
+	}
+}
+
+// 接收端在8000中回传chunk_hash表示接受分片哈希
+void FileTransferUploadTask::ParseChunkHash(const json& js)
+{
+	IsChunkHash = js.contains("chunk_hash") && js.at("chunk_hash").is_number_unsigned() && js["chunk_hash"] == ChunkHashXXH64;
+}
+
+bool FileTransferUploadTask::ParseChunkMap(const json& js, Buffer& buf)
 {
 	bool parseresult = true;
-	if (js.contains("chunk_map") && js.at("chunk_map").is_array())
+	if (js.contains("chunkmap_encoding") && js.at("chunkmap_encoding").is_number_unsigned() && js["chunkmap_encoding"] == ChunkMapEncodingBinary)
+	{
+		buf.Seek(0);
+		parseresult = DecodeChunkMap(buf, chunk_map);
+	}
+	else if (js.contains("chunk_map") && js.at("chunk_map").is_array())
 	{
         std::vector<FileTransferChunkInfo> chunkmap;
 		json js_chunkmap = js.at("chunk_map");
@@ -205,11 +300,88 @@ uint32_t FileTransferUploadTask::Progress()
 	return CountProgress(chunk_map, file_size);
 }
 
+// 移除已被对端chunk_map覆盖的在途分片，并将确认结果反馈给分片大小策略
+void FileTransferUploadTask::ReleaseAckedChunks()
+{
+	int64_t now = GetTimestampMilliseconds();
+	auto acked = [this, now](const FileTransferInflightChunk& inflight) -> bool
+		{
+			for (auto& chunk : chunk_map)
+			{
+				if (chunk.range_left <= inflight.range_left && chunk.range_right >= inflight.range_right)
+				{
+					if (chunk_policy)
+						chunk_policy->OnChunkAcked(inflight.range_right - inflight.range_left + 1,
+							inflight.retransmitted ? -1 : now - inflight.sendtime, now);
+					return true;
+				}
+			}
+			return false;
+		};
+	inflight_chunks.erase(std::remove_if(inflight_chunks.begin(), inflight_chunks.end(), acked), inflight_chunks.end());
+}
+
+// 选择性重传：仅重发超时未确认的分片；同一轮的多个超时视为一次拥塞信号，分片大小只回退一次
+bool FileTransferUploadTask::RetransmitExpiredChunks()
+{
+	int64_t now = GetTimestampMilliseconds();
+	bool expired = false;
+	for (auto& inflight : inflight_chunks)
+	{
+		if (now - inflight.sendtime < chunkretransmitms)
+			continue;
+
+		if (!SendChunkData(inflight.range_left, inflight.range_right))
+			return false;
+		inflight.sendtime = now;
+		inflight.retransmitted = true;
+		expired = true;
+	}
+	if (expired && chunk_policy)
+		chunk_policy->OnChunkTimeout();
+	return true;
+}
+
+bool FileTransferUploadTask::SendChunkData(uint64_t range_left, uint64_t range_right)
+{
+	uint64_t chunksize = range_right - range_left + 1;
+
+	FileTransferChunkData chunkdata;
+	chunkdata.range_left = range_left;
+	chunkdata.range_right = range_right;
+
+	file_io.Seek(chunkdata.range_left);
+	file_io.Read(chunkdata.buf, chunksize);
+	if (IsChunkHash)
+	{
+		uint64_t hash = ChunkHashHelper::XXH64(chunkdata.buf.Byte(), chunksize);
+		chunkdata.buf.Seek(chunksize);
+		chunkdata.buf.Write(&hash, sizeof(hash));
+	}
+
+	json js_data;
+	js_data["command"] = 7001;
+	js_data["taskid"] = task_id.toStdString();
+	js_data["chunk_size"] = chunksize;
+	json js_range = json::array();
+	js_range.emplace_back(chunkdata.range_left);
+	js_range.emplace_back(chunkdata.range_right);
+	js_data["range"] = js_range;
+
+	//js_data["data"] = json::binary(chunkdata.ToBinary());
+
+	return NetWorkHelper::SendMessagePackage(&js_data, std::move(chunkdata.buf));
+}
+
 void FileTransferUploadTask::SendNextChunkData()
 {
-    std::vector<FileTransferChunkInfo> untrans_chunks = getUntransferredChunks(chunk_map, file_size);
+	std::vector<FileTransferChunkInfo> untrans_chunks = getUntransferredChunks(chunk_map, file_size);
 	if (untrans_chunks.empty()) // 发送完毕
 	{
+		inflight_chunks.clear();
+		if (IsFinishSent)
+			return;
+
 		json js_success;
 		js_success["command"] = 7010;
 		js_success["taskid"] = task_id.toStdString();
@@ -220,37 +392,43 @@ void FileTransferUploadTask::SendNextChunkData()
 			OccurError();
 			return;
 		}
+		IsFinishSent = true;
+		return;
 	}
-	else
-	{
-		FileTransferChunkInfo& chunkinfo = untrans_chunks[0];
-		uint64_t size = chunkinfo.range_right - chunkinfo.range_left + 1;
-
-		uint64_t nextchunksize = min(suggest_chunksize, size);
-
-		FileTransferChunkData chunkdata;
-		chunkdata.range_left = chunkinfo.range_left;
-		chunkdata.range_right = chunkinfo.range_left + nextchunksize - 1;
-
-		file_io.Seek(chunkdata.range_left);
-		file_io.Read(chunkdata.buf, nextchunksize);
 
-		json js_data;
-		js_data["command"] = 7001;
-		js_data["taskid"] = task_id.toStdString();
-		js_data["chunk_size"] = nextchunksize;
-		json js_range = json::array();
-		js_range.emplace_back(chunkdata.range_left);
-		js_range.emplace_back(chunkdata.range_right);
-		js_data["range"] = js_range;
+	ReleaseAckedChunks();
+	if (!RetransmitExpiredChunks())
+	{
+		OccurError();
+		return;
+	}
 
-		//js_data["data"] = json::binary(chunkdata.ToBinary());
+	// 已确认与在途的区间都不再发送，从剩余区间中填满窗口
+	std::vector<FileTransferChunkInfo> occupied = chunk_map;
+	for (auto& inflight : inflight_chunks)
+		occupied.emplace_back(0, inflight.range_left, inflight.range_right);
+	std::vector<FileTransferChunkInfo> unsent_chunks = getUntransferredChunks(occupied, file_size);
 
-		if (!NetWorkHelper::SendMessagePackage(&js_data, &chunkdata.buf))
+	int64_t now = GetTimestampMilliseconds();
+	uint64_t chunksize = chunk_policy ? chunk_policy->ChunkSize() : suggest_chunksize;
+	for (auto& chunkinfo : unsent_chunks)
+	{
+		uint64_t left = chunkinfo.range_left;
+		while (left <= chunkinfo.range_right && inflight_chunks.size() < window_size)
 		{
-			OccurError();
-			return;
+			uint64_t nextchunksize = min(chunksize, chunkinfo.range_right - left + 1);
+			uint64_t right = left + nextchunksize - 1;
+
+			if (!SendChunkData(left, right))
+			{
+				OccurError();
+				return;
+			}
+			inflight_chunks.emplace_back(left, right, now);
+			left = right + 1;
 		}
+		if (inflight_chunks.size() >= window_size)
+			break;
 	}
 }
 
@@ -389,7 +567,7 @@ void FileTransferUploadTask::ProcessMsg(const json& js, Buffer& buf)
 		}
 		if (command == 8000)
 		{
-			AckTransReqResult(js);
+			AckTransReqResult(js, buf);
 		}
 		if (command == 8001)
 		{
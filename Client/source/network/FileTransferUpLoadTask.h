@@ -36,9 +36,13 @@ protected:
 	virtual uint32_t Progress();
 
 	void SendTransReq();
-	void AckTransReqResult(const json& js);
+	void AckTransReqResult(const json& js, Buffer& buf);
 	void RecvChunkMapAndSendNextData(const json& js);
+	bool RecvChunkHashMismatch(const json& js);
 	void SendNextChunkData();
+	bool SendChunkData(uint64_t range_left, uint64_t range_right);
+	void ReleaseAckedChunks();
+	bool RetransmitExpiredChunks();
 	void SendErrorInfo();
 	void RecvPeerError(const json& js);
 	void RecvPeerFinish(const json& js);
@@ -47,8 +51,10 @@ protected:
 private:
 	bool ParseFile();
 	bool ParseReqResult(const json& js);
-	bool ParseChunkMap(const json& js);
+	bool ParseChunkMap(const json& js, Buffer& buf);
 	bool ParseSuggestChunkSize(const json& js);
+	void ParseWindowSize(const json& js);
+	void ParseChunkHash(const json& js);
 
 protected:
 	std::function<void(FileTransferUploadTask*)> _callbackError;
@@ -58,4 +64,10 @@ protected:
 
 private:
 	uint64_t suggest_chunksize = 1;
+	std::unique_ptr<ChunkSizePolicy> chunk_policy;          // 协商完成后按接收端建议的大小创建
+
+	uint32_t window_size = 1;                               // 与接收端协商后的窗口大小
+	std::vector<FileTransferInflightChunk> inflight_chunks; // 已发送未确认的分片
+	bool IsFinishSent = false;
+	bool IsChunkHash = false;                               // 对端接受分片哈希，7001数据后追加xxHash64
 };
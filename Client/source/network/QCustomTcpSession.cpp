@@ -33,8 +33,20 @@ struct CustomTcpMsgHeader
     }
 };
 
+static_assert(sizeof(CustomTcpMsgHeader) <= CustomTcpHeaderHeadroom, "CustomTcpHeaderHeadroom too small");
+
 using Base = BaseNetWorkSession;
 
+// 拷贝负载并预留协议头的空间
+static Buffer CopyWithHeadroom(const Buffer &buffer)
+{
+    Buffer buf;
+    buf.ReserveHeadroom(CustomTcpHeaderHeadroom);
+    buf.Write(buffer);
+    buf.Seek(0);
+    return buf;
+}
+
 // 校验包
 bool CheckPakHeader(CustomTcpMsgHeader header, const uint8_t *data, size_t len)
 {
@@ -49,8 +61,8 @@ bool CheckPakHeader(CustomTcpMsgHeader header, const uint8_t *data, size_t len)
     return crc == save;
 }
 
-// 处理流内容，在流的头部添加seq和ack字段
-void AddPakHeader(Buffer *buf, CustomTcpMsgHeader header)
+// 处理流内容，在流的头部添加seq和ack字段；payload为紧随buf写出的切片，一并计入校验和
+void AddPakHeader(Buffer *buf, CustomTcpMsgHeader header, const std::vector<BufferSlice> *payload = nullptr)
 {
     if (!buf && header.length > 0)
         return;
@@ -60,6 +72,11 @@ void AddPakHeader(Buffer *buf, CustomTcpMsgHeader header)
     uint32_t crc = CRC32Helper::calculate((uint8_t *)(&header), sizeof(CustomTcpMsgHeader)); // 计算Header的CRC
     if (buf)
         crc = CRC32Helper::update(crc, (uint8_t *)(buf->Data()), buf->Length()); // 增量计算PayLoad的CRC
+    if (payload)
+    {
+        for (auto &slice : *payload)
+            crc = CRC32Helper::update(crc, (const uint8_t *)(slice.Data()), slice.Length());
+    }
 
     header.checksum = crc;
 
@@ -97,6 +114,8 @@ AnalysisResult AnalysisDataPackage(Buffer *buf, CustomPackage *outPak)
 
     if (buf->Remain() < header.length)
     {
+        // 按包长预留容量，大包后续到达的数据直接追加，不再反复扩容
+        buf->Reserve(buf->Position() + header.length);
         buf->Seek(oriPos);
         return AnalysisResult::BufferAGAIN;
     }
@@ -158,6 +177,16 @@ bool CustomTcpSession::Release()
             map.clear();
         });
 
+    std::vector<std::shared_ptr<AsyncAwaitTask>> asynctasks;
+    _AsyncAwaitMap.EnsureCall(
+        [&](std::map<int, std::shared_ptr<AsyncAwaitTask>> &map) -> void
+        {
+            for (auto &pair : map)
+                asynctasks.emplace_back(pair.second);
+        });
+    for (auto &task : asynctasks)
+        CompleteAwait(task, nullptr);
+
     cacheBuffer.Release();
     if (cachePak)
     {
@@ -177,6 +206,43 @@ bool CustomTcpSession::AsyncSend(const Buffer &buffer)
     return Send(buffer, -1);
 }
 
+bool CustomTcpSession::AsyncSend(Buffer &&buffer)
+{
+    return Send(std::move(buffer), -1);
+}
+
+bool CustomTcpSession::AsyncSend(CustomTcpFrame &&frame)
+{
+    try
+    {
+        if (!frame.head.Data() && frame.payload.empty())
+            return true;
+
+        int seq = this->seq++;
+        uint64_t length = frame.head.Length();
+        for (auto &slice : frame.payload)
+            length += slice.Length();
+        AddPakHeader(&frame.head, CustomTcpMsgHeader(seq, -1, length), &frame.payload);
+
+        // 协议头与消息头连续存放，负载以原有的切片写出，不再拼接
+        std::vector<BufferSlice> slices;
+        slices.reserve(frame.payload.size() + 1);
+        slices.emplace_back(frame.head.Slice(0, frame.head.Length()));
+        slices.insert(slices.end(), frame.payload.begin(), frame.payload.end());
+        return BaseClient->Send(slices);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+        return false;
+    }
+}
+
+bool CustomTcpSession::Flush()
+{
+    return BaseClient->Flush();
+}
+
 bool CustomTcpSession::AwaitSend(const Buffer &buffer, Buffer &response)
 {
     try
@@ -194,7 +260,7 @@ bool CustomTcpSession::AwaitSend(const Buffer &buffer, Buffer &response)
         if (!_AwaitMap.Insert(task->seq, task))
             return false;
 
-        Buffer buf(buffer);
+        Buffer buf = CopyWithHeadroom(buffer);
         CustomTcpMsgHeader header(seq, -1, buffer.Length());
         header.msgType = 1;
         AddPakHeader(&buf, header);
@@ -224,6 +290,83 @@ bool CustomTcpSession::AwaitSend(const Buffer &buffer, Buffer &response)
     }
 }
 
+Task<Buffer> CustomTcpSession::AwaitSendAsync(const Buffer &buffer, uint32_t timeOutMs, std::stop_token stoptoken)
+{
+    if (!buffer.Data() || buffer.Length() <= 0 || stoptoken.stop_requested())
+        co_return Buffer();
+
+    auto task = std::make_shared<AsyncAwaitTask>();
+    task->seq = this->seq++;
+    if (!_AsyncAwaitMap.Insert(task->seq, task))
+        co_return Buffer();
+
+    // 超时与取消都投递到会话所在线程处理，协程在该线程的事件循环中恢复，不占用调用方线程
+    std::weak_ptr<AsyncAwaitTask> weak = task;
+    auto fail = [this, weak]()
+    {
+        if (auto task = weak.lock())
+            CompleteAwait(task, nullptr);
+    };
+    // 先登记取消回调再启动超时，避免超时在会话线程reset stopcallback时与emplace并发
+    if (stoptoken.stop_possible())
+        task->stopcallback.emplace(stoptoken, [this, fail]()
+                                   { QMetaObject::invokeMethod(this, fail, Qt::QueuedConnection); });
+    QMetaObject::invokeMethod(this, [this, fail, timeOutMs]()
+                              { QTimer::singleShot(timeOutMs, this, fail); }, Qt::QueuedConnection);
+
+    Buffer buf = CopyWithHeadroom(buffer);
+    CustomTcpMsgHeader header(task->seq, -1, buffer.Length());
+    header.msgType = 1;
+    AddPakHeader(&buf, header);
+    if (!BaseClient->Send(buf))
+        CompleteAwait(task, nullptr);
+
+    // 挂起直到CompleteAwait；完成先于挂起时不挂起
+    struct AsyncAwaitResponse
+    {
+        std::shared_ptr<AsyncAwaitTask> task;
+
+        bool await_ready() const noexcept
+        {
+            return task->state == AsyncAwaitTask::DONE;
+        }
+
+        bool await_suspend(std::coroutine_handle<> coro) noexcept
+        {
+            task->coroutine = coro;
+            int expected = AsyncAwaitTask::PENDING;
+            return task->state.compare_exchange_strong(expected, AsyncAwaitTask::SUSPENDED);
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    co_await AsyncAwaitResponse{task};
+    co_return std::move(task->response);
+}
+
+void CustomTcpSession::CompleteAwait(std::shared_ptr<AsyncAwaitTask> task, Buffer *response)
+{
+    std::coroutine_handle<> coro = FinishAwait(task, response);
+    if (coro)
+        coro.resume();
+}
+
+std::coroutine_handle<> CustomTcpSession::FinishAwait(std::shared_ptr<AsyncAwaitTask> task, Buffer *response)
+{
+    if (task->finished.exchange(true))
+        return nullptr;
+
+    _AsyncAwaitMap.Erase(task->seq);
+    task->stopcallback.reset();
+    if (response)
+        task->response = std::move(*response);
+
+    if (task->state.exchange(AsyncAwaitTask::DONE) == AsyncAwaitTask::SUSPENDED)
+        return task->coroutine;
+    return nullptr;
+}
+
 bool CustomTcpSession::OnSessionClose()
 {
     auto callback = _callbackSessionClose;
@@ -242,7 +385,12 @@ bool CustomTcpSession::OnRecvData(Buffer *buffer)
     }
 
     if (buffer->Remain() > 0)
-        cacheBuffer.Append(*buffer);
+    {
+        if (cacheBuffer.Length() == 0 && buffer->Position() == 0)
+            cacheBuffer.QuoteFromBuf(*buffer); // 没有残留数据时直接接管，避免拷贝
+        else
+            cacheBuffer.Append(*buffer);
+    }
 
     while (cacheBuffer.Remain() > 0)
     {
@@ -257,8 +405,14 @@ bool CustomTcpSession::OnRecvData(Buffer *buffer)
             CustomPackage *newPak = cachePak;
             cachePak = new CustomPackage();
 
-            std::lock_guard<SpinLock> lock(_ProcessLock);
-            ProcessPakage(newPak);
+            std::vector<std::coroutine_handle<>> resumes;
+            {
+                std::lock_guard<SpinLock> lock(_ProcessLock);
+                ProcessPakage(resumes, newPak);
+            }
+            // 释放_ProcessLock后再恢复协程，协程继续发送或处理时不占用接收处理的锁
+            for (auto coro : resumes)
+                coro.resume();
         }
         else if (result == AnalysisResult::BufferAGAIN)
         {
@@ -276,15 +430,22 @@ bool CustomTcpSession::OnRecvData(Buffer *buffer)
 }
 
 bool CustomTcpSession::Send(const Buffer &buffer, int ack)
+{
+    if (!buffer.Data() || buffer.Length() == 0)
+        return true;
+    return Send(CopyWithHeadroom(buffer), ack);
+}
+
+bool CustomTcpSession::Send(Buffer &&buffer, int ack)
 {
     try
     {
-        if (!buffer.Data() || buffer.Length() < 0)
+        if (!buffer.Data() || buffer.Length() == 0)
             return true;
 
         int seq = this->seq++;
-        Buffer buf(buffer);
-        AddPakHeader(&buf, CustomTcpMsgHeader(seq, ack, buffer.Length()));
+        Buffer buf(std::move(buffer));
+        AddPakHeader(&buf, CustomTcpMsgHeader(seq, ack, buf.Length()));
         return BaseClient->Send(buf);
     }
     catch (const std::exception &e)
@@ -294,7 +455,7 @@ bool CustomTcpSession::Send(const Buffer &buffer, int ack)
     }
 }
 
-void CustomTcpSession::ProcessPakage(CustomPackage *newPak)
+void CustomTcpSession::ProcessPakage(std::vector<std::coroutine_handle<>> &resumes, CustomPackage *newPak)
 {
 
     if (newPak)
@@ -305,7 +466,8 @@ void CustomTcpSession::ProcessPakage(CustomPackage *newPak)
             if (_RecvPaks.dequeue(pak))
                 SAFE_DELETE(pak);
         }
-        _RecvPaks.enqueue(newPak);
+        if (!_RecvPaks.enqueue(newPak))
+            SAFE_DELETE(newPak);
     }
 
     int count = 10;
@@ -315,7 +477,14 @@ void CustomTcpSession::ProcessPakage(CustomPackage *newPak)
         if (pak->ack != -1)
         {
             AwaitTask *task = nullptr;
-            if (_AwaitMap.Find(pak->ack, task))
+            std::shared_ptr<AsyncAwaitTask> asynctask;
+            if (_AsyncAwaitMap.Find(pak->ack, asynctask))
+            {
+                std::coroutine_handle<> coro = FinishAwait(asynctask, &pak->buffer); // 由调用方在接收线程恢复协程
+                if (coro)
+                    resumes.emplace_back(coro);
+            }
+            else if (_AwaitMap.Find(pak->ack, task))
             {
                 if (task->respsonse)
                     task->respsonse->CopyFromBuf(pak->buffer);
@@ -376,11 +545,12 @@ void CustomTcpSession::ProcessPakage(CustomPackage *newPak)
 
 void CustomTcpSession::OnBindRecvDataCallBack()
 {
+    std::vector<std::coroutine_handle<>> resumes;
     if (_ProcessLock.trylock())
     {
         try
         {
-            ProcessPakage();
+            ProcessPakage(resumes);
         }
         catch (const std::exception &e)
         {
@@ -389,6 +559,8 @@ void CustomTcpSession::OnBindRecvDataCallBack()
         }
         _ProcessLock.unlock();
     }
+    for (auto coro : resumes)
+        coro.resume();
 }
 
 void CustomTcpSession::OnBindSessionCloseCallBack()
@@ -496,11 +668,12 @@ void CustomTcpSession::BindRecvRequestCallBack(std::function<void(BaseNetWorkSes
 
 void CustomTcpSession::OnBindRecvRequestCallBack()
 {
+    std::vector<std::coroutine_handle<>> resumes;
     if (_ProcessLock.trylock())
     {
         try
         {
-            ProcessPakage();
+            ProcessPakage(resumes);
         }
         catch (const std::exception &e)
         {
@@ -509,4 +682,6 @@ void CustomTcpSession::OnBindRecvRequestCallBack()
         }
         _ProcessLock.unlock();
     }
+    for (auto coro : resumes)
+        coro.resume();
 }
@@ -3,7 +3,11 @@
 #include "QBaseNetWorkSession.h"
 #include "SpinLock.h"
 #include "SafeStl.h"
+#include "Coroutine.h"
 #include <mutex>
+#include <vector>
+#include <stop_token>
+#include <functional>
 
 struct CustomPackage
 {
@@ -13,6 +17,20 @@ struct CustomPackage
     uint8_t msgType = 0; // 0:null, 1:请求, 2:响应
 };
 
+// 协议头占用的头部空间，发送的Buffer预留不少于此的headroom时，协议头原地写入，无需搬移负载
+constexpr uint64_t CustomTcpHeaderHeadroom = 32;
+
+// 服务端空闲检测发出的心跳，收到后原样回应
+bool IsHeartBeat(const Buffer &Buffer);
+
+// 分散存放的一帧：head为连续的部分，预留CustomTcpHeaderHeadroom时协议头原地写入；
+// payload为随后依次写出的负载切片，不拼接进head
+struct CustomTcpFrame
+{
+    Buffer head;
+    std::vector<BufferSlice> payload;
+};
+
 // 基于TCP应用层客户端的自定义通讯协议会话封装
 class CustomTcpSession : public BaseNetWorkSession
 {
@@ -28,6 +46,24 @@ class CustomTcpSession : public BaseNetWorkSession
         bool time_out = false;
     };
 
+    // 协程等待的请求，响应、超时、取消与会话关闭中最先到达的一方完成它
+    struct AsyncAwaitTask
+    {
+        enum State
+        {
+            PENDING = 0,
+            SUSPENDED = 1, // 协程已挂起，完成时恢复
+            DONE = 2
+        };
+
+        int seq = 0;
+        Buffer response;
+        std::coroutine_handle<> coroutine;
+        std::atomic<bool> finished{false};
+        std::atomic<int> state{PENDING};
+        std::optional<std::stop_callback<std::function<void()>>> stopcallback;
+    };
+
 public:
     CustomTcpSession(TCPClient *client = nullptr);
     ~CustomTcpSession();
@@ -35,7 +71,12 @@ public:
     virtual bool Release();
 
     bool AsyncSend(const Buffer &buffer);                   // 异步发送，不关心返回结果
+    bool AsyncSend(Buffer &&buffer);                        // 接管buffer发送，省去一次拷贝
+    bool AsyncSend(CustomTcpFrame &&frame);                 // 只写入发送缓冲，批量发送后调用Flush一次写出
+    bool Flush();
     bool AwaitSend(const Buffer &buffer, Buffer &response); // 等待返回结果的发送，关心返回的结果
+    // AwaitSend的协程版本，等待期间不占用线程；超时、取消或会话关闭时返回空Buffer
+    Task<Buffer> AwaitSendAsync(const Buffer &buffer, uint32_t timeOutMs = 8000, std::stop_token stoptoken = {});
     TCPClient *GetBaseClient();
 
     void BindRecvRequestCallBack(std::function<void(BaseNetWorkSession *, Buffer *recv, Buffer *resp)> callback);
@@ -55,16 +96,21 @@ protected:
 
 private:
     bool Send(const Buffer &buffer, int ack = -1); // 异步发送，不关心返回结果
-    void ProcessPakage(CustomPackage *newPak = nullptr);
+    bool Send(Buffer &&buffer, int ack = -1);
+    // 收到应答的协程记入resumes，由调用方释放_ProcessLock后再恢复
+    void ProcessPakage(std::vector<std::coroutine_handle<>> &resumes, CustomPackage *newPak = nullptr);
+    void CompleteAwait(std::shared_ptr<AsyncAwaitTask> task, Buffer *response); // response为空表示失败
+    std::coroutine_handle<> FinishAwait(std::shared_ptr<AsyncAwaitTask> task, Buffer *response); // 返回待恢复的协程，无需恢复时为空
     SpinLock _ProcessLock;
 
 private:
     std::atomic<int> seq;
-    SafeQueue<CustomPackage *> _RecvPaks;
-    SafeQueue<CustomPackage *> _SendPaks;
+    MPSCQueue<CustomPackage *> _RecvPaks{512, QueueOverflowPolicy::Reject};
+    MPSCQueue<CustomPackage *> _SendPaks{512, QueueOverflowPolicy::Reject};
 
     std::function<void(BaseNetWorkSession *, Buffer *recv, Buffer *response)> _callbackRecvRequest;
     SafeMap<int, AwaitTask *> _AwaitMap; // seq->AwaitTask
+    SafeMap<int, std::shared_ptr<AsyncAwaitTask>> _AsyncAwaitMap; // seq->AsyncAwaitTask
 
     Buffer cacheBuffer;
     CustomPackage *cachePak; // 握手/数据包解析缓存
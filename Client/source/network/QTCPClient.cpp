@@ -74,7 +74,12 @@ bool TCPClient::OnRecvBuffer(Buffer *buffer)
     }
 
     if (buffer->Remain() > 0)
-        cacheBuffer.Append(*buffer);
+    {
+        if (cacheBuffer.Length() == 0 && buffer->Position() == 0)
+            cacheBuffer.QuoteFromBuf(*buffer);
+        else
+            cacheBuffer.Append(*buffer);
+    }
 
     if (_callbackMessage)
     {
@@ -117,6 +122,35 @@ bool TCPClient::Send(Buffer &buffer)
     }
 }
 
+bool TCPClient::Send(const std::vector<BufferSlice> &slices)
+{
+    try
+    {
+        for (auto &slice : slices)
+        {
+            uint64_t pos = 0;
+            while (pos < slice.Length())
+            {
+                qint64 sendcount = BaseCon->write(slice.Data() + pos, slice.Length() - pos);
+                if (sendcount <= 0)
+                    return false;
+                pos += sendcount;
+            }
+        }
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+        return false;
+    }
+}
+
+bool TCPClient::Flush()
+{
+    return BaseCon->flush();
+}
+
 bool TCPClient::TryHandshake(uint32_t timeOutMs)
 {
     return true;
@@ -141,8 +175,16 @@ void TCPClient::RecvBuffer()
 
     if (!BaseCon->isValid())
         return;
-    QByteArray bytes = BaseCon->readAll();
-    Buffer buffer(bytes.data(),bytes.length());
+    // 直接读入Buffer，省去QByteArray的中转拷贝
+    qint64 available = BaseCon->bytesAvailable();
+    if (available <= 0)
+        return;
+    Buffer buffer;
+    buffer.ReSize(available);
+    qint64 length = BaseCon->read(buffer.Byte(), available);
+    if (length <= 0)
+        return;
+    buffer.ReSize(length);
     OnRecvBuffer(&buffer);
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QTcpSocket>
+#include <vector>
 #include "Buffer.h"
 
 enum class CheckHandshakeStatus
@@ -28,6 +29,8 @@ public:
     virtual bool OnConnectClose();
 
     virtual bool Send(Buffer &buffer);
+    virtual bool Send(const std::vector<BufferSlice> &slices); // 依次写入各切片，不立即flush，批量写入后调用Flush一次写出
+    bool Flush();
 
     QTcpSocket *GetBaseCon();
 
@@ -2,6 +2,9 @@
 
 #include <map>
 #include <queue>
+#include <atomic>
+#include <memory>
+#include <thread>
 #include <functional>
 #include <iostream>
 #include "CriticalSectionLock.h"
@@ -448,3 +451,131 @@ public:
         return LockGuard(_lock);
     }
 };
+
+// 队列满时enqueue的处理方式
+enum class QueueOverflowPolicy
+{
+    Reject = 0, // 立即返回false，由调用方决定丢弃或重试
+    Wait = 1,   // 让出时间片直到消费者腾出空位
+};
+
+// 有界无锁的多生产者单消费者环形队列，接口与SafeQueue一致
+// 槽位预先分配，入队出队不加锁、不分配节点；每个槽位的序号标记其可写或可读，
+// 生产者以CAS争抢写入位置；dequeue/front/clear只允许同一时刻一个消费者调用
+template <typename T>
+class MPSCQueue
+{
+private:
+    struct Cell
+    {
+        std::atomic<uint64_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> _cells;
+    uint64_t _mask;
+    QueueOverflowPolicy _policy;
+    alignas(64) std::atomic<uint64_t> _tail; // 下一个写入位置，生产者共享
+    alignas(64) std::atomic<uint64_t> _head; // 下一个读取位置，仅消费者修改
+
+    template <typename U>
+    bool push(U &&t)
+    {
+        uint64_t pos = _tail.load(std::memory_order_relaxed);
+        Cell *cell = nullptr;
+        while (true)
+        {
+            cell = &_cells[pos & _mask];
+            uint64_t seq = cell->sequence.load(std::memory_order_acquire);
+            int64_t diff = (int64_t)seq - (int64_t)pos;
+            if (diff == 0)
+            {
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0) // 队列已满
+            {
+                if (_policy == QueueOverflowPolicy::Reject)
+                    return false;
+                std::this_thread::yield();
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+            else
+                pos = _tail.load(std::memory_order_relaxed);
+        }
+        cell->data = std::forward<U>(t);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+public:
+    // capacity向上取整为2的幂
+    explicit MPSCQueue(uint64_t capacity = 1024, QueueOverflowPolicy policy = QueueOverflowPolicy::Wait)
+        : _policy(policy), _tail(0), _head(0)
+    {
+        uint64_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        _mask = size - 1;
+        _cells.reset(new Cell[size]);
+        for (uint64_t i = 0; i < size; i++)
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    MPSCQueue(const MPSCQueue &) = delete;
+    MPSCQueue &operator=(const MPSCQueue &) = delete;
+    ~MPSCQueue() {}
+
+    bool empty()
+    {
+        return size() == 0;
+    }
+    // 并发入队时为近似值
+    int size()
+    {
+        uint64_t head = _head.load(std::memory_order_relaxed);
+        uint64_t tail = _tail.load(std::memory_order_relaxed);
+        return tail > head ? (int)(tail - head) : 0;
+    }
+    uint64_t capacity() const
+    {
+        return _mask + 1;
+    }
+    // 队列添加元素，Reject策略下队列满时返回false
+    bool enqueue(const T &t)
+    {
+        return push(t);
+    }
+    bool enqueue(T &&t)
+    {
+        return push(std::move(t));
+    }
+    // 队列取出元素，仅限消费者调用；生产者已占位但尚未写完的元素视为不可读
+    bool dequeue(T &t)
+    {
+        uint64_t head = _head.load(std::memory_order_relaxed);
+        Cell &cell = _cells[head & _mask];
+        if (cell.sequence.load(std::memory_order_acquire) != head + 1)
+            return false;
+        t = std::move(cell.data);
+        cell.data = T();
+        cell.sequence.store(head + _mask + 1, std::memory_order_release);
+        _head.store(head + 1, std::memory_order_relaxed);
+        return true;
+    }
+    // 查看队列首元素，仅限消费者调用
+    bool front(T &t)
+    {
+        uint64_t head = _head.load(std::memory_order_relaxed);
+        Cell &cell = _cells[head & _mask];
+        if (cell.sequence.load(std::memory_order_acquire) != head + 1)
+            return false;
+        t = cell.data;
+        return true;
+    }
+    void clear()
+    {
+        T t;
+        while (dequeue(t))
+            ;
+    }
+};
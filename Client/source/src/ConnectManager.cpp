@@ -1,6 +1,7 @@
 #include "ConnectManager.h"
 #include "MsgManager.h"
 #include "ModelManager.h"
+#include <QThread>
 
 ConnectManager *ConnectManager::Instance()
 {
@@ -14,7 +15,7 @@ ConnectManager::ConnectManager()
         session =new CustomTcpSession();
     connect(this,&ConnectManager::signal_Login,this,&ConnectManager::slots_Login);
     connect(this,&ConnectManager::signal_Logout,this,&ConnectManager::slots_Logout);
-    connect(this,&ConnectManager::signal_Send,this,&ConnectManager::slots_Send);
+    connect(this,&ConnectManager::signal_FlushSend,this,&ConnectManager::slots_FlushSend,Qt::QueuedConnection);
     connect(this,&ConnectManager::signal_RecvMessage,this,&ConnectManager::slots_RecvMessage);
     connect(this,&ConnectManager::signal_PeerClose,this,&ConnectManager::slots_PeerClose);
 
@@ -47,9 +48,44 @@ void ConnectManager::Logout()
     emit signal_Logout();
 }
 
-void ConnectManager::Send(const QByteArray &buf)
+bool ConnectManager::Send(const QByteArray &buf)
 {
-    emit signal_Send(buf);
+    CustomTcpFrame frame;
+    frame.head.ReserveHeadroom(CustomTcpHeaderHeadroom);
+    frame.head.Write(buf.data(), buf.length());
+    return Send(std::move(frame));
+}
+
+bool ConnectManager::Send(Buffer &&buf)
+{
+    CustomTcpFrame frame;
+    frame.head.QuoteFromBuf(buf);
+    return Send(std::move(frame));
+}
+
+// 只有队列从空闲转为非空时投递一次信号，之后入队的消息由同一次slots_FlushSend带走
+bool ConnectManager::Send(CustomTcpFrame &&frame)
+{
+    // 连接中入队的帧排在signal_Login之后，连接建立后再写出
+    if (status==ConnectStatus::disconnect)
+        return false;
+
+    // 其他线程入队遇到队列已满时阻塞，直到连接线程写出空位；连接线程是唯一的消费者，
+    // 在此线程阻塞将永远等不到出队(如回应心跳)，因此先写出已排队的帧以保持顺序，再直接发送
+    if (QThread::currentThread() == thread())
+    {
+        slots_FlushSend();
+        if (status!=ConnectStatus::connected || !session->AsyncSend(std::move(frame)))
+            return false;
+        session->Flush();
+        return true;
+    }
+
+    if (!sendqueue.enqueue(std::move(frame)))
+        return false;
+    if (!flushscheduled.exchange(true))
+        emit signal_FlushSend();
+    return true;
 }
 
 ConnectStatus ConnectManager::connectStatus()
@@ -64,6 +100,12 @@ void ConnectManager::OnPeerClose(BaseNetWorkSession *s)
 
 void ConnectManager::OnRecvMessage(BaseNetWorkSession *s, Buffer *recv)
 {
+    if (IsHeartBeat(*recv))
+    {
+        Send(Buffer(recv->Byte(), recv->Length()));
+        return;
+    }
+
     QByteArray buffer(recv->Byte(),recv->Length());
     emit signal_RecvMessage(buffer);
 }
@@ -92,16 +134,23 @@ void ConnectManager::slots_Logout()
     session->Release();
 }
 
-void ConnectManager::slots_Send(const QByteArray &buf)
+// 队列中的帧依次写入socket的发送缓冲，最后flush一次，合并为尽量少的系统调用
+void ConnectManager::slots_FlushSend()
 {
-    if (status!=ConnectStatus::connected)
-        return;
+    flushscheduled.store(false);
 
-    Buffer buffer(buf.data(),buf.length());
-    bool result = session->AsyncSend(buffer);
-    if(!result)
+    CustomTcpFrame frame;
+    int count = 0;
+    while (sendqueue.dequeue(frame))
     {
+        if (status!=ConnectStatus::connected)
+            continue;
+        if (session->AsyncSend(std::move(frame)))
+            count++;
     }
+
+    if (count > 0)
+        session->Flush();
 }
 
 void ConnectManager::slots_PeerClose()
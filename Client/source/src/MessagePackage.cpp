@@ -157,17 +157,31 @@ bool AnalysisMessagePackageFromBuffer(Buffer* buf, MessagePackage* package)
 	return result;
 }
 
-void GenerateMessagePackageToBuffer(MessagePackage* package, Buffer* buf)
+void GenerateMessagePackageToBuffer(MessagePackage* package, Buffer* buf, uint64_t headroom)
 {
 	package->bufferdata.Seek(0);
 	package->jsondata.Seek(0);
 
-	buf->ReSize(sizeof(package->jsonlen) + sizeof(package->bufferlen) + package->jsonlen + package->bufferlen);
+	GenerateMessagePackageToBuffer(package->jsondata, package->bufferdata, buf, headroom);
+}
+
+void GenerateMessagePackageToBuffer(const Buffer& jsondata, const Buffer& bufferdata, Buffer* buf, uint64_t headroom)
+{
+	buf->Reserve(sizeof(uint32_t) + sizeof(uint64_t) + jsondata.Length() + bufferdata.Length());
+	GenerateMessagePackageHeaderToBuffer(jsondata, bufferdata.Length(), buf, headroom);
+	buf->Write(bufferdata);
+}
+
+void GenerateMessagePackageHeaderToBuffer(const Buffer& jsondata, uint64_t bufferlen, Buffer* buf, uint64_t headroom)
+{
+	uint32_t jsonlen = jsondata.Length();
 
-	buf->Write(&(package->jsonlen), sizeof(package->jsonlen));
-	buf->Write(&(package->bufferlen), sizeof(package->bufferlen));
+	buf->ReserveHeadroom(headroom);
+	buf->ReSize(sizeof(jsonlen) + sizeof(bufferlen) + jsonlen);
+	buf->Seek(0);
 
-	buf->WriteFromOtherBufferPos(package->jsondata);
-	buf->WriteFromOtherBufferPos(package->bufferdata);
+	buf->Write(&jsonlen, sizeof(jsonlen));
+	buf->Write(&bufferlen, sizeof(bufferlen));
+	buf->Write(jsondata);
 }
 
@@ -40,7 +40,7 @@ void MsgManager::ProcessMsg(QByteArray* bytes)
 	int command = jcommandValue.toInt();
 
 	if (command == 7000 || command == 7001 || command == 7010 || command == 7080 || command == 7070 ||
-		command == 8000 || command == 8001 || command == 8010 || command == 5001)
+		command == 8000 || command == 8001 || command == 8010 || command == 5001 || command == 5003)
 	{
 		FILETRANSMANAGER->ProcessMsg(js_src, buf_src);
 		return;
@@ -20,23 +20,53 @@ bool NetWorkHelper::SendMessagePackage(Buffer* buf)
 	return NetWorkHelper::SendMessagePackage(&package);
 }
 
+// 带流数据的消息不经过MessagePackage，流数据直接写入发送缓冲
 bool NetWorkHelper::SendMessagePackage(json* json, Buffer* buf)
 {
-	MessagePackage package(*json, *buf);
-	return NetWorkHelper::SendMessagePackage(&package);
+	Buffer jsondata(json->dump());
+	return SendMessageBuffers(jsondata, *buf);
 }
 
 bool NetWorkHelper::SendMessagePackage(QJsonObject* jsonObj, Buffer* buf)
 {
-	MessagePackage package(*jsonObj, *buf);
-	return NetWorkHelper::SendMessagePackage(&package);
+	QByteArray jsonbytes = QJsonDocument(*jsonObj).toJson(QJsonDocument::JsonFormat::Compact);
+	Buffer jsondata(jsonbytes.data(), jsonbytes.length());
+	return SendMessageBuffers(jsondata, *buf);
+}
+
+// 接管流数据，以切片紧随消息头发送，流数据不再拷贝
+bool NetWorkHelper::SendMessagePackage(json* json, Buffer&& buf)
+{
+	Buffer jsondata(json->dump());
+	return SendMessageSlices(jsondata, std::move(buf));
+}
+
+bool NetWorkHelper::SendMessagePackage(QJsonObject* jsonObj, Buffer&& buf)
+{
+	QByteArray jsonbytes = QJsonDocument(*jsonObj).toJson(QJsonDocument::JsonFormat::Compact);
+	Buffer jsondata(jsonbytes.data(), jsonbytes.length());
+	return SendMessageSlices(jsondata, std::move(buf));
 }
 
 bool NetWorkHelper::SendMessagePackage(MessagePackage* package)
 {
 	Buffer buf;
-	GenerateMessagePackageToBuffer(package, &buf);
-	QByteArray bytes(buf.Byte(), buf.Length());
-	CONNECTMANAGER->Send(bytes);
-	return true;
+	GenerateMessagePackageToBuffer(package, &buf, CustomTcpHeaderHeadroom);
+	return CONNECTMANAGER->Send(std::move(buf));
+}
+
+bool NetWorkHelper::SendMessageBuffers(const Buffer& jsondata, const Buffer& bufferdata)
+{
+	Buffer buf;
+	GenerateMessagePackageToBuffer(jsondata, bufferdata, &buf, CustomTcpHeaderHeadroom);
+	return CONNECTMANAGER->Send(std::move(buf));
+}
+
+bool NetWorkHelper::SendMessageSlices(const Buffer& jsondata, Buffer&& bufferdata)
+{
+	CustomTcpFrame frame;
+	GenerateMessagePackageHeaderToBuffer(jsondata, bufferdata.Length(), &frame.head, CustomTcpHeaderHeadroom);
+	if (bufferdata.Length() > 0)
+		frame.payload.emplace_back(bufferdata.Slice(0, bufferdata.Length()));
+	return CONNECTMANAGER->Send(std::move(frame));
 }
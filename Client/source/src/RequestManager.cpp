@@ -47,7 +47,7 @@ void RequestManager::SendPicture(const QString& goaltoken,
     jsonObj.insert("md5", md5);
     jsonObj.insert("fileid", fileid);
 
-    NetWorkHelper::SendMessagePackage(&jsonObj, &buf);
+    NetWorkHelper::SendMessagePackage(&jsonObj, std::move(buf));
 }
 
 
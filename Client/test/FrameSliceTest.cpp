@@ -0,0 +1,79 @@
+#include "Buffer.h"
+#include "CRC32Helper.h"
+#include "TestHelper.h"
+#include <random>
+#include <vector>
+
+static std::vector<char> RandomData(std::mt19937 &rng, size_t length)
+{
+    std::vector<char> data(length);
+    for (auto &c : data)
+        c = (char)rng();
+    return data;
+}
+
+// 帧在发送队列中排队期间，负载切片不受源Buffer后续改写与释放的影响
+static void TestSliceLifetime()
+{
+    std::mt19937 rng(1);
+    std::vector<char> data = RandomData(rng, 4096);
+
+    Buffer payload(data.data(), data.size());
+    BufferSlice slice = payload.Slice(0, payload.Length());
+    BufferSlice tail = slice.Slice(4000, 1000); // 超出范围的部分被截断
+    TEST_CHECK(slice.Length() == data.size());
+    TEST_CHECK(tail.Length() == 96);
+
+    payload.Seek(0);
+    payload.Write("overwrite", 9);
+    TEST_CHECK(memcmp(slice.Data(), data.data(), data.size()) == 0);
+
+    Buffer moved(std::move(payload));
+    moved.Release();
+    TEST_CHECK(memcmp(slice.Data(), data.data(), data.size()) == 0);
+    TEST_CHECK(memcmp(tail.Data(), data.data() + 4000, tail.Length()) == 0);
+}
+
+// 依次对连续的head与各负载切片增量计算校验和，结果与接收端对拼接后的整帧计算一致
+static void TestSliceChecksum()
+{
+    std::mt19937 rng(2);
+    uint8_t header[16];
+    for (auto &c : header)
+        c = (uint8_t)rng();
+
+    // 覆盖查表与PCLMUL折叠两条路径，切片长度不按16字节对齐
+    for (size_t payloadsize : {0, 1, 63, 64, 1000, 65537})
+    {
+        std::vector<char> head = RandomData(rng, 37);
+        Buffer payload;
+        std::vector<char> data = RandomData(rng, payloadsize);
+        payload.Write(data.data(), data.size());
+
+        std::vector<BufferSlice> slices;
+        for (uint64_t offset = 0; offset < payload.Length();)
+        {
+            uint64_t length = std::min<uint64_t>(rng() % 5000 + 1, payload.Length() - offset);
+            slices.emplace_back(payload.Slice(offset, length));
+            offset += length;
+        }
+
+        uint32_t crc = CRC32Helper::calculate(header, sizeof(header));
+        crc = CRC32Helper::update(crc, (const uint8_t *)head.data(), head.size());
+        for (auto &slice : slices)
+            crc = CRC32Helper::update(crc, (const uint8_t *)slice.Data(), slice.Length());
+
+        std::vector<char> frame = head;
+        frame.insert(frame.end(), data.begin(), data.end());
+        uint32_t expected = CRC32Helper::calculate(header, sizeof(header));
+        expected = CRC32Helper::update(expected, (const uint8_t *)frame.data(), frame.size());
+        TEST_CHECK(crc == expected);
+    }
+}
+
+int main()
+{
+    RUN_TEST(TestSliceLifetime);
+    RUN_TEST(TestSliceChecksum);
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include "SafeStl.h"
+#include "TestHelper.h"
+#include <vector>
+
+static void TestFifo()
+{
+    MPSCQueue<int> queue(5, QueueOverflowPolicy::Reject);
+    TEST_CHECK(queue.capacity() == 8); // 向上取整为2的幂
+    TEST_CHECK(queue.empty());
+
+    int value = 0;
+    TEST_CHECK(!queue.dequeue(value));
+    // 多次转过环形缓冲，槽位序号正确回绕
+    for (int round = 0; round < 10; round++)
+    {
+        for (int i = 0; i < 6; i++)
+            TEST_CHECK(queue.enqueue(round * 10 + i));
+        TEST_CHECK(queue.size() == 6);
+        TEST_CHECK(queue.front(value) && value == round * 10);
+        for (int i = 0; i < 6; i++)
+            TEST_CHECK(queue.dequeue(value) && value == round * 10 + i);
+        TEST_CHECK(queue.empty());
+    }
+}
+
+static void TestReject()
+{
+    MPSCQueue<int> queue(4, QueueOverflowPolicy::Reject);
+    for (int i = 0; i < 4; i++)
+        TEST_CHECK(queue.enqueue(i));
+    TEST_CHECK(!queue.enqueue(4));
+
+    int value = 0;
+    TEST_CHECK(queue.dequeue(value) && value == 0);
+    TEST_CHECK(queue.enqueue(4)); // 腾出一个空位后可以再入队
+    TEST_CHECK(!queue.enqueue(5));
+
+    queue.clear();
+    TEST_CHECK(queue.empty());
+    TEST_CHECK(!queue.dequeue(value));
+}
+
+static void TestMoveOnly()
+{
+    MPSCQueue<std::unique_ptr<int>> queue(2);
+    TEST_CHECK(queue.enqueue(std::make_unique<int>(7)));
+    std::unique_ptr<int> value;
+    TEST_CHECK(queue.dequeue(value) && value && *value == 7);
+}
+
+// 多个生产者并发入队，消费者收到全部元素，且每个生产者的元素保持入队顺序
+static void RunProducers(QueueOverflowPolicy policy, uint64_t capacity)
+{
+    constexpr int producercount = 4;
+    constexpr int itemsperproducer = 100000;
+    MPSCQueue<uint64_t> queue(capacity, policy);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < producercount; p++)
+    {
+        producers.emplace_back([&queue, p]()
+                               {
+            for (uint64_t i = 0; i < itemsperproducer; i++)
+            {
+                uint64_t item = ((uint64_t)p << 32) | i;
+                while (!queue.enqueue(item)) // Reject策略下队列满时由生产者重试
+                    std::this_thread::yield();
+            } });
+    }
+
+    std::vector<uint64_t> next(producercount, 0);
+    uint64_t received = 0;
+    while (received < (uint64_t)producercount * itemsperproducer)
+    {
+        uint64_t item = 0;
+        if (!queue.dequeue(item))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        uint32_t p = item >> 32;
+        TEST_CHECK(p < producercount);
+        TEST_CHECK((item & 0xFFFFFFFF) == next[p]);
+        next[p]++;
+        received++;
+    }
+
+    for (auto &producer : producers)
+        producer.join();
+    TEST_CHECK(queue.empty());
+}
+
+static void TestMultiProducerReject()
+{
+    RunProducers(QueueOverflowPolicy::Reject, 64);
+}
+
+static void TestMultiProducerWait()
+{
+    // 容量远小于元素总数，生产者在队列满时等待消费者
+    RunProducers(QueueOverflowPolicy::Wait, 16);
+}
+
+int main()
+{
+    RUN_TEST(TestFifo);
+    RUN_TEST(TestReject);
+    RUN_TEST(TestMoveOnly);
+    RUN_TEST(TestMultiProducerReject);
+    RUN_TEST(TestMultiProducerWait);
+    return 0;
+}
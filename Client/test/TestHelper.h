@@ -0,0 +1,22 @@
+#pragma once
+
+#include <iostream>
+#include <cstdlib>
+
+// 单元测试的断言：失败时输出位置并以非0退出，由ctest判定结果
+#define TEST_CHECK(cond)                                                                     \
+    do                                                                                       \
+    {                                                                                        \
+        if (!(cond))                                                                         \
+        {                                                                                    \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+            std::exit(1);                                                                    \
+        }                                                                                    \
+    } while (0)
+
+#define RUN_TEST(test)                                \
+    do                                                \
+    {                                                 \
+        test();                                       \
+        std::cout << #test << " passed" << std::endl; \
+    } while (0)
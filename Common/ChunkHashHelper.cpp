@@ -0,0 +1,204 @@
+#include "ChunkHashHelper.h"
+#include <cstring>
+#include <algorithm>
+
+static constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t RotateLeft(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// 按小端读取，memcpy避免未对齐访问
+static inline uint64_t Read64(const uint8_t *ptr)
+{
+    uint64_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static inline uint32_t Read32(const uint8_t *ptr)
+{
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static inline uint64_t Round(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = RotateLeft(acc, 31);
+    acc *= PRIME64_1;
+    return acc;
+}
+
+static inline uint64_t MergeRound(uint64_t acc, uint64_t value)
+{
+    acc ^= Round(0, value);
+    acc = acc * PRIME64_1 + PRIME64_4;
+    return acc;
+}
+
+uint64_t ChunkHashHelper::XXH64(const void *data, size_t length, uint64_t seed)
+{
+    const uint8_t *ptr = static_cast<const uint8_t *>(data);
+    const uint8_t *end = ptr + length;
+    uint64_t hash;
+
+    if (length >= 32)
+    {
+        // 四路独立累加，充分利用流水线
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+        const uint8_t *limit = end - 32;
+        do
+        {
+            v1 = Round(v1, Read64(ptr));
+            v2 = Round(v2, Read64(ptr + 8));
+            v3 = Round(v3, Read64(ptr + 16));
+            v4 = Round(v4, Read64(ptr + 24));
+            ptr += 32;
+        } while (ptr <= limit);
+
+        hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+        hash = MergeRound(hash, v1);
+        hash = MergeRound(hash, v2);
+        hash = MergeRound(hash, v3);
+        hash = MergeRound(hash, v4);
+    }
+    else
+        hash = seed + PRIME64_5;
+
+    hash += length;
+
+    while (ptr + 8 <= end)
+    {
+        hash ^= Round(0, Read64(ptr));
+        hash = RotateLeft(hash, 27) * PRIME64_1 + PRIME64_4;
+        ptr += 8;
+    }
+    if (ptr + 4 <= end)
+    {
+        hash ^= (uint64_t)Read32(ptr) * PRIME64_1;
+        hash = RotateLeft(hash, 23) * PRIME64_2 + PRIME64_3;
+        ptr += 4;
+    }
+    while (ptr < end)
+    {
+        hash ^= (*ptr) * PRIME64_5;
+        hash = RotateLeft(hash, 11) * PRIME64_1;
+        ptr++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+std::string ChunkHashHelper::ToHex(uint64_t hash)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(16, '0');
+    for (int i = 15; i >= 0; i--)
+    {
+        hex[i] = digits[hash & 0xF];
+        hash >>= 4;
+    }
+    return hex;
+}
+
+bool ChunkHashHelper::FromHex(const std::string &hex, uint64_t &hash)
+{
+    if (hex.size() != 16)
+        return false;
+
+    uint64_t value = 0;
+    for (char c : hex)
+    {
+        value <<= 4;
+        if (c >= '0' && c <= '9')
+            value |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            value |= c - 'A' + 10;
+        else
+            return false;
+    }
+    hash = value;
+    return true;
+}
+
+uint64_t ChunkHashHelper::MerkleRoot(std::vector<uint64_t> leaves)
+{
+    if (leaves.empty())
+        return XXH64(nullptr, 0);
+
+    while (leaves.size() > 1)
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < leaves.size(); i += 2)
+        {
+            if (i + 1 < leaves.size())
+            {
+                uint64_t pair[2] = {leaves[i], leaves[i + 1]};
+                leaves[count++] = XXH64(pair, sizeof(pair));
+            }
+            else
+                leaves[count++] = leaves[i];
+        }
+        leaves.resize(count);
+    }
+    return leaves[0];
+}
+
+void MerkleTree::Reset(uint64_t filesize, uint64_t blocksize)
+{
+    _filesize = filesize;
+    _blocksize = blocksize;
+    size_t count = blocksize == 0 ? 0 : (filesize + blocksize - 1) / blocksize;
+    _leaves.assign(count, 0);
+    _ready.assign(count, false);
+}
+
+size_t MerkleTree::BlockCount() const
+{
+    return _leaves.size();
+}
+
+uint64_t MerkleTree::BlockLeft(size_t index) const
+{
+    return index * _blocksize;
+}
+
+uint64_t MerkleTree::BlockRight(size_t index) const
+{
+    return std::min((index + 1) * _blocksize, _filesize) - 1;
+}
+
+bool MerkleTree::IsLeafReady(size_t index) const
+{
+    return index < _ready.size() && _ready[index];
+}
+
+void MerkleTree::SetLeaf(size_t index, uint64_t hash)
+{
+    if (index >= _leaves.size())
+        return;
+    _leaves[index] = hash;
+    _ready[index] = true;
+}
+
+uint64_t MerkleTree::Root() const
+{
+    return ChunkHashHelper::MerkleRoot(_leaves);
+}
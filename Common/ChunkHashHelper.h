@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// 分片校验使用的xxHash64，比MD5快一个数量级，且各分片之间互不依赖
+class ChunkHashHelper
+{
+public:
+    static uint64_t XXH64(const void *data, size_t length, uint64_t seed = 0);
+
+    static std::string ToHex(uint64_t hash);
+    static bool FromHex(const std::string &hex, uint64_t &hash);
+
+    // 父节点为左右子节点按小端拼接后的xxHash64，某层为奇数个节点时末尾节点直接提升
+    static uint64_t MerkleRoot(std::vector<uint64_t> leaves);
+};
+
+// 文件按固定大小切块，每块的xxHash64作为叶子，叶子可以按任意顺序填入
+class MerkleTree
+{
+public:
+    void Reset(uint64_t filesize, uint64_t blocksize);
+
+    size_t BlockCount() const;
+    uint64_t BlockLeft(size_t index) const;
+    uint64_t BlockRight(size_t index) const;
+
+    bool IsLeafReady(size_t index) const;
+    void SetLeaf(size_t index, uint64_t hash);
+    uint64_t Root() const; // 须在全部叶子就绪后调用
+
+private:
+    uint64_t _filesize = 0;
+    uint64_t _blocksize = 0;
+    std::vector<uint64_t> _leaves;
+    std::vector<bool> _ready;
+};
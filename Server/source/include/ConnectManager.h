@@ -3,6 +3,8 @@
 #include "stdafx.h"
 #include "LoginUserManager.h"
 #include "MsgManager.h"
+#include "SessionLoopGroup.h"
+#include "SessionIdleMonitor.h"
 
 class ConnectManager
 {
@@ -20,9 +22,16 @@ public:
 public:
     void SetLoginUserManager(LoginUserManager *m);
     void SetMsgManager(MsgManager *m);
+    // 文件传输消息的处理线程数，0表示按CPU核数；须在Start之前调用
+    void SetSessionLoops(unsigned count);
+    // 空闲连接的心跳与超时断开；须在Start之前调用
+    void SetIdlePolicy(const IdlePolicy &policy);
+    IdleStats GetIdleStats();
 
 private:
     std::unique_ptr<NetWorkSessionListener> listener;
+    SessionLoopGroup loops;
+    SessionIdleMonitor idlemonitor;
     SafeArray<BaseNetWorkSession *> sessions;
     std::string ip;
     int port;
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "stdafx.h"
+#include "Coroutine.h"
+
+struct FileIOUringRequest;
 
 class FileIOHandler
 {
@@ -42,9 +45,44 @@ public:
     long Write(const Buffer &buf);
     long Seek(SeekOrigin origin, long offset = 0);
 
+    // 按绝对偏移读写，基于pread/pwrite，不加锁也不改变文件位置，可由多个线程并发调用
+    // 内部处理短读写与EINTR，返回实际读写字节数，失败时返回-1
+    long ReadAt(char *buf, size_t bytesToRead, uint64_t offset) const;
+    long ReadAt(Buffer &buf, size_t bytesToRead, uint64_t offset) const;
+    long WriteAt(const char *buf, size_t bytesToWrite, uint64_t offset);
+
     bool Flush();
     long GetSize() const;
+    int64_t GetModifyTime() const; // 纳秒，失败时为0
     bool Truncate(long size);
+    bool Allocate(uint64_t size); // 按最终大小一次性分配磁盘空间，乱序写入的分片不再使文件零散增长
+
+public:
+    // 异步读写，offset为文件内绝对偏移，不影响同步接口的文件位置
+    // 请求先在本地排队，SubmitAsync时批量提交；io_uring不可用时退化为同步pread/pwrite
+    // 回调在io_uring完成线程中执行，buf须保持有效直到回调结束
+    using AsyncCallBack = std::function<void(long)>;
+    bool ReadAsync(char *buf, size_t bytesToRead, uint64_t offset, AsyncCallBack callback);
+    bool WriteAsync(const char *buf, size_t bytesToWrite, uint64_t offset, AsyncCallBack callback);
+    void SubmitAsync();
+    void WaitAsync(); // 等待本文件已提交的异步请求全部完成
+
+    // 协程等待接口，co_await返回实际读写字节数，失败时为-errno
+    struct AsyncAwaiter
+    {
+        FileIOHandler *handler;
+        bool isread;
+        char *buf;
+        size_t length;
+        uint64_t offset;
+        long result;
+
+        bool await_ready() const noexcept;
+        bool await_suspend(std::coroutine_handle<> coro); // 入队失败时不挂起，结果为-EBADF
+        long await_resume() noexcept;
+    };
+    AsyncAwaiter ReadAwait(char *buf, size_t bytesToRead, uint64_t offset);
+    AsyncAwaiter WriteAwait(const char *buf, size_t bytesToWrite, uint64_t offset);
 
 public:
     static bool Exists(const std::string &path);
@@ -55,6 +93,20 @@ public:
 
 private:
     bool CheckOpen() const;
+    bool QueueAsync(int op, char *buf, size_t length, uint64_t offset, AsyncCallBack callback);
+    void CancelQueuedAsync();
+
+    // 与回调共享，FileIOHandler析构后仍可安全计数
+    struct AsyncState
+    {
+        std::atomic<int> pending{0};
+        CriticalSectionLock lock;
+        ConditionVariable cv;
+        std::vector<int> closefds; // 在完成线程中关闭时仍有在途请求，最后一个请求完成后再关闭
+
+        void Done();
+        void CloseWhenIdle(int fd);
+    };
 
 private:
     int _fd;
@@ -63,4 +115,7 @@ private:
     long _offset;
     mutable CriticalSectionLock _mutex;
     mode_t _filemode;
+
+    std::vector<FileIOUringRequest *> _asyncqueue;
+    std::shared_ptr<AsyncState> _asyncstate;
 };
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "stdafx.h"
+#include "CriticalSectionLock.h"
+#include <liburing.h>
+#include <atomic>
+#include <thread>
+
+// 单个异步文件请求，完成后由完成线程回调并释放
+struct FileIOUringRequest
+{
+    enum OpType
+    {
+        READ,
+        WRITE
+    };
+
+    OpType op;
+    int fd;
+    uint64_t offset;
+    char *data;
+    size_t length;
+    std::function<void(long)> callback; // 参数为实际读写字节数，失败时为-errno
+
+    FileIOUringRequest(OpType t, int f, uint64_t off, char *buf, size_t len, std::function<void(long)> cb);
+    long ExecuteSync(); // io_uring不可用时的同步执行
+};
+
+// 全部FileIOHandler共用的io_uring，提交在调用线程批量完成，完成事件在独立线程中回调
+class FileIOUring
+{
+public:
+    static FileIOUring *Instance();
+
+private:
+    FileIOUring();
+
+public:
+    ~FileIOUring();
+
+    FileIOUring(const FileIOUring &) = delete;
+    FileIOUring &operator=(const FileIOUring &) = delete;
+
+    bool Init(unsigned entries = 256);
+    void Stop();
+    bool Running() const;
+    bool InCompletionCallback() const; // 当前线程正在执行完成回调，此时不能等待同一批请求完成
+
+    // 一批请求只调用一次io_uring_submit，提交队列满时先提交已准备的部分
+    void Submit(std::vector<FileIOUringRequest *> &requests);
+
+private:
+    struct PreparedRequest
+    {
+        struct io_uring_sqe *sqe;
+        FileIOUringRequest *request;
+    };
+
+    bool SubmitPrepared(std::vector<PreparedRequest> &prepared);
+    void CompletionLoop();
+
+private:
+    struct io_uring _ring;
+    std::atomic<bool> _running;
+    std::thread _completionthread;
+    CriticalSectionLock _submitlock;
+    size_t _unsubmittednops = 0; // 提交失败后改为空请求、仍留在提交队列中的数量
+};
+
+#define FILEIOURING FileIOUring::Instance()
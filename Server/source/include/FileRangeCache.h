@@ -0,0 +1,55 @@
+#pragma once
+
+#include "stdafx.h"
+#include "FileIOHandler.h"
+#include "CriticalSectionLock.h"
+#include <list>
+
+// 区间读取(4003)使用的读缓存：每个文件按固定大小分块缓存最近读取的内容，
+// 预览窗口在同一媒体文件内反复跳转时无需重复读盘
+// 缓存按文件大小与修改时间校验，文件被清理或重新写入后自动重新加载；删除文件时应调用Remove
+class FileRangeCache
+{
+public:
+    static FileRangeCache *Instance();
+
+private:
+    FileRangeCache();
+
+public:
+    ~FileRangeCache() = default;
+
+    FileRangeCache(const FileRangeCache &) = delete;
+    FileRangeCache &operator=(const FileRangeCache &) = delete;
+
+    // 读取[offset, offset + length)到dst，区间须在文件范围内
+    bool Read(const std::string &filepath, uint64_t offset, uint64_t length, char *dst);
+    void Remove(const std::string &filepath);
+
+private:
+    struct CacheBlock
+    {
+        uint64_t index;
+        std::vector<char> data;
+    };
+
+    struct CacheFile
+    {
+        FileIOHandler file;
+        uint64_t filesize = 0;
+        int64_t mtime = 0;
+        uint64_t lastused = 0;
+        CriticalSectionLock lock;
+        std::list<CacheBlock> blocks; // 最近使用的块在前
+    };
+
+    std::shared_ptr<CacheFile> AcquireFile(const std::string &filepath);
+    const CacheBlock *LoadBlock(CacheFile &cachefile, uint64_t index); // 须持有cachefile.lock
+
+private:
+    CriticalSectionLock _lock;
+    std::map<std::string, std::shared_ptr<CacheFile>> _files;
+    uint64_t _clock = 0;
+};
+
+#define FILERANGECACHE FileRangeCache::Instance()
@@ -4,18 +4,23 @@
 #include "FileTransferUploadTask.h"
 #include "FileTransferDownLoadTask.h"
 #include "LoginUserManager.h"
+#include "SessionLoopGroup.h"
 
 using namespace std;
 
 struct FileTransTaskContent
 {
     string fileid;
-    FileTransferTask *task = nullptr;
+    std::shared_ptr<FileTransferTask> task; // 处理消息与恢复时在锁内复制引用，移除后仍在进行的调用结束才析构
     BaseNetWorkSession *session = nullptr;
+    string token;                         // 发起任务的用户
+    vector<BaseNetWorkSession *> stripes; // 同一用户加入任务的附加会话
     int64_t timestamp;
 
-    FileTransTaskContent(const string &id, FileTransferTask *t, BaseNetWorkSession *s);
+    FileTransTaskContent(const string &id, std::shared_ptr<FileTransferTask> t, BaseNetWorkSession *s, const string &tk);
     ~FileTransTaskContent();
+
+    bool HasSession(BaseNetWorkSession *s);
 };
 
 class FileTransManager
@@ -32,6 +37,8 @@ public:
 
 protected:
     void AckTaskReq(BaseNetWorkSession *session, const json &js);
+    void JoinTaskStripe(BaseNetWorkSession *session, const json &js);
+    void FetchFileRange(BaseNetWorkSession *session, const json &js);
 
 public:
     void OnUploadFinish(FileTransferUploadTask *task);
@@ -43,21 +50,32 @@ public:
     void OnDownloadError(FileTransferDownLoadTask *task);
     void OnDownloadInterrupt(FileTransferDownLoadTask *task);
     void OnDownloadProgress(FileTransferDownLoadTask *task, uint32_t progress);
+    void OnDownloadWritten(const string &fileid, FileTransferDownLoadTask *task);
 
     void SetLoginUserManager(LoginUserManager *m);
+    void SetSessionLoopGroup(SessionLoopGroup *g);
     void SessionClose(BaseNetWorkSession *session);
+    size_t SessionTaskCount(BaseNetWorkSession *session); // 发起或加入分条的任务数
+    void ResumeTask(const string &taskid); // 供TransferScheduler回调
+    void PostResumeTask(const string &taskid); // 供时间轮回调，转到任务发起会话的处理线程执行
 
 private:
     FileTransManager();
-    bool AddUploadTask(const string &fileid, const string &taskid, const string &filepath, const string &md5, BaseNetWorkSession *session);
-    bool AddDownloadTask(const string &fileid, const string &taskid, const string &filepath, const string &md5, uint64_t filesize, BaseNetWorkSession *session);
+    bool AddUploadTask(const string &fileid, const string &taskid, const string &filepath, const string &md5, uint64_t filesize, BaseNetWorkSession *session, const string &token,
+                       std::shared_ptr<FileRelaySource> relaysource = nullptr);
+    bool AddDownloadTask(const string &fileid, const string &taskid, const string &filepath, const string &md5, uint64_t filesize, BaseNetWorkSession *session, const string &token);
     void DeleteTask(const string &taskid);
     void CleanExpireTask();
     void UpdateTimeStamp(const string &taskid);
+    std::shared_ptr<FileRelaySource> FindRelaySource(const string &fileid);
+    std::shared_ptr<FileRelaySource> TakeRelaySource(const string &fileid);
+    void NotifyRelayWaiters(std::shared_ptr<FileRelaySource> source);
 
 private:
     SafeMap<string, FileTransTaskContent *> m_tasks; // taskid->content
+    SafeMap<string, std::shared_ptr<FileRelaySource>> m_relaysources; // fileid->正在接收中的文件
     LoginUserManager *HandleLoginUser;
+    SessionLoopGroup *HandleLoops = nullptr;
     std::shared_ptr<TimerTask> CleanExpiredTask;
 };
 
@@ -1,6 +1,7 @@
 #pragma once
 #include "FileTransferTask.h"
 #include "AsyncMD5.h"
+#include "ChunkHashHelper.h"
 
 struct MD5CheckPoint
 {
@@ -10,6 +11,25 @@ struct MD5CheckPoint
     MD5CheckPoint();
 };
 
+// __check文件的定长二进制记录，恢复时一次读取即可
+struct MD5CheckPointRecord
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t progress;
+    uint32_t cachesize;    // cache中有效字节数，始终小于一个MD5分组
+    uint32_t status[4];
+    uint64_t count;
+    uint8_t cache[64];
+    uint8_t isfinish;
+    char md5string[32];
+    uint32_t checksum;     // 对checksum之前的全部字节计算
+
+    MD5CheckPointRecord();
+    uint32_t CalcChecksum() const;
+    bool IsValid() const;
+};
+
 class FileTransferDownLoadTask : public FileTransferTask
 {
 public:
@@ -20,13 +40,16 @@ public:
     virtual void ProcessMsg(BaseNetWorkSession *session, const json &js, Buffer &buf);
     virtual void ReleaseSource();
     virtual void InterruptTrans(BaseNetWorkSession *session);
+    virtual void ResumeTrans(BaseNetWorkSession *session);
 
     void BindErrorCallBack(std::function<void(FileTransferDownLoadTask *)> callback);
     void BindFinishedCallBack(std::function<void(FileTransferDownLoadTask *)> callback);
     void BindInterruptedCallBack(std::function<void(FileTransferDownLoadTask *)> callback);
     void BindProgressCallBack(std::function<void(FileTransferDownLoadTask *, uint32_t)> callback);
+    void BindWrittenCallBack(std::function<void(FileTransferDownLoadTask *)> callback); // 异步写入完成后在io_uring完成线程调用
 
     void RegisterTransInfo(const string &filepath, const string &md5, uint64_t filesize); // 使用提前注册好的传输信息，而非被动接收对方的信息，在确认信息时执行校验行为
+    vector<FileTransferChunkInfo> WrittenChunkMap(); // 已写入文件的区间，可以安全地从文件读取
 protected:
     virtual void OnError();
     virtual void OnFinished();
@@ -42,34 +65,60 @@ protected:
 
     void RecvTransReq(BaseNetWorkSession *session, const json &js);
     void AckTransReq(BaseNetWorkSession *session, const json &js);
-    void RecvChunkDataAndAck(BaseNetWorkSession *session, const json &js, Buffer &buf);
+    void RecvChunkDataAndAck(BaseNetWorkSession *session, const json &js, Buffer &buf, bool chunkhashok);
+    bool VerifyChunkHash(const json &js, const Buffer &buf);
     void AckRecvFinished(BaseNetWorkSession *session, const json &js);
     void SendErrorInfo(BaseNetWorkSession *session);
     void RecvPeerError(const json &js);
     void RecvPeerInterrupt(const json &js);
+    virtual void OnStripeSessionRemoved(BaseNetWorkSession *session);
 
 private:
     bool ParseFile();
     bool ReadChunkFile();
     bool ReadMD5ChcekPointFile();
     bool ParseChunkMap(const json &js);
-    bool ParseMd5CheckPoint(const json &js);
+    bool ParseMd5CheckPoint(const MD5CheckPointRecord &record);
     bool WriteToChunkFile();
+    bool AppendToChunkFile(const vector<FileTransferChunkInfo> &chunks);
+    bool WriteChunkBehind(Buffer &buf, uint64_t range_left, uint64_t range_right);
+    bool WaitChunkWrites();
+    void FlushBookkeeping(bool force);
+    void ParseChunkMapEncoding(const json &js);
+    void ParseChunkHash(const json &js);
     void WriteToMD5CheckFile();
     bool CheckTransFinish();
 
     void AsyncMD5Update();
     std::string AsyncMD5Final();
 
+    void MerkleUpdate(uint64_t range_left, uint64_t range_right, const char *data, const vector<FileTransferChunkInfo> &written);
+    bool MerkleFinal();
+    bool CheckFileIntegrity();
+
 protected:
     std::function<void(FileTransferDownLoadTask *)> _callbackError;
     std::function<void(FileTransferDownLoadTask *)> _callbackFinieshed;
     std::function<void(FileTransferDownLoadTask *)> _callbackInterrupted;
     std::function<void(FileTransferDownLoadTask *, uint32_t)> _callbackProgress;
+    std::function<void(FileTransferDownLoadTask *)> _callbackWritten;
 
 private:
     bool IsChunkFileEnable = false;
     FileIOHandler chunkfile_io;
+    bool IsBinaryChunkMap = false; // 对端支持二进制chunk_map时，8001只回复本次确认的区间
+    vector<std::pair<BaseNetWorkSession *, json>> pending_acks; // 接收带宽超出限额时推迟发送的8001及承载分片的会话，为空时使用发起会话
+
+    // 分片写入走io_uring写回队列，确认不再等待落盘；__chunks只记录写入完成的区间，按固定间隔追加
+    CriticalSectionLock WriteLock;
+    vector<FileTransferChunkInfo> written_map;      // 写入已完成的区间，MD5、Merkle与转发只读取这些区间
+    vector<FileTransferChunkInfo> unflushed_chunks; // 写入已完成但尚未记录到__chunks的区间
+    std::atomic<bool> IsAsyncWriteFailed{false};
+    int64_t last_flush_time = 0;
+
+    std::atomic<bool> IsChunkHash{false}; // 协商使用分片哈希与Merkle根，此时不再计算MD5
+    uint64_t merkle_root = 0;             // 发送端提供的Merkle根
+    MerkleTree merkle_tree;               // 叶子只保存在内存中，恢复传输后缺失的叶子在结束时从文件补算
     
     bool IsRegister = false;
     AsyncMD5 _asyncmd5;
@@ -13,6 +13,18 @@ struct FileTransferChunkInfo
     FileTransferChunkInfo(int index, uint64_t left, uint64_t right) : index(index), range_left(left), range_right(right) {}
 };
 
+// 已发出但尚未被对端确认的分片
+struct FileTransferInflightChunk
+{
+    uint64_t range_left;
+    uint64_t range_right;
+    int64_t sendtime;           // 发送时间(毫秒)，用于超时重传
+    bool retransmitted = false; // 重传过的分片无法区分确认对应哪次发送，不参与RTT采样
+    bool expired = false;       // 不等超时，下次发送时立即重传
+    BaseNetWorkSession *session; // 承载该分片的会话，会话退出分条时其上的分片立即重传
+    FileTransferInflightChunk(uint64_t left, uint64_t right, int64_t time, BaseNetWorkSession *s) : range_left(left), range_right(right), sendtime(time), session(s) {}
+};
+
 struct FileTransferChunkData
 {
     uint64_t range_left;
@@ -26,8 +38,108 @@ std::string getFilenameFromPath(const std::string &filepath);
 std::vector<FileTransferChunkInfo> mergeChunks(const std::vector<FileTransferChunkInfo> &chunks);
 std::vector<FileTransferChunkInfo> getUntransferredChunks(const std::vector<FileTransferChunkInfo> &transferredChunks, uint64_t totalFileSize);
 uint32_t CountProgress(const std::vector<FileTransferChunkInfo> &chunks, uint64_t totalFileSize);
+void insertChunk(std::vector<FileTransferChunkInfo> &merged, uint64_t left, uint64_t right); // 向已合并的区间表插入区间，保持有序且不重叠
+
+// chunk_map的紧凑二进制编码，随消息的buffer部分发送: [uint32 count][count * (uint64 left, uint64 right)]
+constexpr uint32_t ChunkMapEncodingBinary = 1;
+void EncodeChunkMap(const std::vector<FileTransferChunkInfo> &chunks, Buffer &buf);
+bool DecodeChunkMap(Buffer &buf, std::vector<FileTransferChunkInfo> &chunks);
+json ChunkMapToJson(const std::vector<FileTransferChunkInfo> &chunks);
 uint64_t GetSuggestChunsize(uint64_t file_size);
 
+// 分片哈希：双方在7000/8000中协商chunk_hash后，7001的buffer在分片数据后追加8字节的xxHash64(小端)，
+// 接收端到达即校验，文件按MerkleBlockSize切块得到的Merkle根在结束时代替MD5校验
+constexpr uint32_t ChunkHashXXH64 = 1;
+constexpr uint64_t MerkleBlockSize = 1024 * 1024;
+constexpr uint64_t ChunkHashSize = sizeof(uint64_t);
+bool ComputeFileMerkleRoot(const FileIOHandler &file, uint64_t filesize, uint64_t &root);
+bool GetFileMerkleRoot(const FileIOHandler &file, uint64_t filesize, uint64_t &root); // 按路径缓存，文件大小与修改时间不变时不再重新计算
+uint32_t GetTransferWindowSize();            // 发送端允许同时在途的最大分片数
+void SetTransferWindowSize(uint32_t window); // 设置为1时退化为停等模式
+
+enum class ChunkSizePolicyType
+{
+    FIXED = 0,   // 始终使用接收端建议的分片大小
+    ADAPTIVE = 1 // 根据确认往返时间与有效吞吐动态调整
+};
+
+// 发送端的分片大小策略，每次填充窗口前查询下一个分片的大小
+class ChunkSizePolicy
+{
+public:
+    virtual ~ChunkSizePolicy() = default;
+    virtual uint64_t ChunkSize() const = 0;
+    virtual void OnChunkAcked(uint64_t chunksize, int64_t rttms, int64_t nowms) = 0; // rttms<0表示不参与RTT采样
+    virtual void OnChunkTimeout() = 0;
+};
+
+class FixedChunkSizePolicy : public ChunkSizePolicy
+{
+public:
+    FixedChunkSizePolicy(uint64_t chunksize);
+    virtual uint64_t ChunkSize() const;
+    virtual void OnChunkAcked(uint64_t chunksize, int64_t rttms, int64_t nowms);
+    virtual void OnChunkTimeout();
+
+private:
+    uint64_t chunksize;
+};
+
+// 以最小RTT与近期最大有效吞吐估计带宽时延积，使窗口内在途数据量保持在其两倍，
+// 每次调整幅度限制在一半到两倍之间，单个任务在途数据总量受内存上限约束
+class AdaptiveChunkSizePolicy : public ChunkSizePolicy
+{
+public:
+    AdaptiveChunkSizePolicy(uint64_t initchunksize, uint32_t window);
+    virtual uint64_t ChunkSize() const;
+    virtual void OnChunkAcked(uint64_t chunksize, int64_t rttms, int64_t nowms);
+    virtual void OnChunkTimeout();
+
+private:
+    uint64_t MaxChunkSize() const;
+
+private:
+    uint64_t chunksize;
+    uint32_t window;
+    int64_t srtt = 0;         // 平滑RTT(毫秒)
+    int64_t minrtt = 0;       // 最小RTT(毫秒)，近似无排队时的链路时延
+    double btlbw = 0;         // 估计的瓶颈带宽(字节/毫秒)
+    uint64_t sampledbytes = 0;
+    int64_t samplestart = 0;
+};
+
+// 发送端的滑动窗口：记录已发送未确认的分片，按接收端已确认的区间释放，超时的分片选择性重传
+// 窗口为1时每次只有一个在途分片，退化为停等模式
+class ChunkSendWindow
+{
+public:
+    void Reset(uint32_t window); // 清空在途分片并设置窗口大小，最小为1
+    void Clear();
+
+    uint32_t WindowSize() const;
+    size_t InflightCount() const;
+    bool IsFull() const;
+
+    void Add(uint64_t left, uint64_t right, int64_t now, BaseNetWorkSession *session);
+    // 释放被acked完全覆盖的分片，每个分片回调一次(分片大小, RTT)，重传过的分片RTT为-1
+    void Release(const vector<FileTransferChunkInfo> &acked, int64_t now, const std::function<void(uint64_t, int64_t)> &onacked);
+    // 对超时的分片调用resend重发，resend返回承载重发的会话，返回nullptr表示发送失败
+    // 返回重发的分片数，发送失败时返回-1
+    int RetransmitExpired(int64_t now, int64_t timeoutms, const std::function<BaseNetWorkSession *(uint64_t, uint64_t)> &resend);
+    void ExpireRange(uint64_t left, uint64_t right);       // 标记为立即超时
+    void ExpireSession(BaseNetWorkSession *session);       // 该会话上的分片标记为立即超时
+    int64_t NextDeadline(int64_t timeoutms) const;         // 最早的重传时间，有立即重传的分片时返回0，没有在途分片时返回-1
+    void AppendInflight(vector<FileTransferChunkInfo> &chunks) const; // 追加在途区间，填充窗口时与已确认区间一起排除
+
+private:
+    uint32_t window_size = 1;
+    vector<FileTransferInflightChunk> inflight_chunks;
+};
+
+ChunkSizePolicyType GetChunkSizePolicyType();
+void SetChunkSizePolicyType(ChunkSizePolicyType type);
+std::unique_ptr<ChunkSizePolicy> CreateChunkSizePolicy(uint64_t initchunksize, uint32_t window);
+
 class FileTransferTask
 {
 public:
@@ -41,6 +153,14 @@ public:
     virtual void ProcessMsg(BaseNetWorkSession *session, const json &js, Buffer &buf) = 0;
     virtual void ReleaseSource() = 0;
     virtual void InterruptTrans(BaseNetWorkSession *session) = 0;
+    virtual void ResumeTrans(BaseNetWorkSession *session) = 0; // 调度器分配到带宽后继续传输
+
+    // 任务从管理者移除后调用，此后到达的消息与恢复回调直接忽略，返回后不再使用任何会话
+    void Close();
+
+    // 分条传输：同一用户额外建立的会话加入任务后，发送端轮流使用各会话发送分片
+    void AddStripeSession(BaseNetWorkSession *session);
+    void RemoveStripeSession(BaseNetWorkSession *session);
 
 protected:
     virtual void OnError() = 0;
@@ -55,6 +175,9 @@ protected:
 
     virtual uint32_t Progress() = 0;
 
+    BaseNetWorkSession *NextStripeSession(BaseNetWorkSession *session); // 没有加入的会话时返回session
+    virtual void OnStripeSessionRemoved(BaseNetWorkSession *session) {} // 持任务锁调用，转移仍指向该会话的待发送内容
+
 protected:
     string file_path;
     string _md5;
@@ -71,6 +194,11 @@ protected:
     bool IsTransFinish = false;
 
     bool IsNetworkEnable = true;
+    bool IsClosed = false; // 已从管理者移除，会话可能随时被回收
 
     CriticalSectionLock InterruptedLock;
+
+    vector<BaseNetWorkSession *> stripe_sessions; // 除发起会话外加入任务的会话
+    uint32_t stripe_cursor = 0;
+    CriticalSectionLock StripeLock;
 };
@@ -1,6 +1,28 @@
 #pragma once
 
 #include "FileTransferTask.h"
+#include "TimingWheel.h"
+
+// 服务器正在接收中的文件，同一文件的下载任务据此边收边发
+// 由接收任务的写入完成回调更新，转发任务只发送已落盘的区间
+class FileRelaySource
+{
+public:
+    void Update(const vector<FileTransferChunkInfo> &chunkmap);
+    void MarkCompleted();
+    void MarkFailed();
+    void Snapshot(vector<FileTransferChunkInfo> &chunkmap, bool &completed, bool &failed);
+
+    void AddWaiter(const string &taskid);
+    vector<string> Waiters();
+
+private:
+    CriticalSectionLock _lock;
+    vector<FileTransferChunkInfo> _chunkmap;
+    bool _completed = false;
+    bool _failed = false;
+    vector<string> _waiters; // 等待新数据的转发任务
+};
 
 class FileTransferUploadTask : public FileTransferTask
 {
@@ -10,15 +32,19 @@ public:
 
 public:
     bool StartSendFile(BaseNetWorkSession *session);
+    void SetRelaySource(std::shared_ptr<FileRelaySource> source, uint64_t filesize); // 须在StartSendFile之前调用
 
     virtual void ProcessMsg(BaseNetWorkSession *session, const json &js, Buffer &buf);
     virtual void ReleaseSource();
     virtual void InterruptTrans(BaseNetWorkSession *session);
+    virtual void ResumeTrans(BaseNetWorkSession *session);
 
     void BindErrorCallBack(std::function<void(FileTransferUploadTask *)> callback);
     void BindFinishedCallBack(std::function<void(FileTransferUploadTask *)> callback);
     void BindInterruptedCallBack(std::function<void(FileTransferUploadTask *)> callback);
     void BindProgressCallBack(std::function<void(FileTransferUploadTask *, uint32_t)> callback);
+    void BindResumeCallBack(std::function<void()> callback); // 接收方连接拥塞解除后调用，由管理者转为ResumeTrans
+    void BindRetransmitCallBack(std::function<void()> callback); // 最早的在途分片超时后在时间轮线程调用，由管理者转到会话处理线程执行ResumeTrans
 
 protected:
     virtual void OnError();
@@ -34,26 +60,47 @@ protected:
     virtual uint32_t Progress();
 
     void SendTransReq(BaseNetWorkSession *session);
-    void AckTransReqResult(BaseNetWorkSession *session, const json &js);
+    void AckTransReqResult(BaseNetWorkSession *session, const json &js, Buffer &buf);
     void RecvChunkMapAndSendNextData(BaseNetWorkSession *session, const json &js);
+    bool RecvChunkHashMismatch(const json &js);
     void SendNextChunkData(BaseNetWorkSession *session);
+    bool FilterRelayChunks(vector<FileTransferChunkInfo> &chunks);
+    bool OpenRelayFile();
+    bool SendChunkData(BaseNetWorkSession *stripe, uint64_t range_left, uint64_t range_right);
+    void ReleaseAckedChunks();
+    bool RetransmitExpiredChunks(BaseNetWorkSession *session);
+    void ArmRetransmitTimer();
+    void CancelRetransmitTimer();
     void SendErrorInfo(BaseNetWorkSession *session);
     void RecvPeerError(const json &js);
     void RecvPeerFinish(const json &js);
     void RecvPeerInterrupt(const json &js);
+    virtual void OnStripeSessionRemoved(BaseNetWorkSession *session);
 
 private:
     bool ParseFile();
     bool ParseReqResult(const json &js);
-    bool ParseChunkMap(const json &js);
+    bool ParseChunkMap(const json &js, Buffer &buf);
     bool ParseSuggestChunkSize(const json &js);
+    void ParseWindowSize(const json &js);
+    void ParseChunkHash(const json &js);
 
 protected:
     std::function<void(FileTransferUploadTask *)> _callbackError;
     std::function<void(FileTransferUploadTask *)> _callbackFinieshed;
     std::function<void(FileTransferUploadTask *)> _callbackInterrupted;
     std::function<void(FileTransferUploadTask *, uint32_t)> _callbackProgress;
+    std::function<void()> _callbackResume;
+    std::function<void()> _callbackRetransmit;
 
 private:
     uint64_t suggest_chunksize = 1;
+    std::unique_ptr<ChunkSizePolicy> chunk_policy;         // 协商完成后按接收端建议的大小创建
+
+    ChunkSendWindow send_window;                           // 与接收端协商窗口大小后记录已发送未确认的分片
+    TimingWheel::TimerId retransmit_timer = 0;             // 最早在途分片超时的时间轮定时器
+    bool IsFinishSent = false;
+    bool IsChunkHash = false;                              // 对端接受分片哈希，7001数据后追加xxHash64
+    std::atomic<bool> IsAsyncSendFailed{false};            // 异步读取或发送分片失败
+    std::shared_ptr<FileRelaySource> relay_source;         // 非空时文件仍在上传中，只发送已到达的区间
 };
\ No newline at end of file
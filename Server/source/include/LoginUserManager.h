@@ -41,7 +41,8 @@ public:
     static string PublicChatToken();
     static bool IsPublicChat(const string &token);
 
-private:
+public:
+    // 仅校验jwt签名并取出token，不要求会话已登录，用于同一用户建立的附加连接
     static bool VerfiyJwtToken(const string &jwtstr, string &token);
 
 public:
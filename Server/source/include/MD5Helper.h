@@ -15,6 +15,13 @@ struct MD5Context
     MD5Context();
 };
 
+// 多缓冲计算中的一路：status为该路Context的状态，block为本次处理的64字节分组
+struct MD5LaneBlock
+{
+    unsigned int *status;
+    const unsigned char *block;
+};
+
 class MD5Helper
 {
 public:
@@ -34,4 +41,9 @@ public:
     static std::shared_ptr<MD5Context> MD5Ctx_Init();                                                                 // 获取Context
     static void MD5Ctx_Update(std::shared_ptr<MD5Context> ctx, const unsigned char *data, unsigned long long length); // 向Context填入数据并计算分块
     static std::string MD5Ctx_Final(std::shared_ptr<MD5Context> ctx);                                                 // 完成计算，返回MD5字符串
+
+    // 多缓冲计算：一次为最多MD5LaneWidth()个互不相关的Context各处理一个分组
+    // 运行时按CPU支持选择AVX2(8路)、SSE2(4路)，否则逐路使用标量实现
+    static int MD5LaneWidth();
+    static void MD5ProcessLanes(const MD5LaneBlock *lanes, int count);
 };
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "MD5Helper.h"
+#include "CriticalSectionLock.h"
+#include <deque>
+#include <functional>
+#include <thread>
+
+// 多缓冲MD5调度器：各个AsyncMD5的更新请求在此排队，工作线程把不同的Context放进不同的路，
+// 每次为所有路各推进一个分组；某一路的数据处理完后立即换入下一个请求
+// 单个Context的计算仍是串行的，吞吐的提升来自同时进行的多个传输任务
+class MD5MultiBuffer
+{
+public:
+    static MD5MultiBuffer *Instance();
+
+private:
+    MD5MultiBuffer();
+
+public:
+    ~MD5MultiBuffer();
+
+    MD5MultiBuffer(const MD5MultiBuffer &) = delete;
+    MD5MultiBuffer &operator=(const MD5MultiBuffer &) = delete;
+
+    // 同一个ctx在上一次请求完成前不能再次提交；ctxlock在计算期间持有，用于与读取快照互斥
+    // callback在工作线程中调用
+    void Submit(std::shared_ptr<MD5Context> ctx, std::shared_ptr<Buffer> data,
+                CriticalSectionLock *ctxlock, std::function<void()> callback);
+
+private:
+    struct Job
+    {
+        std::shared_ptr<MD5Context> ctx;
+        std::shared_ptr<Buffer> data;
+        CriticalSectionLock *ctxlock = nullptr;
+        std::function<void()> callback;
+    };
+
+    struct Lane
+    {
+        Job job;
+        unsigned char head[64]; // 上次剩余的缓存与本次数据的开头拼成的第一个分组
+        bool hashead = false;
+        uint64_t dataoffset = 0; // 第一个完整分组在data中的起始位置
+        uint64_t blocks = 0;     // 总分组数，含head
+        uint64_t processed = 0;
+
+        const unsigned char *NextBlock() const;
+    };
+
+    bool TakeJob(Job &job, bool wait);
+    bool LoadLane(Lane &lane, Job &job); // 数据不足一个分组时直接并入缓存并完成，返回false
+    void FinishLane(Lane &lane);
+    void WorkLoop();
+
+private:
+    std::deque<Job> _jobs;
+    CriticalSectionLock _lock;
+    ConditionVariable _cv;
+    std::vector<std::thread> _workers;
+    bool _stop;
+};
+
+#define MD5MULTIBUFFER MD5MultiBuffer::Instance()
@@ -34,3 +34,9 @@ bool AnalysisMessagePackageFromBuffer(Buffer *buf, MessagePackage *package);
 // input package
 // output buf
 void GenerateMessagePackageToBuffer(MessagePackage *package, Buffer *buf);
+
+// input json, bufferlen
+// output buf
+// 只写入消息头和json部分，并为buffer部分预留bufferlen字节，返回buffer部分在buf中的起始位置，
+// 调用方直接向预留区域填充数据，省去先拷贝到MessagePackage再拷贝到buf的两次拷贝
+uint64_t GenerateMessagePackageHeaderToBuffer(json &nlmjson, uint64_t bufferlen, Buffer *buf);
@@ -2,6 +2,7 @@
 
 #include "stdafx.h"
 #include "LoginUserManager.h"
+#include "SessionLoopGroup.h"
 
 class LoginUserManager;
 
@@ -25,9 +26,14 @@ private:
     // 广播公共频道消息
     bool BroadCastPublicChatMsg(const string& token, json &js_src, Buffer &buf_src);
 
+    // 文件传输相关的消息
+    static bool IsFileTransCommand(int command);
+
 public:
     void SetLoginUserManager(LoginUserManager *m);
+    void SetSessionLoopGroup(SessionLoopGroup *g);
 
 private:
     LoginUserManager *HandleLoginUser = nullptr;
+    SessionLoopGroup *HandleLoops = nullptr; // 文件传输消息在会话绑定的处理线程上执行
 };
\ No newline at end of file
@@ -2,11 +2,13 @@
 #include "stdafx.h"
 #include "Net/include/Session/BaseNetWorkSession.h"
 #include "MessagePackage.h"
+#include "OutboundLimiter.h"
 
+// 经OutboundLimiter发送，接收方过慢时DROPPABLE消息被丢弃并返回false
 namespace NetWorkHelper
 {
-    bool SendMessagePackage(BaseNetWorkSession *session, json *json);
-    bool SendMessagePackage(BaseNetWorkSession *session, Buffer *buf);
-    bool SendMessagePackage(BaseNetWorkSession *session, json *json, Buffer *buf);
-    bool SendMessagePackage(BaseNetWorkSession *session, MessagePackage *package);
+    bool SendMessagePackage(BaseNetWorkSession *session, json *json, SendPriority priority = SendPriority::NORMAL);
+    bool SendMessagePackage(BaseNetWorkSession *session, Buffer *buf, SendPriority priority = SendPriority::NORMAL);
+    bool SendMessagePackage(BaseNetWorkSession *session, json *json, Buffer *buf, SendPriority priority = SendPriority::NORMAL);
+    bool SendMessagePackage(BaseNetWorkSession *session, MessagePackage *package, SendPriority priority = SendPriority::NORMAL);
 }
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "stdafx.h"
+#include "CriticalSectionLock.h"
+#include "TimingWheel.h"
+#include <deque>
+
+enum class SendPriority
+{
+    NORMAL = 0,   // 始终入队，文件分片等大流量由发送方通过WaitWritable自行暂停
+    DROPPABLE = 1 // 公共频道广播等，会话拥塞时直接丢弃
+};
+
+// 慢速接收方的处理策略，排队字节数以连接发送队列中尚未写出的帧估算
+struct OutboundLimits
+{
+    uint64_t highwatermark = 16 * 1024 * 1024; // 超过后会话进入拥塞状态
+    uint64_t lowwatermark = 4 * 1024 * 1024;   // 拥塞后降到此值以下才恢复
+    bool dropdroppable = true;                 // 拥塞时丢弃DROPPABLE帧
+    bool pausetransfers = true;                // 拥塞时暂停文件发送，恢复后回调
+    int64_t disconnectms = 60000;              // 持续拥塞超过该时长断开连接，0表示不断开
+};
+
+// 单个会话经OutboundLimiter发出、可能仍在连接发送队列中的帧
+struct OutboundSession
+{
+    std::deque<uint64_t> frames; // 按发送顺序的帧大小
+    uint64_t queuedbytes = 0;
+    bool congested = false;
+    int64_t congestedsince = 0;
+    bool disconnecting = false;
+    uint64_t droppedframes = 0;
+    std::map<const void *, std::function<void()>> resumes; // 按等待方登记，恢复后各回调一次
+};
+
+// 会话出站队列的高低水位背压：连接只暴露发送队列中的帧数，按发送顺序记录每帧大小，
+// 队列中剩余n帧即对应最近发出的n帧，由此估算排队字节数
+class OutboundLimiter
+{
+public:
+    static OutboundLimiter *Instance();
+
+private:
+    OutboundLimiter();
+
+public:
+    ~OutboundLimiter();
+
+    OutboundLimiter(const OutboundLimiter &) = delete;
+    OutboundLimiter &operator=(const OutboundLimiter &) = delete;
+
+    void SetLimits(const OutboundLimits &limits);
+
+    // 拥塞时按策略丢弃DROPPABLE帧并返回false，其余帧持锁交给会话发送，发送失败不计入排队字节
+    bool Send(BaseNetWorkSession *session, const Buffer &buf, SendPriority priority = SendPriority::NORMAL);
+
+    // 未拥塞时返回true；拥塞且开启暂停时登记resume并返回false，降到低水位后回调一次
+    // 同一waiter在恢复前重复调用只保留一个回调，以最后一次登记的为准
+    bool WaitWritable(BaseNetWorkSession *session, const void *waiter, std::function<void()> resume);
+
+    bool IsCongested(BaseNetWorkSession *session);
+    uint64_t QueuedBytes(BaseNetWorkSession *session);
+
+    // 会话关闭时调用
+    void RemoveSession(BaseNetWorkSession *session);
+
+private:
+    static uint64_t PendingFrames(BaseNetWorkSession *session);
+    static void Disconnect(BaseNetWorkSession *session);
+
+    void Refresh(BaseNetWorkSession *session, OutboundSession &state); // 回收已写出的帧
+    void Poll();
+
+private:
+    std::map<BaseNetWorkSession *, OutboundSession> _sessions;
+    OutboundLimits _limits;
+    CriticalSectionLock _lock;
+    TimingWheel::TimerId PollTimer = 0;
+};
+
+#define OUTBOUNDLIMITER OutboundLimiter::Instance()
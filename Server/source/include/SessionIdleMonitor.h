@@ -0,0 +1,62 @@
+#pragma once
+
+#include "stdafx.h"
+#include "CriticalSectionLock.h"
+#include "TimingWheel.h"
+#include <unordered_map>
+
+// 空闲连接的检测策略，时长均为毫秒
+struct IdlePolicy
+{
+    int64_t heartbeatms = 30000; // 连续这么久未收到数据时发送心跳，对端回应心跳即视为存活，0表示不发送
+    int64_t timeoutms = 90000;   // 超过该时长未收到任何数据判定为死连接并断开，0表示不检测
+};
+
+// 因空闲超时回收的会话，以及断开时它们仍占用的资源
+struct IdleStats
+{
+    uint64_t heartbeats = 0;
+    uint64_t reclaimedsessions = 0;
+    uint64_t reclaimedbytes = 0; // 出站队列中尚未写出的字节数
+    uint64_t reclaimedtasks = 0; // 仍绑定在会话上的文件传输任务数
+};
+
+// 每个会话一个时间轮定时器：收到数据只记录时间，定时器到期时再按最后活跃时间决定发送心跳、断开或顺延，
+// 收发频繁的会话不会反复重设定时器
+class SessionIdleMonitor
+{
+public:
+    SessionIdleMonitor();
+    ~SessionIdleMonitor();
+
+    // 只影响之后建立的会话，须在Start之前调用
+    void SetPolicy(const IdlePolicy &policy);
+
+    void AddSession(BaseNetWorkSession *session);
+    void RemoveSession(BaseNetWorkSession *session);
+    void Touch(BaseNetWorkSession *session);
+
+    IdleStats GetStats();
+
+    static bool IsHeartBeat(const Buffer &buf);
+
+private:
+    struct IdleSession
+    {
+        uint64_t serial = 0; // 区分复用同一地址的会话，过期的定时器回调据此忽略
+        int64_t lastactive = 0;
+        int64_t lastheartbeat = 0;
+        TimingWheel::TimerId timer = 0;
+    };
+
+    void Schedule(BaseNetWorkSession *session, IdleSession &state, int64_t delayms);
+    void OnTimer(BaseNetWorkSession *session, uint64_t serial);
+    void Reclaim(BaseNetWorkSession *session, int64_t idlems);
+
+private:
+    std::unordered_map<BaseNetWorkSession *, IdleSession> _sessions;
+    IdlePolicy _policy;
+    IdleStats _stats;
+    uint64_t _serial;
+    CriticalSectionLock _lock;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "stdafx.h"
+#include "CriticalSectionLock.h"
+#include <deque>
+#include <thread>
+#include <unordered_map>
+
+// 会话消息的处理线程组：网络线程只负责解包，消息交给会话绑定的处理线程执行
+// 每个会话在建立后固定绑定到一个线程，同一会话的消息保持到达顺序，不同会话的消息在多个核上并行处理
+class SessionLoopGroup
+{
+public:
+    SessionLoopGroup();
+    ~SessionLoopGroup();
+
+    SessionLoopGroup(const SessionLoopGroup &) = delete;
+    SessionLoopGroup &operator=(const SessionLoopGroup &) = delete;
+
+    // count为0时按CPU核数创建；未启动时Post直接在调用线程执行
+    void Start(unsigned count = 0);
+    void Stop();
+    size_t LoopCount();
+
+    void Post(BaseNetWorkSession *session, std::function<void()> work);
+    // 只投递给已绑定的会话，不为其新建绑定：未启动时直接执行，会话已Release时丢弃并返回false
+    bool PostPinned(BaseNetWorkSession *session, std::function<void()> work);
+    // 会话关闭时调用：等待该会话已提交的消息处理完毕并解除绑定，返回后不会再有该会话的任务执行
+    void Release(BaseNetWorkSession *session);
+
+private:
+    struct LoopWork
+    {
+        BaseNetWorkSession *session;
+        std::function<void()> work;
+    };
+
+    struct Loop
+    {
+        std::thread thread;
+        std::deque<LoopWork> works;
+        CriticalSectionLock lock;
+        ConditionVariable cv;
+        size_t sessions = 0; // 绑定的会话数，新会话绑定到最空闲的线程
+        bool stop = false;
+    };
+
+    Loop *PinnedLoop(BaseNetWorkSession *session, bool create);
+    void LoopRun(Loop *loop);
+
+private:
+    std::vector<std::unique_ptr<Loop>> _loops;
+    std::unordered_map<BaseNetWorkSession *, Loop *> _pinned;
+    CriticalSectionLock _lock;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "CriticalSectionLock.h"
+#include <functional>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+
+// 分层时间轮：第0层256个槽位，其余三层各64个，以tickms为精度覆盖2^26个tick，更远的超时先挂在最高层，级联时重新计算
+// 所有定时器共用一个timerfd与一个驱动线程，添加、取消与重设均为O(1)，节点复用不随定时器分配
+// 回调在驱动线程中、不持锁执行，可以在回调中添加或取消定时器，但应尽快返回
+class TimingWheel
+{
+public:
+    using Callback = std::function<void()>;
+    using TimerId = uint64_t; // 0表示无效
+
+    static TimingWheel *Instance();
+
+    explicit TimingWheel(uint64_t tickms = 10);
+    ~TimingWheel();
+
+    TimingWheel(const TimingWheel &) = delete;
+    TimingWheel &operator=(const TimingWheel &) = delete;
+
+    bool Start(); // 创建timerfd与驱动线程
+    void Stop();
+
+    // delayms后触发，intervalms非0时之后按该周期重复
+    TimerId Schedule(uint64_t delayms, Callback callback, uint64_t intervalms = 0);
+    bool Cancel(TimerId id);
+    // 把尚未触发的定时器改为delayms之后触发，用于空闲超时在每次收发后续期
+    bool Reschedule(TimerId id, uint64_t delayms);
+
+    // 推进ticks个tick并执行到期的回调；未调用Start时由调用方驱动
+    void Advance(uint64_t ticks);
+
+    uint64_t TickMs() const;
+    size_t Size();
+
+    // co_await TIMINGWHEEL->Sleep(ms)，协程在驱动线程中恢复
+    struct SleepAwaiter
+    {
+        TimingWheel *wheel;
+        uint64_t delayms;
+
+        bool await_ready() const noexcept { return delayms == 0; }
+        void await_suspend(std::coroutine_handle<> coro) { wheel->Schedule(delayms, [coro]() { coro.resume(); }); }
+        void await_resume() noexcept {}
+    };
+    SleepAwaiter Sleep(uint64_t delayms);
+
+private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    struct Node
+    {
+        Callback callback;
+        uint64_t expire = 0;   // 到期的tick
+        uint64_t interval = 0; // 以tick计，0表示单次
+        uint32_t prev = NIL;
+        uint32_t next = NIL;
+        uint32_t slot = NIL; // 所在槽位，NIL表示空闲或正在执行
+        uint32_t generation = 0;
+    };
+
+    uint64_t ToTicks(uint64_t ms) const;
+    uint32_t Find(TimerId id);
+    uint32_t Allocate();
+    void Free(uint32_t index);
+    void Link(uint32_t index); // 按到期tick挂入对应层的槽位
+    void Unlink(uint32_t index);
+    void Cascade(uint32_t slot); // 把高层槽位的节点重新分配到低层
+    void Tick(std::vector<Callback> &expired);
+    void Run();
+
+private:
+    std::vector<Node> _nodes;
+    std::vector<uint32_t> _freelist;
+    std::vector<uint32_t> _slots; // 各槽位链表头，依次为第0层与第1~3层
+    uint64_t _current;            // 下一个要处理的tick
+    size_t _count;
+    uint64_t _tickms;
+    CriticalSectionLock _lock;
+
+    int _fd;
+    std::thread _thread;
+    std::atomic<bool> _running;
+};
+
+#define TIMINGWHEEL TimingWheel::Instance()
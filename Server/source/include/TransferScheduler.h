@@ -0,0 +1,107 @@
+#pragma once
+
+#include "stdafx.h"
+#include "CriticalSectionLock.h"
+#include "TimingWheel.h"
+
+enum class TransferDirection
+{
+    OUTBOUND = 0, // 服务器发送文件，按分片发送前申请预算
+    INBOUND = 1   // 服务器接收文件，按分片确认前申请预算，预算不足时推迟确认
+};
+
+// 单个任务的调度状态
+struct TransferFlow
+{
+    std::string taskid;
+    std::string token;
+    TransferDirection direction;
+    uint32_t weight;
+
+    double vtime = 0;          // 加权公平队列的虚拟完成时间
+    uint64_t credit = 0;       // 已调度但尚未被任务取走的字节数
+    bool waiting = false;      // 是否在等待预算
+    uint64_t pendingbytes = 0; // 等待中的字节数
+
+    uint64_t grantedbytes = 0; // 当前统计周期内分配的字节数
+    double rate = 0;           // 最近分配速率(字节/秒)，用于监控
+
+    std::function<void()> resume; // 预算到位后回调，由任务重新申请并继续传输
+};
+
+struct TransferFlowStats
+{
+    std::string taskid;
+    std::string token;
+    TransferDirection direction;
+    uint32_t weight;
+    double rate;
+};
+
+// 跨任务的带宽调度器：全局与单用户两级令牌桶限速，预算不足时按加权公平队列顺序分配，
+// 小文件与图片获得更高的权重。未设置限速时所有申请立即通过
+class TransferScheduler
+{
+public:
+    static TransferScheduler *Instance();
+
+private:
+    TransferScheduler();
+
+public:
+    ~TransferScheduler();
+
+    TransferScheduler(const TransferScheduler &) = delete;
+    TransferScheduler &operator=(const TransferScheduler &) = delete;
+
+    // 单位字节/秒，0表示不限速
+    void SetRateLimit(TransferDirection direction, uint64_t globalrate, uint64_t userrate);
+
+    void AddFlow(const std::string &taskid, const std::string &token, TransferDirection direction,
+                 uint64_t filesize, const std::string &filepath, std::function<void()> resume);
+    void RemoveFlow(const std::string &taskid);
+
+    // 申请传输bytes字节，返回false时任务应暂停，预算到位后通过resume回调通知
+    bool Acquire(const std::string &taskid, uint64_t bytes);
+
+    bool GetFlowStats(const std::string &taskid, TransferFlowStats &stats);
+    std::vector<TransferFlowStats> GetAllFlowStats();
+
+private:
+    struct TokenBucket
+    {
+        uint64_t rate = 0; // 0表示不限速
+        double tokens = 0;
+
+        void Refill(double seconds);
+        bool Available() const;
+        void Consume(uint64_t bytes);
+    };
+
+    struct DirectionLimit
+    {
+        TokenBucket global;
+        uint64_t userrate = 0;
+        std::map<std::string, TokenBucket> users; // token->bucket
+        double vclock = 0;                        // 已服务流的最大虚拟时间，新流从这里开始计时
+    };
+
+    static uint32_t FlowWeight(uint64_t filesize, const std::string &filepath);
+
+    DirectionLimit &Limit(TransferDirection direction);
+    TokenBucket &UserBucket(DirectionLimit &limit, const std::string &token);
+    bool HasBudget(DirectionLimit &limit, const std::string &token);
+    void Charge(TransferFlow &flow, uint64_t bytes);
+    void Refill();
+    void Dispatch();
+
+private:
+    std::map<std::string, TransferFlow> _flows; // taskid->flow
+    DirectionLimit _limits[2];
+    int64_t _lastrefill;
+    int64_t _laststats;
+    CriticalSectionLock _lock;
+    TimingWheel::TimerId DispatchTimer = 0;
+};
+
+#define TRANSFERSCHEDULER TransferScheduler::Instance()
@@ -1,6 +1,7 @@
 #include "AsyncMD5.h"
 #include "MD5Helper.h"
-#include "FlexThreadPool.h"
+#include "MD5MultiBuffer.h"
+#include "SafeStl.h"
 
 class AsyncMD5Handle : public std::enable_shared_from_this<AsyncMD5Handle>
 {
@@ -25,12 +26,6 @@ public:
     void ProcessData();
     void StopCalculate();
 
-private:
-    static CriticalSectionLock _execpoolmutex;
-    static FlexThreadPool _execpool;
-
-    void Need();
-
 private:
     uint64_t _datacount;
     SafeQueue<std::shared_ptr<Buffer>> _pushqueue;
@@ -46,9 +41,6 @@ private:
     bool _stop;
 };
 
-CriticalSectionLock AsyncMD5Handle::_execpoolmutex = CriticalSectionLock();
-FlexThreadPool AsyncMD5Handle::_execpool = FlexThreadPool(8);
-
 MD5SnapShot::MD5SnapShot()
 {
     status[0] = 0x67452301;
@@ -103,7 +95,6 @@ AsyncMD5Handle::AsyncMD5Handle()
     _status = execstatus::idle;
     _datacount = 0;
     _ctx = MD5Helper::MD5Ctx_Init();
-    Need();
 }
 
 AsyncMD5Handle::~AsyncMD5Handle()
@@ -205,13 +196,6 @@ void AsyncMD5Handle::StopCalculate()
     _stop = true;
 }
 
-void AsyncMD5Handle::Need()
-{
-    LockGuard guard(_execpoolmutex);
-    if (!_execpool.running())
-        _execpool.start();
-}
-
 void AsyncMD5Handle::ProcessData()
 {
     if (_stop)
@@ -231,27 +215,19 @@ void AsyncMD5Handle::ProcessData()
         }
         else
         {
-            // 有待处理的buf，异步处理
+            // 有待处理的buf，交给多缓冲引擎与其他任务的数据一起计算
             std::shared_ptr<Buffer> buf;
             if (_pushqueue.dequeue(buf) && buf)
             {
-                auto donecallback = [this]() -> void
+                auto donecallback = [handle = shared_from_this()]() -> void
                 {
                     // 任务完成，设置空闲
-                    _status = execstatus::idle;
-                    ProcessData();
-                };
-                auto task = [&updatemutex = _updateCtxlock, md5ctx = _ctx, handle = shared_from_this(), block = buf, callback = donecallback]() -> void
-                {
-                    {
-                        LockGuard guard(updatemutex);
-                        MD5Helper::MD5Ctx_Update(md5ctx, reinterpret_cast<const unsigned char *>(block->Byte()), block->Length());
-                    }
-                    callback();
+                    handle->_status = execstatus::idle;
+                    handle->ProcessData();
                 };
                 can_final.store(false, std::memory_order_release);
                 _status = execstatus::running;
-                _execpool.submit(task);
+                MD5MULTIBUFFER->Submit(_ctx, buf, &_updateCtxlock, donecallback);
             }
         }
     }
@@ -1,10 +1,12 @@
 #include "ConnectManager.h"
 #include "FileTransManager.h"
+#include "OutboundLimiter.h"
 
 ConnectManager::ConnectManager()
 {
     listener = std::make_unique<NetWorkSessionListener>(SessionType::CustomTCPSession);
     listener->BindSessionEstablishCallBack(std::bind(&ConnectManager::callBackSessionEstablish, this, std::placeholders::_1));
+    FILETRANSMANAGER->SetSessionLoopGroup(&loops);
 }
 
 bool ConnectManager::Start(const std::string &IP, int Port)
@@ -24,6 +26,7 @@ void ConnectManager::callBackSessionEstablish(BaseNetWorkSession *session)
     session->BindRecvDataCallBack(std::bind(&ConnectManager::callBackRecvMessage, this, std::placeholders::_1, std::placeholders::_2));
     session->BindSessionCloseCallBack(std::bind(&ConnectManager::callBackCloseConnect, this, std::placeholders::_1));
     sessions.emplace(session);
+    idlemonitor.AddSession(session);
 
     std::cout << fmt::format("User Login :RemoteAddr={}:{} \n",
                              session->GetIPAddr(), session->GetPort());
@@ -40,6 +43,11 @@ void ConnectManager::callBackRecvMessage(BaseNetWorkSession *basesession, Buffer
 {
     CustomTcpSession *session = (CustomTcpSession *)basesession;
 
+    // 任何数据都说明对端存活，心跳回应到此为止
+    idlemonitor.Touch(basesession);
+    if (recv && SessionIdleMonitor::IsHeartBeat(*recv))
+        return;
+
     // std::cout << fmt::format("Server recvData:RemoteAddr={}:{} \n",
     //                          session->GetIPAddr(), session->GetPort());
 
@@ -60,7 +68,12 @@ void ConnectManager::callBackCloseConnect(BaseNetWorkSession *session)
     if (HandleLoginUser)
         HandleLoginUser->Logout(session, session->GetIPAddr(), session->GetPort());
 
+    // 先等处理线程上该会话的消息处理完，之后才能结束任务并释放会话
+    loops.Release(session);
+    idlemonitor.RemoveSession(session);
+    // 结束任务时等待在途的文件读取完成，其回调仍会经OutboundLimiter向该会话发送，须在移除限流状态之前
     FILETRANSMANAGER->SessionClose(session);
+    OUTBOUNDLIMITER->RemoveSession(session);
 
     sessions.EnsureCall(
         [&](std::vector<BaseNetWorkSession *> &array) -> void
@@ -88,4 +101,21 @@ void ConnectManager::SetLoginUserManager(LoginUserManager *m)
 void ConnectManager::SetMsgManager(MsgManager *m)
 {
     HandleMsg = m;
+    if (HandleMsg)
+        HandleMsg->SetSessionLoopGroup(&loops);
+}
+
+void ConnectManager::SetSessionLoops(unsigned count)
+{
+    loops.Start(count);
+}
+
+void ConnectManager::SetIdlePolicy(const IdlePolicy &policy)
+{
+    idlemonitor.SetPolicy(policy);
+}
+
+IdleStats ConnectManager::GetIdleStats()
+{
+    return idlemonitor.GetStats();
 }
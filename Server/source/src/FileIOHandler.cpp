@@ -1,5 +1,6 @@
 
 #include "FileIOHandler.h"
+#include "FileIOUring.h"
 #include <system_error>
 #include <cstring>
 #include <fcntl.h>
@@ -12,6 +13,7 @@ FileIOHandler::FileIOHandler()
     _fd = -1;
     _offset = 0;
     _filemode = 0644;
+    _asyncstate = std::make_shared<AsyncState>();
 }
 
 FileIOHandler::FileIOHandler(const std::string &filepath, OpenMode mode)
@@ -55,7 +57,16 @@ void FileIOHandler::Close()
     {
         if (_fd != -1)
         {
-            ::close(_fd);
+            // 在途的异步请求仍引用fd和调用方的缓冲区，须等其完成后再关闭
+            // 在完成回调中关闭时不能等待回调所属的请求，fd交给最后一个完成的请求关闭
+            CancelQueuedAsync();
+            if (!FILEIOURING->InCompletionCallback())
+            {
+                WaitAsync();
+                ::close(_fd);
+            }
+            else
+                _asyncstate->CloseWhenIdle(_fd);
             _fd = -1;
         }
         _filepath.clear();
@@ -178,6 +189,60 @@ long FileIOHandler::Seek(SeekOrigin origin, long offset)
     return result;
 }
 
+long FileIOHandler::ReadAt(char *buf, size_t bytesToRead, uint64_t offset) const
+{
+    if (!CheckOpen())
+        return -1;
+
+    size_t total = 0;
+    while (total < bytesToRead)
+    {
+        ssize_t result = ::pread(_fd, buf + total, bytesToRead - total, offset + total);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            std::cerr << fmt::format("ReadAt failed, error: {}\n", strerror(errno));
+            return -1;
+        }
+        if (result == 0) // 文件末尾
+            break;
+        total += result;
+    }
+    return total;
+}
+
+long FileIOHandler::ReadAt(Buffer &buffer, size_t bytesToRead, uint64_t offset) const
+{
+    // 确保Buffer有足够空间
+    if (buffer.Remain() < bytesToRead)
+    {
+        buffer.ReSize(buffer.Position() + bytesToRead);
+    }
+    return ReadAt(buffer.Byte() + buffer.Position(), bytesToRead, offset);
+}
+
+long FileIOHandler::WriteAt(const char *buf, size_t bytesToWrite, uint64_t offset)
+{
+    if (!CheckOpen())
+        return -1;
+
+    size_t total = 0;
+    while (total < bytesToWrite)
+    {
+        ssize_t result = ::pwrite(_fd, buf + total, bytesToWrite - total, offset + total);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            std::cerr << fmt::format("WriteAt failed, error: {}\n", strerror(errno));
+            return -1;
+        }
+        total += result;
+    }
+    return total;
+}
+
 bool FileIOHandler::Flush()
 {
     LockGuard guard(_mutex);
@@ -218,6 +283,15 @@ long FileIOHandler::GetSize() const
     return result;
 }
 
+int64_t FileIOHandler::GetModifyTime() const
+{
+    LockGuard guard(_mutex);
+    struct stat64 st;
+    if (!CheckOpen() || ::fstat64(_fd, &st) == -1)
+        return 0;
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
 bool FileIOHandler::Truncate(off_t size)
 {
     LockGuard guard(_mutex);
@@ -236,6 +310,145 @@ bool FileIOHandler::Truncate(off_t size)
     return result;
 }
 
+// 文件系统不支持fallocate时返回false，调用方照常写入即可
+bool FileIOHandler::Allocate(uint64_t size)
+{
+    LockGuard guard(_mutex);
+    bool result = false;
+    try
+    {
+        if (!CheckOpen() || size == 0)
+            return result;
+
+        result = ::fallocate(_fd, 0, 0, size) == 0;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+    }
+    return result;
+}
+
+void FileIOHandler::AsyncState::Done()
+{
+    LockGuard guard(lock);
+    if (--pending == 0)
+    {
+        for (int fd : closefds)
+            ::close(fd);
+        closefds.clear();
+        cv.NotifyAll();
+    }
+}
+
+void FileIOHandler::AsyncState::CloseWhenIdle(int fd)
+{
+    LockGuard guard(lock);
+    if (pending == 0)
+        ::close(fd);
+    else
+        closefds.emplace_back(fd);
+}
+
+bool FileIOHandler::QueueAsync(int op, char *buf, size_t length, uint64_t offset, AsyncCallBack callback)
+{
+    LockGuard guard(_mutex);
+    if (!CheckOpen())
+        return false;
+
+    std::shared_ptr<AsyncState> state = _asyncstate;
+    state->pending++;
+    auto done = [state, callback](long result)
+    {
+        if (callback)
+            callback(result);
+        state->Done();
+    };
+    _asyncqueue.emplace_back(new FileIOUringRequest((FileIOUringRequest::OpType)op, _fd, offset, buf, length, done));
+    return true;
+}
+
+bool FileIOHandler::ReadAsync(char *buf, size_t bytesToRead, uint64_t offset, AsyncCallBack callback)
+{
+    return QueueAsync(FileIOUringRequest::READ, buf, bytesToRead, offset, callback);
+}
+
+bool FileIOHandler::WriteAsync(const char *buf, size_t bytesToWrite, uint64_t offset, AsyncCallBack callback)
+{
+    return QueueAsync(FileIOUringRequest::WRITE, const_cast<char *>(buf), bytesToWrite, offset, callback);
+}
+
+void FileIOHandler::SubmitAsync()
+{
+    std::vector<FileIOUringRequest *> requests;
+    {
+        LockGuard guard(_mutex);
+        requests.swap(_asyncqueue);
+    }
+    if (!requests.empty())
+        FILEIOURING->Submit(requests);
+}
+
+void FileIOHandler::WaitAsync()
+{
+    LockGuard guard(_asyncstate->lock);
+    while (_asyncstate->pending > 0)
+        _asyncstate->cv.Wait(guard);
+}
+
+void FileIOHandler::CancelQueuedAsync()
+{
+    std::vector<FileIOUringRequest *> requests;
+    {
+        LockGuard guard(_mutex);
+        requests.swap(_asyncqueue);
+    }
+    for (auto request : requests)
+    {
+        if (request->callback)
+            request->callback(-ECANCELED);
+        delete request;
+    }
+}
+
+bool FileIOHandler::AsyncAwaiter::await_ready() const noexcept
+{
+    return false;
+}
+
+bool FileIOHandler::AsyncAwaiter::await_suspend(std::coroutine_handle<> coro)
+{
+    auto resume = [this, coro](long res)
+    {
+        result = res;
+        coro.resume();
+    };
+    bool queued = isread ? handler->ReadAsync(buf, length, offset, resume)
+                         : handler->WriteAsync(buf, length, offset, resume);
+    if (!queued)
+    {
+        result = -EBADF;
+        return false;
+    }
+    handler->SubmitAsync();
+    return true;
+}
+
+long FileIOHandler::AsyncAwaiter::await_resume() noexcept
+{
+    return result;
+}
+
+FileIOHandler::AsyncAwaiter FileIOHandler::ReadAwait(char *buf, size_t bytesToRead, uint64_t offset)
+{
+    return AsyncAwaiter{this, true, buf, bytesToRead, offset, 0};
+}
+
+FileIOHandler::AsyncAwaiter FileIOHandler::WriteAwait(const char *buf, size_t bytesToWrite, uint64_t offset)
+{
+    return AsyncAwaiter{this, false, const_cast<char *>(buf), bytesToWrite, offset, 0};
+}
+
 bool FileIOHandler::Exists(const std::string &path)
 {
     return ::access(path.c_str(), F_OK) == 0;
@@ -0,0 +1,220 @@
+#include "FileIOUring.h"
+#include <unistd.h>
+
+constexpr int maxsubmitretries = 100;
+constexpr int submitretryus = 100;
+
+static thread_local int completiondepth = 0; // 正在执行的完成回调层数，同步完成时回调可能嵌套
+
+// 完成线程与同步回退都经此调用回调并释放请求
+static void CompleteRequest(FileIOUringRequest *request, long result)
+{
+    completiondepth++;
+    try
+    {
+        if (request->callback)
+            request->callback(result);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+    }
+    completiondepth--;
+    delete request;
+}
+
+FileIOUringRequest::FileIOUringRequest(OpType t, int f, uint64_t off, char *buf, size_t len, std::function<void(long)> cb)
+    : op(t), fd(f), offset(off), data(buf), length(len), callback(std::move(cb))
+{
+}
+
+long FileIOUringRequest::ExecuteSync()
+{
+    long result = op == READ ? ::pread(fd, data, length, offset) : ::pwrite(fd, data, length, offset);
+    return result < 0 ? -errno : result;
+}
+
+FileIOUring *FileIOUring::Instance()
+{
+    static FileIOUring *instance = new FileIOUring();
+    return instance;
+}
+
+FileIOUring::FileIOUring()
+    : _running(false)
+{
+    memset(&_ring, 0, sizeof(_ring));
+}
+
+FileIOUring::~FileIOUring()
+{
+    Stop();
+}
+
+bool FileIOUring::Init(unsigned entries)
+{
+    LockGuard guard(_submitlock);
+    if (_running)
+        return true;
+
+    int ret = io_uring_queue_init(entries, &_ring, 0);
+    if (ret < 0)
+    {
+        std::cerr << fmt::format("FileIOUring init failed, error: {}\n", strerror(-ret));
+        return false;
+    }
+
+    _running = true;
+    _completionthread = std::thread(&FileIOUring::CompletionLoop, this);
+    return true;
+}
+
+void FileIOUring::Stop()
+{
+    {
+        LockGuard guard(_submitlock);
+        if (!_running)
+            return;
+        _running = false;
+
+        // 提交一个空请求唤醒完成线程，提交队列已满时先提交其中的请求腾出位置
+        std::vector<PreparedRequest> wakeup;
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&_ring);
+        if (!sqe && SubmitPrepared(wakeup))
+            sqe = io_uring_get_sqe(&_ring);
+        if (sqe)
+        {
+            io_uring_prep_nop(sqe);
+            io_uring_sqe_set_data(sqe, nullptr);
+            wakeup.emplace_back(PreparedRequest{sqe, nullptr});
+        }
+        if (!sqe || !SubmitPrepared(wakeup))
+        {
+            // 无法唤醒时不能等待完成线程，它仍在使用队列，也不能释放
+            std::cerr << "FileIOUring stop failed to wake the completion thread\n";
+            _completionthread.detach();
+            return;
+        }
+    }
+
+    if (_completionthread.joinable())
+        _completionthread.join();
+    io_uring_queue_exit(&_ring);
+}
+
+bool FileIOUring::Running() const
+{
+    return _running;
+}
+
+bool FileIOUring::InCompletionCallback() const
+{
+    return completiondepth > 0;
+}
+
+void FileIOUring::Submit(std::vector<FileIOUringRequest *> &requests)
+{
+    std::vector<FileIOUringRequest *> syncrequests;
+    {
+        LockGuard guard(_submitlock);
+        std::vector<PreparedRequest> prepared;
+        bool submitok = _running;
+        for (auto request : requests)
+        {
+            struct io_uring_sqe *sqe = submitok ? io_uring_get_sqe(&_ring) : nullptr;
+            if (!sqe && submitok)
+            {
+                submitok = SubmitPrepared(prepared);
+                sqe = submitok ? io_uring_get_sqe(&_ring) : nullptr;
+            }
+            if (!sqe)
+            {
+                syncrequests.emplace_back(request);
+                continue;
+            }
+
+            if (request->op == FileIOUringRequest::READ)
+                io_uring_prep_read(sqe, request->fd, request->data, request->length, request->offset);
+            else
+                io_uring_prep_write(sqe, request->fd, request->data, request->length, request->offset);
+            io_uring_sqe_set_data(sqe, request);
+            prepared.emplace_back(PreparedRequest{sqe, request});
+        }
+        if (submitok)
+            SubmitPrepared(prepared);
+
+        // 提交失败的请求仍留在提交队列中，改为空请求，之后随其他请求提交时被完成线程忽略
+        for (auto &pending : prepared)
+        {
+            io_uring_prep_nop(pending.sqe);
+            io_uring_sqe_set_data(pending.sqe, nullptr);
+            syncrequests.emplace_back(pending.request);
+        }
+        _unsubmittednops += prepared.size();
+    }
+    requests.clear();
+
+    // 未能进入提交队列的请求在当前线程同步完成
+    for (auto request : syncrequests)
+        CompleteRequest(request, request->ExecuteSync());
+}
+
+// 被信号中断时直接重试；完成队列已满时内核返回EBUSY，让出时间由完成线程收割后重试
+// 提交成功的请求从prepared中移除，返回false时剩余的请求未被提交
+bool FileIOUring::SubmitPrepared(std::vector<PreparedRequest> &prepared)
+{
+    int retries = 0;
+    while (!prepared.empty() || _unsubmittednops > 0)
+    {
+        int ret = io_uring_submit(&_ring);
+        if (ret > 0)
+        {
+            // 队列头部是之前提交失败留下的空请求，先于本批请求被提交
+            size_t nops = std::min((size_t)ret, (size_t)_unsubmittednops);
+            _unsubmittednops -= nops;
+            prepared.erase(prepared.begin(), prepared.begin() + std::min(ret - nops, prepared.size()));
+            retries = 0;
+            continue;
+        }
+        if (ret == -EINTR)
+            continue;
+        if ((ret == 0 || ret == -EBUSY || ret == -EAGAIN) && retries++ < maxsubmitretries)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(submitretryus));
+            continue;
+        }
+
+        std::cerr << fmt::format("FileIOUring submit failed, error: {}\n", strerror(ret < 0 ? -ret : EAGAIN));
+        return false;
+    }
+    return true;
+}
+
+void FileIOUring::CompletionLoop()
+{
+    while (true)
+    {
+        struct io_uring_cqe *cqe = nullptr;
+        int ret = io_uring_wait_cqe(&_ring, &cqe);
+        if (ret < 0)
+        {
+            if (ret == -EINTR)
+                continue;
+            std::cerr << fmt::format("FileIOUring wait cqe failed, error: {}\n", strerror(-ret));
+            break;
+        }
+
+        FileIOUringRequest *request = (FileIOUringRequest *)io_uring_cqe_get_data(cqe);
+        long result = cqe->res;
+        io_uring_cqe_seen(&_ring, cqe);
+
+        if (!request) // Stop提交的唤醒请求，或提交失败后改为空的请求
+        {
+            if (!_running)
+                break;
+            continue;
+        }
+
+        CompleteRequest(request, result);
+    }
+}
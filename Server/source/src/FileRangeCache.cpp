@@ -0,0 +1,125 @@
+#include "FileRangeCache.h"
+#include <sys/stat.h>
+
+constexpr uint64_t rangecacheblocksize = 256 * 1024;
+constexpr size_t maxcacheblocksperfile = 32; // 每个文件最多缓存8MB
+constexpr size_t maxcachedfiles = 16;
+
+// 与GetFileMerkleRoot相同，以大小与修改时间判断文件是否改变
+static bool StatFile(const std::string &filepath, uint64_t &filesize, int64_t &mtime)
+{
+    struct stat64 st;
+    if (::stat64(filepath.c_str(), &st) == -1)
+        return false;
+    filesize = st.st_size;
+    mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+FileRangeCache *FileRangeCache::Instance()
+{
+    static FileRangeCache *instance = new FileRangeCache();
+    return instance;
+}
+
+FileRangeCache::FileRangeCache()
+{
+}
+
+bool FileRangeCache::Read(const std::string &filepath, uint64_t offset, uint64_t length, char *dst)
+{
+    if (length == 0)
+        return true;
+
+    std::shared_ptr<CacheFile> cachefile = AcquireFile(filepath);
+    if (!cachefile || offset + length > cachefile->filesize || offset + length < offset)
+        return false;
+
+    LockGuard guard(cachefile->lock);
+    uint64_t first = offset / rangecacheblocksize;
+    uint64_t last = (offset + length - 1) / rangecacheblocksize;
+    for (uint64_t index = first; index <= last; index++)
+    {
+        const CacheBlock *block = LoadBlock(*cachefile, index);
+        if (!block)
+            return false;
+
+        uint64_t blockleft = index * rangecacheblocksize;
+        uint64_t left = std::max(offset, blockleft);
+        uint64_t right = std::min(offset + length, blockleft + block->data.size());
+        memcpy(dst + (left - offset), block->data.data() + (left - blockleft), right - left);
+    }
+    return true;
+}
+
+void FileRangeCache::Remove(const std::string &filepath)
+{
+    LockGuard guard(_lock);
+    _files.erase(filepath);
+}
+
+// 超出文件数上限时淘汰最久未使用的文件，正在读取的文件由shared_ptr保持有效
+std::shared_ptr<FileRangeCache::CacheFile> FileRangeCache::AcquireFile(const std::string &filepath)
+{
+    LockGuard guard(_lock);
+    uint64_t filesize = 0;
+    int64_t mtime = 0;
+    if (!StatFile(filepath, filesize, mtime))
+    {
+        _files.erase(filepath);
+        return nullptr;
+    }
+
+    auto it = _files.find(filepath);
+    if (it != _files.end())
+    {
+        if (it->second->filesize == filesize && it->second->mtime == mtime)
+        {
+            it->second->lastused = ++_clock;
+            return it->second;
+        }
+        _files.erase(it); // 文件已被替换，旧缓存作废
+    }
+
+    std::shared_ptr<CacheFile> cachefile = std::make_shared<CacheFile>();
+    if (!cachefile->file.Open(filepath, FileIOHandler::OpenMode::READ_ONLY))
+        return nullptr;
+    long size = cachefile->file.GetSize();
+    if (size < 0)
+        return nullptr;
+    cachefile->filesize = size;
+    cachefile->mtime = cachefile->file.GetModifyTime();
+    cachefile->lastused = ++_clock;
+
+    if (_files.size() >= maxcachedfiles)
+    {
+        auto oldest = std::min_element(_files.begin(), _files.end(),
+                                       [](const auto &a, const auto &b)
+                                       { return a.second->lastused < b.second->lastused; });
+        _files.erase(oldest);
+    }
+    _files[filepath] = cachefile;
+    return cachefile;
+}
+
+const FileRangeCache::CacheBlock *FileRangeCache::LoadBlock(CacheFile &cachefile, uint64_t index)
+{
+    for (auto it = cachefile.blocks.begin(); it != cachefile.blocks.end(); ++it)
+    {
+        if (it->index != index)
+            continue;
+        cachefile.blocks.splice(cachefile.blocks.begin(), cachefile.blocks, it);
+        return &cachefile.blocks.front();
+    }
+
+    uint64_t blockleft = index * rangecacheblocksize;
+    uint64_t blocksize = std::min(rangecacheblocksize, cachefile.filesize - blockleft);
+    CacheBlock block{index, std::vector<char>(blocksize)};
+    if (cachefile.file.ReadAt(block.data.data(), blocksize, blockleft) != (long)blocksize)
+        return nullptr;
+
+    if (cachefile.blocks.size() >= maxcacheblocksperfile)
+        cachefile.blocks.pop_back();
+    cachefile.blocks.emplace_front(std::move(block));
+    return &cachefile.blocks.front();
+}
@@ -2,6 +2,7 @@
 #include <iostream>
 #include <fstream>
 #include "FileIOHandler.h"
+#include "FileRangeCache.h"
 #include "Timer.h"
 
 using namespace std;
@@ -273,6 +274,7 @@ void FileRecordStore::CleanExpiredFileStore()
                     std::string chunks_path = record->path + "__chunks";
                     if(FileIOHandler::Exists(path))
                         FileIOHandler::Remove(path);
+                    FILERANGECACHE->Remove(path);
                     if(FileIOHandler::Exists(chunks_path))
                         FileIOHandler::Remove(chunks_path);
                 }
@@ -2,9 +2,14 @@
 #include "FileRecordStore.h"
 #include "LoginUserManager.h"
 #include "NetWorkHelper.h"
+#include "TransferScheduler.h"
+#include "OutboundLimiter.h"
+#include "FileRangeCache.h"
 #include "Timer.h"
 
 constexpr int64_t taskexpiredseconds = 1800;
+constexpr size_t maxstripesessions = 7; // 每个任务除发起会话外最多加入的会话数
+constexpr uint64_t maxrangefetchlength = 4 * 1024 * 1024; // 单次区间读取返回的最大字节数
 
 int64_t GetTimestampSeconds()
 {
@@ -13,20 +18,26 @@ int64_t GetTimestampSeconds()
     return std::chrono::duration_cast<std::chrono::seconds>(duration).count();
 }
 
-FileTransTaskContent::FileTransTaskContent(const string &id, FileTransferTask *t, BaseNetWorkSession *s)
+FileTransTaskContent::FileTransTaskContent(const string &id, std::shared_ptr<FileTransferTask> t, BaseNetWorkSession *s, const string &tk)
 {
     fileid = id;
     task = t;
     session = s;
+    token = tk;
     timestamp = GetTimestampSeconds();
 }
 
 FileTransTaskContent::~FileTransTaskContent()
 {
-    SAFE_DELETE(task);
+    task = nullptr;
     session = nullptr;
 }
 
+bool FileTransTaskContent::HasSession(BaseNetWorkSession *s)
+{
+    return session == s || std::find(stripes.begin(), stripes.end(), s) != stripes.end();
+}
+
 FileTransManager::FileTransManager()
     : HandleLoginUser(nullptr)
 {
@@ -61,6 +72,14 @@ bool FileTransManager::ProcessMsg(BaseNetWorkSession *session, const json &js, B
         AckTaskReq(session, js);
         return true;
         break;
+    case 4002:
+        JoinTaskStripe(session, js);
+        return true;
+        break;
+    case 4003:
+        FetchFileRange(session, js);
+        return true;
+        break;
     default:
         return DistributeMsg(session, js, buf);
         break;
@@ -76,11 +95,19 @@ bool FileTransManager::DistributeMsg(BaseNetWorkSession *session, const json &js
     string taskid = js["taskid"];
     UpdateTimeStamp(taskid);
 
-    FileTransTaskContent *content = nullptr;
-    if (!m_tasks.Find(taskid, content))
-        return false;
+    std::shared_ptr<FileTransferTask> task;
+    {
+        // stripes由JoinTaskStripe与SessionClose持锁修改，检查会话时同样持锁，处理消息时不持锁
+        auto guard = m_tasks.MakeLockGuard();
+        FileTransTaskContent *content = nullptr;
+        if (!m_tasks.Find(taskid, content))
+            return false;
+        if (!content->HasSession(session)) // 只处理发起会话和已加入会话的消息
+            return false;
+        task = content->task;
+    }
 
-    content->task->ProcessMsg(session, js, buf);
+    task->ProcessMsg(session, js, buf);
 
     return true;
 }
@@ -111,18 +138,24 @@ void FileTransManager::AckTaskReq(BaseNetWorkSession *session, const json &js)
     js_reply["command"] = 5001;
     js_reply["fileid"] = fileid;
     js_reply["type"] = type;
+    std::shared_ptr<FileRelaySource> relaysource;
     if (FILERECORDSTORE->getRecord(fileid, record))
     {
-        js_reply["result"] = record.status == FileStoreStatus::COMPLETED ? 1 : 0;
+        // 文件仍在上传中时，下载请求以转发方式进行，只发送服务器已收到的部分
+        if (type == 2 && record.status == FileStoreStatus::UPLOADING && !record.md5.empty())
+            relaysource = FindRelaySource(fileid);
+
+        js_reply["result"] = record.status == FileStoreStatus::COMPLETED || relaysource ? 1 : 0;
         js_reply["filesize"] = record.filesize;
-        js_reply["suggest_chunksize"] = std::max((uint64_t)1, record.filesize / (uint64_t)10);
+        js_reply["suggest_chunksize"] = GetSuggestChunsize(record.filesize);
         js_reply["taskid"] = taskid;
         if (type == 1)
         {
             if (record.status != FileStoreStatus::COMPLETED)
             {
                 FILERECORDSTORE->updateFileRecordStatus(fileid, FileStoreStatus::UPLOADING);
-                AddDownloadTask(fileid, taskid, record.path, record.md5, record.filesize, session);
+                if (AddDownloadTask(fileid, taskid, record.path, record.md5, record.filesize, session, token))
+                    m_relaysources.Insert(fileid, std::make_shared<FileRelaySource>()); // 续传时沿用已有的转发源
             }
         }
     }
@@ -141,63 +174,195 @@ void FileTransManager::AckTaskReq(BaseNetWorkSession *session, const json &js)
     {
         if (record.status == FileStoreStatus::COMPLETED)
         {
-            AddUploadTask(fileid, taskid, record.path, record.md5, session);
+            AddUploadTask(fileid, taskid, record.path, record.md5, record.filesize, session, token);
+        }
+        else if (relaysource)
+        {
+            relaysource->AddWaiter(taskid);
+            AddUploadTask(fileid, taskid, record.path, record.md5, record.filesize, session, token, relaysource);
         }
     }
 }
 
-bool FileTransManager::AddUploadTask(const string &fileid, const string &taskid, const string &filepath, const string &md5, BaseNetWorkSession *session)
+// 同一用户在另一条连接上请求加入已存在的任务，用于大文件的多连接并行传输
+void FileTransManager::JoinTaskStripe(BaseNetWorkSession *session, const json &js)
+{
+    if (!js.contains("taskid") || !js.at("taskid").is_string())
+        return;
+    if (!js.contains("jwt") || !js.at("jwt").is_string())
+        return;
+
+    string taskid = js["taskid"];
+    string jwtstr = js["jwt"];
+    string token;
+    int result = 0;
+
+    bool verified = false;
+    try
+    {
+        verified = LoginUserManager::VerfiyJwtToken(jwtstr, token);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+    }
+
+    if (verified)
+    {
+        FileTransTaskContent *content = nullptr;
+        auto guard = m_tasks.MakeLockGuard();
+        if (m_tasks.Find(taskid, content) && content && content->task && content->token == token)
+        {
+            if (content->HasSession(session))
+                result = 1;
+            else if (content->stripes.size() < maxstripesessions)
+            {
+                content->stripes.emplace_back(session);
+                content->task->AddStripeSession(session);
+                result = 1;
+            }
+        }
+    }
+
+    json js_reply;
+    js_reply["command"] = 5002;
+    js_reply["taskid"] = taskid;
+    js_reply["result"] = result;
+    NetWorkHelper::SendMessagePackage(session, &js_reply);
+}
+
+// 读取已上传完成文件的指定区间，不建立传输任务，也不产生任何附属文件
+// 用于预览窗口读取文件头或媒体跳转，数据随5003一并返回
+void FileTransManager::FetchFileRange(BaseNetWorkSession *session, const json &js)
+{
+    if (!js.contains("fileid") || !js.at("fileid").is_string())
+        return;
+    if (!js.contains("offset") || !js.at("offset").is_number_unsigned())
+        return;
+    if (!js.contains("length") || !js.at("length").is_number_unsigned())
+        return;
+    if (!js.contains("jwt") || !js.at("jwt").is_string())
+        return;
+
+    string jwtstr = js["jwt"];
+    string fileid = js["fileid"];
+    uint64_t offset = js["offset"];
+    uint64_t length = js["length"];
+    string token;
+    if (!HandleLoginUser->Verfiy(session, jwtstr, token))
+        return;
+
+    json js_reply;
+    js_reply["command"] = 5003;
+    js_reply["fileid"] = fileid;
+    js_reply["offset"] = offset;
+    if (js.contains("requestid"))
+        js_reply["requestid"] = js["requestid"];
+
+    FileRecord record;
+    int result = 1;
+    if (!FILERECORDSTORE->getRecord(fileid, record))
+        result = -1;
+    else if (record.status != FileStoreStatus::COMPLETED || offset > record.filesize)
+        result = 0;
+
+    // 区间超出文件末尾时截断，超出单次上限时由客户端继续请求剩余部分
+    if (result == 1)
+        length = std::min({length, record.filesize - offset, maxrangefetchlength});
+    else
+        length = 0;
+    js_reply["filesize"] = result == 1 ? record.filesize : 0;
+    js_reply["length"] = length;
+    js_reply["result"] = result;
+
+    std::shared_ptr<Buffer> buf = std::make_shared<Buffer>();
+    uint64_t bodypos = GenerateMessagePackageHeaderToBuffer(js_reply, length, buf.get());
+    if (length > 0 && !FILERANGECACHE->Read(record.path, offset, length, buf->Byte() + bodypos))
+    {
+        js_reply["result"] = 0;
+        js_reply["length"] = 0;
+        NetWorkHelper::SendMessagePackage(session, &js_reply);
+        return;
+    }
+    OUTBOUNDLIMITER->Send(session, *buf);
+}
+
+bool FileTransManager::AddUploadTask(const string &fileid, const string &taskid, const string &filepath, const string &md5, uint64_t filesize, BaseNetWorkSession *session, const string &token,
+                                     std::shared_ptr<FileRelaySource> relaysource)
 {
     FileTransTaskContent *content = nullptr;
     if (m_tasks.Find(taskid, content))
         return false;
 
-    FileTransferUploadTask *uploadtask = new FileTransferUploadTask(taskid, filepath, md5);
+    std::shared_ptr<FileTransferUploadTask> uploadtask = std::make_shared<FileTransferUploadTask>(taskid, filepath, md5);
+    if (relaysource)
+        uploadtask->SetRelaySource(relaysource, filesize);
     uploadtask->BindErrorCallBack(std::bind(&FileTransManager::OnUploadError, this, std::placeholders::_1));
     uploadtask->BindFinishedCallBack(std::bind(&FileTransManager::OnUploadFinish, this, std::placeholders::_1));
     uploadtask->BindInterruptedCallBack(std::bind(&FileTransManager::OnUploadInterrupt, this, std::placeholders::_1));
     uploadtask->BindProgressCallBack(std::bind(&FileTransManager::OnUploadProgress, this, std::placeholders::_1, std::placeholders::_2));
+    uploadtask->BindResumeCallBack(std::bind(&FileTransManager::ResumeTask, this, taskid));
+    uploadtask->BindRetransmitCallBack(std::bind(&FileTransManager::PostResumeTask, this, taskid));
 
-    content = new FileTransTaskContent(fileid, uploadtask, session);
+    content = new FileTransTaskContent(fileid, uploadtask, session, token);
     bool result = m_tasks.Insert(taskid, content);
     if (!result)
         SAFE_DELETE(content);
 
     if (result)
+    {
+        TRANSFERSCHEDULER->AddFlow(taskid, token, TransferDirection::OUTBOUND, filesize, filepath,
+                                   std::bind(&FileTransManager::ResumeTask, this, taskid));
         result = uploadtask->StartSendFile(session); // 如果返回false，task自动触发错误，无需额外处理
+    }
 
     return result;
 }
 
-bool FileTransManager::AddDownloadTask(const string &fileid, const string &taskid, const string &filepath, const string &md5, uint64_t filesize, BaseNetWorkSession *session)
+bool FileTransManager::AddDownloadTask(const string &fileid, const string &taskid, const string &filepath, const string &md5, uint64_t filesize, BaseNetWorkSession *session, const string &token)
 {
     FileTransTaskContent *content = nullptr;
     if (m_tasks.Find(taskid, content))
         return false;
 
-    FileTransferDownLoadTask *downloadtask = new FileTransferDownLoadTask(taskid);
+    std::shared_ptr<FileTransferDownLoadTask> downloadtask = std::make_shared<FileTransferDownLoadTask>(taskid);
     downloadtask->RegisterTransInfo(filepath, md5, filesize);
     downloadtask->BindErrorCallBack(std::bind(&FileTransManager::OnDownloadError, this, std::placeholders::_1));
     downloadtask->BindFinishedCallBack(std::bind(&FileTransManager::OnDownloadFinish, this, std::placeholders::_1));
     downloadtask->BindInterruptedCallBack(std::bind(&FileTransManager::OnDownloadInterrupt, this, std::placeholders::_1));
     downloadtask->BindProgressCallBack(std::bind(&FileTransManager::OnDownloadProgress, this, std::placeholders::_1, std::placeholders::_2));
+    downloadtask->BindWrittenCallBack(std::bind(&FileTransManager::OnDownloadWritten, this, fileid, std::placeholders::_1));
 
-    content = new FileTransTaskContent(fileid, downloadtask, session);
+    content = new FileTransTaskContent(fileid, downloadtask, session, token);
     bool result = m_tasks.Insert(taskid, content);
     if (!result)
         SAFE_DELETE(content);
+
+    if (result)
+        TRANSFERSCHEDULER->AddFlow(taskid, token, TransferDirection::INBOUND, filesize, filepath,
+                                   std::bind(&FileTransManager::ResumeTask, this, taskid));
     return result;
 }
 
 void FileTransManager::DeleteTask(const string &taskid)
 {
-    FileTransTaskContent *content = nullptr;
-    auto guard = m_tasks.MakeLockGuard();
-    if (!m_tasks.Find(taskid, content))
-        return;
+    std::shared_ptr<FileTransferTask> task;
+    {
+        FileTransTaskContent *content = nullptr;
+        auto guard = m_tasks.MakeLockGuard();
+        if (!m_tasks.Find(taskid, content))
+            return;
 
-    m_tasks.Erase(taskid);
-    SAFE_DELETE(content);
+        m_tasks.Erase(taskid);
+        TRANSFERSCHEDULER->RemoveFlow(taskid);
+        if (content)
+            task = content->task;
+        SAFE_DELETE(content);
+    }
+
+    // 其他线程可能正在处理该任务的消息或恢复传输，关闭后由最后一个持有引用的调用析构
+    if (task)
+        task->Close();
 }
 
 void FileTransManager::CleanExpireTask()
@@ -205,29 +370,18 @@ void FileTransManager::CleanExpireTask()
     int64_t currentTime = GetTimestampSeconds();
     int64_t expiredTime = currentTime - taskexpiredseconds;
 
-    {
-        auto guard = m_tasks.MakeLockGuard();
-        std::map<std::string, FileTransTaskContent *> interruptTasks;
-        m_tasks.EnsureCall([&](std::map<std::string, FileTransTaskContent *> &map) -> void
-                           {
+    std::vector<std::pair<std::shared_ptr<FileTransferTask>, BaseNetWorkSession *>> interruptTasks;
+    m_tasks.EnsureCall([&](std::map<std::string, FileTransTaskContent *> &map) -> void
+                       {
                         for(auto pair:map){
                             FileTransTaskContent * content = pair.second;
-                            if(!content||!content->task)
-                            {
-                                interruptTasks[pair.first]= pair.second;
-                                continue;
-                            }
-                            if(content->timestamp<expiredTime)
-                            {
-                                interruptTasks[pair.first]= pair.second;
-                            }
-                        } 
-                        for(auto &pair:interruptTasks)
-                        {
-                            FileTransTaskContent * content = pair.second;
-                            content->task->InterruptTrans(content->session);
+                            if(content && content->task && content->timestamp<expiredTime)
+                                interruptTasks.emplace_back(content->task, content->session);
                         } });
-    }
+
+    // 不持有m_tasks的锁调用任务，中断回调中会DeleteTask；会话关闭后任务已Close，中断直接返回
+    for (auto &pair : interruptTasks)
+        pair.first->InterruptTrans(pair.second);
 }
 
 void FileTransManager::UpdateTimeStamp(const string &taskid)
@@ -277,17 +431,44 @@ void FileTransManager::OnUploadProgress(FileTransferUploadTask *task, uint32_t p
 void FileTransManager::OnDownloadFinish(FileTransferDownLoadTask *task)
 {
     string taskid = task->TaskId();
-    FileTransTaskContent *content = nullptr;
-    if (!m_tasks.Find(taskid, content))
-        return;
-    FILERECORDSTORE->updateFileRecordStatus(content->fileid, FileStoreStatus::COMPLETED);
+    string fileid;
+    {
+        FileTransTaskContent *content = nullptr;
+        auto guard = m_tasks.MakeLockGuard();
+        if (!m_tasks.Find(taskid, content) || !content)
+            return;
+        fileid = content->fileid;
+    }
+    FILERECORDSTORE->updateFileRecordStatus(fileid, FileStoreStatus::COMPLETED);
     DeleteTask(taskid);
+
+    std::shared_ptr<FileRelaySource> source = TakeRelaySource(fileid);
+    if (source)
+    {
+        source->MarkCompleted();
+        NotifyRelayWaiters(source);
+    }
 }
 
+// 接收失败时文件已被删除，正在转发的下载任务随之失败
 void FileTransManager::OnDownloadError(FileTransferDownLoadTask *task)
 {
     string taskid = task->TaskId();
+    string fileid;
+    {
+        FileTransTaskContent *content = nullptr;
+        auto guard = m_tasks.MakeLockGuard();
+        if (m_tasks.Find(taskid, content) && content)
+            fileid = content->fileid;
+    }
     DeleteTask(taskid);
+
+    std::shared_ptr<FileRelaySource> source = TakeRelaySource(fileid);
+    if (source)
+    {
+        source->MarkFailed();
+        NotifyRelayWaiters(source);
+    }
 }
 
 void FileTransManager::OnDownloadInterrupt(FileTransferDownLoadTask *task)
@@ -296,35 +477,144 @@ void FileTransManager::OnDownloadInterrupt(FileTransferDownLoadTask *task)
     DeleteTask(taskid);
 }
 
+// 在接收任务的处理过程中回调，只转发写回已完成的区间
+// 中断的接收保留转发源，上传者续传后等待中的转发任务继续发送
 void FileTransManager::OnDownloadProgress(FileTransferDownLoadTask *task, uint32_t progress)
 {
 }
 
+// 在io_uring完成线程调用，只更新转发源，转发任务转到各自会话的处理线程继续发送
+void FileTransManager::OnDownloadWritten(const string &fileid, FileTransferDownLoadTask *task)
+{
+    std::shared_ptr<FileRelaySource> source = FindRelaySource(fileid);
+    if (!source)
+        return;
+    source->Update(task->WrittenChunkMap());
+    NotifyRelayWaiters(source);
+}
+
+std::shared_ptr<FileRelaySource> FileTransManager::FindRelaySource(const string &fileid)
+{
+    std::shared_ptr<FileRelaySource> source;
+    if (!m_relaysources.Find(fileid, source))
+        return nullptr;
+    return source;
+}
+
+std::shared_ptr<FileRelaySource> FileTransManager::TakeRelaySource(const string &fileid)
+{
+    auto guard = m_relaysources.MakeLockGuard();
+    std::shared_ptr<FileRelaySource> source;
+    if (!m_relaysources.Find(fileid, source))
+        return nullptr;
+    m_relaysources.Erase(fileid);
+    return source;
+}
+
+void FileTransManager::NotifyRelayWaiters(std::shared_ptr<FileRelaySource> source)
+{
+    for (auto &taskid : source->Waiters())
+    {
+        UpdateTimeStamp(taskid); // 等待数据的转发任务没有消息往来，不应被当作过期任务清理
+        PostResumeTask(taskid);
+    }
+}
+
 void FileTransManager::SetLoginUserManager(LoginUserManager *m)
 {
     HandleLoginUser = m;
 }
 
+void FileTransManager::SetSessionLoopGroup(SessionLoopGroup *g)
+{
+    HandleLoops = g;
+}
+
+// 与DistributeMsg一致，在锁内复制任务引用，不持有m_tasks的锁调用任务，避免与任务内回调DeleteTask的加锁顺序相反
+// 会话关闭时先Close任务再回收会话，ResumeTrans持任务锁检查关闭标记后才使用会话
+void FileTransManager::ResumeTask(const string &taskid)
+{
+    std::shared_ptr<FileTransferTask> task;
+    BaseNetWorkSession *session = nullptr;
+    {
+        FileTransTaskContent *content = nullptr;
+        auto guard = m_tasks.MakeLockGuard();
+        if (!m_tasks.Find(taskid, content) || !content || !content->task)
+            return;
+        task = content->task;
+        session = content->session;
+    }
+
+    task->ResumeTrans(session);
+}
+
+// 会话回收前调用：发起的任务被移除并关闭，加入的任务退出分条
+// 二者都持任务锁完成，返回后其余会话线程上仍在进行的处理与恢复不会再使用该会话
+// 时间轮回调须尽快返回，重传的读取与发送放到会话处理线程，与该会话的消息串行执行
+// 会话已关闭时投递失败，任务随之被关闭，无需再重传
+void FileTransManager::PostResumeTask(const string &taskid)
+{
+    std::shared_ptr<FileTransferTask> task;
+    BaseNetWorkSession *session = nullptr;
+    {
+        FileTransTaskContent *content = nullptr;
+        auto guard = m_tasks.MakeLockGuard();
+        if (!m_tasks.Find(taskid, content) || !content || !content->task)
+            return;
+        task = content->task;
+        session = content->session;
+    }
+
+    auto resume = [task, session]()
+    { task->ResumeTrans(session); };
+    if (HandleLoops)
+        HandleLoops->PostPinned(session, resume);
+    else
+        resume();
+}
+
 void FileTransManager::SessionClose(BaseNetWorkSession *session)
 {
-    auto guard = m_tasks.MakeLockGuard();
-    std::map<std::string, FileTransTaskContent *> closeTasks;
+    std::vector<std::pair<std::string, std::shared_ptr<FileTransferTask>>> closeTasks;
+    std::vector<std::shared_ptr<FileTransferTask>> stripeTasks;
     m_tasks.EnsureCall([&](std::map<std::string, FileTransTaskContent *> &map) -> void
                        {
                         for(auto pair:map){
                             FileTransTaskContent * content = pair.second;
-                            if(!content||!content->task)
+                            if(!content||!content->task||content->session == session)
                             {
-                                closeTasks[pair.first]= pair.second;
+                                closeTasks.emplace_back(pair.first, content ? content->task : nullptr);
                                 continue;
                             }
-                            if(content->session == session)
+                            auto it = std::find(content->stripes.begin(), content->stripes.end(), session);
+                            if(it != content->stripes.end())
                             {
-                                closeTasks[pair.first]= pair.second;
+                                // 附加会话断开只退出分条，任务继续在其余会话上进行
+                                content->stripes.erase(it);
+                                stripeTasks.emplace_back(content->task);
                             }
-                        } 
-                        for(auto &pair : closeTasks)
+                        } });
+
+    // 不持有m_tasks的锁调用任务；任务可能已被其他线程移除，仍须在此Close，等待其持锁的处理结束
+    for (auto &task : stripeTasks)
+        task->RemoveStripeSession(session);
+    for (auto &pair : closeTasks)
+    {
+        DeleteTask(pair.first);
+        if (pair.second)
+            pair.second->Close();
+    }
+}
+
+size_t FileTransManager::SessionTaskCount(BaseNetWorkSession *session)
+{
+    size_t count = 0;
+    m_tasks.EnsureCall([&](std::map<std::string, FileTransTaskContent *> &map) -> void
+                       {
+                        for (auto &pair : map)
                         {
-                            DeleteTask(pair.first);
+                            if (pair.second && pair.second->HasSession(session))
+                                count++;
                         } });
+    return count;
 }
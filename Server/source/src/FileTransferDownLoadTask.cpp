@@ -1,8 +1,18 @@
 #include "FileTransferDownLoadTask.h"
 #include "NetWorkHelper.h"
+#include "TransferScheduler.h"
+#include "FileRangeCache.h"
 
 #define enabledisplay 0
 
+constexpr int64_t bookkeepingflushms = 1000; // __chunks与MD5检查点的落盘间隔
+
+static int64_t GetTimestampMilliseconds()
+{
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+}
+
 void displayTransferProgress(uint64_t totalSize, const std::vector<FileTransferChunkInfo> &transferredChunks, int barWidth = 160)
 {
     if (enabledisplay != 1)
@@ -84,6 +94,23 @@ void displayTransferProgress(uint64_t totalSize, const std::vector<FileTransferC
     // sleep(1);
 }
 
+// __chunks文件格式: [ChunkFileHeader] 之后每个写入完成的分片一条ChunkFileRecord，按固定间隔批量追加
+// 打开时合并全部记录并重写，避免文件无限增长
+constexpr uint32_t ChunkFileMagic = 0x4B4E4843; // "CHNK"
+constexpr uint32_t ChunkFileVersion = 1;
+
+struct ChunkFileHeader
+{
+    uint32_t magic = ChunkFileMagic;
+    uint32_t version = ChunkFileVersion;
+};
+
+struct ChunkFileRecord
+{
+    uint64_t range_left;
+    uint64_t range_right;
+};
+
 std::string getChunkFilePath(const std::string &filepath)
 {
     return filepath + "__chunks";
@@ -94,11 +121,47 @@ std::string getMD5CheckPointFilePath(const std::string &filepath)
     return filepath + "__check";
 }
 
+std::string getMD5CheckPointTempFilePath(const std::string &filepath)
+{
+    return getMD5CheckPointFilePath(filepath) + "__tmp";
+}
+
 MD5CheckPoint::MD5CheckPoint()
 {
     progress = 0;
 }
 
+constexpr uint32_t MD5CheckPointMagic = 0x4B48434D; // "MCHK"
+constexpr uint32_t MD5CheckPointVersion = 1;
+
+MD5CheckPointRecord::MD5CheckPointRecord()
+{
+    memset(this, 0, sizeof(MD5CheckPointRecord)); // 填充字节也参与校验，需要清零
+    magic = MD5CheckPointMagic;
+    version = MD5CheckPointVersion;
+}
+
+// FNV-1a
+uint32_t MD5CheckPointRecord::CalcChecksum() const
+{
+    const uint8_t *ptr = reinterpret_cast<const uint8_t *>(this);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(MD5CheckPointRecord, checksum); i++)
+    {
+        hash ^= ptr[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool MD5CheckPointRecord::IsValid() const
+{
+    return magic == MD5CheckPointMagic &&
+           version == MD5CheckPointVersion &&
+           cachesize < sizeof(cache) &&
+           checksum == CalcChecksum();
+}
+
 FileTransferDownLoadTask::FileTransferDownLoadTask(const string &taskid, const string &filepath, const string &md5)
     : FileTransferTask(taskid, filepath, md5)
 {
@@ -106,6 +169,7 @@ FileTransferDownLoadTask::FileTransferDownLoadTask(const string &taskid, const s
 
 FileTransferDownLoadTask::~FileTransferDownLoadTask()
 {
+    file_io.Close(); // 等待在途的写回回调结束，回调中引用了本对象
 }
 
 void FileTransferDownLoadTask::ReleaseSource()
@@ -113,6 +177,11 @@ void FileTransferDownLoadTask::ReleaseSource()
     file_io.Close();
     chunk_map.clear();
     chunkfile_io.Close();
+    {
+        LockGuard guard(WriteLock);
+        written_map.clear();
+        unflushed_chunks.clear();
+    }
     // file_path.clear();
     // task_id.clear();
 }
@@ -121,7 +190,7 @@ void FileTransferDownLoadTask::InterruptTrans(BaseNetWorkSession *session)
 {
     InterruptedLock.Enter();
 
-    if (!IsFinished)
+    if (!IsFinished && !IsClosed)
     {
         json js_error;
         js_error["command"] = 7070;
@@ -143,95 +212,64 @@ void FileTransferDownLoadTask::InterruptTrans(BaseNetWorkSession *session)
     InterruptedLock.Leave();
 }
 
+// 先写临时文件并落盘，再rename覆盖，保证__check文件要么是旧记录要么是完整的新记录
 void FileTransferDownLoadTask::WriteToMD5CheckFile()
 {
     uint32_t curprogress = Progress();
     uint32_t lastcheckprogress = _MD5CheckPoint.progress;
     if (curprogress - lastcheckprogress < 20)
         return;
-    else
-    {
-        json js_checkfile;
-        {
-            json js_md5checkpoint;
-            {
-                json js_md5state;
-                std::shared_ptr<MD5SnapShot> shot = std::make_shared<MD5SnapShot>(_asyncmd5.SnapShot());
-                js_md5state["status0"] = shot->status[0];
-                js_md5state["status1"] = shot->status[1];
-                js_md5state["status2"] = shot->status[2];
-                js_md5state["status3"] = shot->status[3];
-                js_md5state["count"] = shot->count;
-
-                {
-                    json cache;
-                    {
-                        json data_array = json::array();
-
-                        uint8_t *ptr = (uint8_t *)(shot->cacheBuffer.Data());
-                        uint64_t length = shot->cacheBuffer.Length();
-                        for (uint64_t i = 0; i < length; i++)
-                            data_array.push_back(ptr[i]);
-
-                        cache["data"] = data_array;
-                        cache["size"] = length;
-                    }
-                    js_md5state["cache"] = cache;
-                }
-
-                js_md5state["isfinish"] = shot->isfinish;
-                js_md5state["md5string"] = shot->md5string;
-
-                _MD5CheckPoint.progress = curprogress;
-                _MD5CheckPoint.snap = shot;
-
-                js_md5checkpoint["md5state"] = js_md5state;
-                js_md5checkpoint["checkprogress"] = curprogress;
-            }
-            js_checkfile["md5checkpoint"] = js_md5checkpoint;
-        }
 
-        Buffer buf(js_checkfile.dump());
+    std::shared_ptr<MD5SnapShot> shot = std::make_shared<MD5SnapShot>(_asyncmd5.SnapShot());
+    if (shot->cacheBuffer.Length() >= sizeof(MD5CheckPointRecord::cache))
+        return;
 
-        string CheckPointFilePath = getMD5CheckPointFilePath(file_path);
-        FileIOHandler md5checkfile_io(CheckPointFilePath, FileIOHandler::OpenMode::WRITE_ONLY);
+    MD5CheckPointRecord record;
+    record.progress = curprogress;
+    memcpy(record.status, shot->status, sizeof(record.status));
+    record.count = shot->count;
+    record.cachesize = shot->cacheBuffer.Length();
+    memcpy(record.cache, shot->cacheBuffer.Data(), record.cachesize);
+    record.isfinish = shot->isfinish ? 1 : 0;
+    memcpy(record.md5string, shot->md5string.data(), std::min(shot->md5string.size(), sizeof(record.md5string)));
+    record.checksum = record.CalcChecksum();
 
-        md5checkfile_io.Seek(FileIOHandler::SeekOrigin::BEGIN);
-        long writecount = md5checkfile_io.Write(buf);
-        if (writecount != buf.Length())
+    string CheckPointFilePath = getMD5CheckPointFilePath(file_path);
+    string TempFilePath = getMD5CheckPointTempFilePath(file_path);
+    {
+        FileIOHandler md5checkfile_io(TempFilePath, FileIOHandler::OpenMode::WRITE_ONLY);
+        long writecount = md5checkfile_io.Write((const char *)&record, sizeof(record));
+        if (writecount != sizeof(record) || !md5checkfile_io.Flush())
         {
-            FileIOHandler::Remove(CheckPointFilePath);
+            md5checkfile_io.Close();
+            FileIOHandler::Remove(TempFilePath);
             return;
         }
-
-        if (md5checkfile_io.GetSize() > buf.Length())
-            md5checkfile_io.Truncate(buf.Length());
-
+    }
+    if (!FileIOHandler::RenameFile(TempFilePath, CheckPointFilePath))
+    {
+        FileIOHandler::Remove(TempFilePath);
         return;
     }
+
+    _MD5CheckPoint.progress = curprogress;
+    _MD5CheckPoint.snap = shot;
 }
 
+// 以当前chunk_map重写整个__chunks文件
 bool FileTransferDownLoadTask::WriteToChunkFile()
 {
     if (!IsChunkFileEnable)
         return false;
 
-    json js_chunkfile;
-    json js_chunkmap = json::array();
+    Buffer buf;
+    ChunkFileHeader header;
+    buf.Write(&header, sizeof(header));
     for (auto &chunkinfo : chunk_map)
     {
-        json js_info;
-        js_info["index"] = chunkinfo.index;
-
-        json js_range = json::array();
-        js_range.emplace_back(chunkinfo.range_left);
-        js_range.emplace_back(chunkinfo.range_right);
-        js_info["range"] = js_range;
-        js_chunkmap.emplace_back(js_info);
+        ChunkFileRecord record{chunkinfo.range_left, chunkinfo.range_right};
+        buf.Write(&record, sizeof(record));
     }
-    js_chunkfile["chunk_map"] = js_chunkmap;
-
-    Buffer buf(js_chunkfile.dump());
 
     chunkfile_io.Seek(FileIOHandler::SeekOrigin::BEGIN);
     long writecount = chunkfile_io.Write(buf);
@@ -244,6 +282,105 @@ bool FileTransferDownLoadTask::WriteToChunkFile()
     return true;
 }
 
+// 每个分片一条定长记录，一次落盘的记录合并为一次写入
+bool FileTransferDownLoadTask::AppendToChunkFile(const vector<FileTransferChunkInfo> &chunks)
+{
+    if (!IsChunkFileEnable)
+        return false;
+    if (chunks.empty())
+        return true;
+
+    Buffer buf;
+    for (auto &chunk : chunks)
+    {
+        ChunkFileRecord record{chunk.range_left, chunk.range_right};
+        buf.Write(&record, sizeof(record));
+    }
+    chunkfile_io.Seek(FileIOHandler::SeekOrigin::END);
+    return chunkfile_io.Write(buf) == (long)buf.Length();
+}
+
+// 分片数据的所有权转给写回请求，写入完成后才计入written_map，之后由FlushBookkeeping记录到__chunks
+bool FileTransferDownLoadTask::WriteChunkBehind(Buffer &buf, uint64_t range_left, uint64_t range_right)
+{
+    uint64_t chunksize = range_right - range_left + 1;
+    uint64_t position = buf.Position();
+    std::shared_ptr<Buffer> data = std::make_shared<Buffer>();
+    data->QuoteFromBuf(buf);
+
+    bool queued = file_io.WriteAsync(data->Byte() + position, chunksize, range_left,
+                                     [this, data, range_left, range_right, chunksize](long result)
+                                     {
+                                         if (result != (long)chunksize)
+                                         {
+                                             IsAsyncWriteFailed = true;
+                                             return;
+                                         }
+                                         {
+                                             LockGuard guard(WriteLock);
+                                             insertChunk(written_map, range_left, range_right);
+                                             unflushed_chunks.emplace_back(0, range_left, range_right);
+                                         }
+                                         // 区间已落盘，转发任务此时才能读取
+                                         if (_callbackWritten)
+                                             _callbackWritten(this);
+                                     });
+    if (queued)
+        file_io.SubmitAsync();
+    return queued;
+}
+
+bool FileTransferDownLoadTask::WaitChunkWrites()
+{
+    file_io.WaitAsync();
+    return !IsAsyncWriteFailed;
+}
+
+// 分片记录与MD5检查点按固定间隔落盘，不再在每个分片确认前同步写入
+void FileTransferDownLoadTask::FlushBookkeeping(bool force)
+{
+    int64_t now = GetTimestampMilliseconds();
+    if (!force && now - last_flush_time < bookkeepingflushms)
+        return;
+    last_flush_time = now;
+
+    vector<FileTransferChunkInfo> chunks;
+    {
+        LockGuard guard(WriteLock);
+        chunks.swap(unflushed_chunks);
+    }
+    AppendToChunkFile(chunks);
+    if (!IsChunkHash)
+        WriteToMD5CheckFile();
+}
+
+vector<FileTransferChunkInfo> FileTransferDownLoadTask::WrittenChunkMap()
+{
+    LockGuard guard(WriteLock);
+    return written_map;
+}
+
+void FileTransferDownLoadTask::ParseChunkMapEncoding(const json &js)
+{
+    IsBinaryChunkMap = js.contains("chunkmap_encoding") && js.at("chunkmap_encoding").is_number_unsigned() && js["chunkmap_encoding"] == ChunkMapEncodingBinary;
+}
+
+// 发送端提供的块大小与本端一致时才接受分片哈希，否则回退到MD5
+void FileTransferDownLoadTask::ParseChunkHash(const json &js)
+{
+    IsChunkHash = false;
+    if (!js.contains("chunk_hash") || !js.at("chunk_hash").is_number_unsigned() || js["chunk_hash"] != ChunkHashXXH64)
+        return;
+    if (!js.contains("merkle_block") || !js.at("merkle_block").is_number_unsigned() || js["merkle_block"] != MerkleBlockSize)
+        return;
+    if (!js.contains("merkle_root") || !js.at("merkle_root").is_string() ||
+        !ChunkHashHelper::FromHex(js.at("merkle_root").get<std::string>(), merkle_root))
+        return;
+
+    merkle_tree.Reset(file_size, MerkleBlockSize);
+    IsChunkHash = true;
+}
+
 bool FileTransferDownLoadTask::ParseChunkMap(const json &js)
 {
     bool parseresult = true;
@@ -287,83 +424,23 @@ bool FileTransferDownLoadTask::ParseChunkMap(const json &js)
     return parseresult;
 }
 
-bool FileTransferDownLoadTask::ParseMd5CheckPoint(const json &js)
+bool FileTransferDownLoadTask::ParseMd5CheckPoint(const MD5CheckPointRecord &record)
 {
-    bool success = true;
-    if (js.contains("md5checkpoint") && js.at("md5checkpoint").is_object())
-    {
-        json js_md5checkpoint = js["md5checkpoint"];
-        if (js_md5checkpoint.contains("md5state") && js_md5checkpoint.at("md5state").is_object() &&
-            js_md5checkpoint.contains("checkprogress") && js_md5checkpoint.at("checkprogress").is_number_unsigned())
-        {
-            std::shared_ptr<MD5SnapShot> shot = std::make_shared<MD5SnapShot>();
-            auto js_md5state = js_md5checkpoint["md5state"];
-            uint32_t progress = js_md5checkpoint["checkprogress"];
-
-            static std::vector<std::string> status_list{"status0", "status1", "status2", "status3"};
-
-            if (success)
-            {
-                for (int i = 0; i < status_list.size(); i++)
-                {
-                    if (js_md5state.contains(status_list[i]) && js_md5state.at(status_list[i]).is_number_unsigned())
-                        shot->status[i] = js_md5state[status_list[i]];
-                    else
-                    {
-                        success = false;
-                        break;
-                    }
-                }
-            }
-            if (success)
-            {
-                if (js_md5state.contains("count") && js_md5state.at("count").is_number_unsigned())
-                    shot->count = js_md5state["count"];
-                else
-                    success = false;
-            }
-            if (success)
-            {
-                if (js_md5state.contains("cache") && js_md5state.at("cache").is_object())
-                {
-                    json js_cache = js_md5state["cache"];
-                    if (js_cache.contains("data") && js_cache.at("data").is_array() && js_cache.contains("size") && js_cache.at("size").is_number_unsigned())
-                    {
-                        json js_data = js_cache["data"];
-                        uint64_t size = js_cache["size"];
-                        std::vector<uint8_t> data = js_data.get<std::vector<uint8_t>>();
-                        if (size == data.size())
-                            shot->cacheBuffer.Write(data.data(), data.size());
-                        else
-                            success = false;
-                    }
-                    else
-                        success = false;
-                }
-                else
-                    success = false;
-            }
-            if (success)
-            {
-                if (js_md5state.contains("isfinish") && js_md5state.at("isfinish").is_boolean())
-                    shot->isfinish = js_md5state["isfinish"];
-                else
-                    success = false;
-            }
-            if (success)
-            {
-                _asyncmd5.LoadSnapShot(*shot);
-                _MD5CheckPoint.progress = progress;
-                _MD5CheckPoint.snap = shot;
-            }
-        }
-        else
-            success = false;
-    }
-    else
-        success = false;
+    if (!record.IsValid())
+        return false;
 
-    return success;
+    std::shared_ptr<MD5SnapShot> shot = std::make_shared<MD5SnapShot>();
+    memcpy(shot->status, record.status, sizeof(shot->status));
+    shot->count = record.count;
+    shot->cacheBuffer.Write(record.cache, record.cachesize);
+    shot->isfinish = record.isfinish != 0;
+    if (shot->isfinish)
+        shot->md5string = string(record.md5string, sizeof(record.md5string));
+
+    _asyncmd5.LoadSnapShot(*shot);
+    _MD5CheckPoint.progress = record.progress;
+    _MD5CheckPoint.snap = shot;
+    return true;
 }
 
 bool FileTransferDownLoadTask::ReadChunkFile()
@@ -379,19 +456,38 @@ bool FileTransferDownLoadTask::ReadChunkFile()
         Buffer buf;
         chunkfile_io.Seek(FileIOHandler::SeekOrigin::BEGIN);
         chunkfile_io.Read(buf, chunkfile_io.GetSize());
-        string js_str(buf.Byte(), buf.Length());
-        json js;
-        try
+
+        ChunkFileHeader header;
+        if (buf.Length() >= sizeof(header) && ((ChunkFileHeader *)buf.Byte())->magic == ChunkFileMagic)
         {
-            js = json::parse(js_str);
+            buf.Read(&header, sizeof(header));
+            ChunkFileRecord record;
+            while (buf.Remain() >= sizeof(record)) // 末尾不完整的记录直接丢弃
+            {
+                buf.Read(&record, sizeof(record));
+                if (record.range_left <= record.range_right && record.range_right < file_size)
+                    insertChunk(chunk_map, record.range_left, record.range_right);
+            }
         }
-        catch (...)
+        else if (buf.Length() > 0)
         {
-            cout << fmt::format("json::parse error : {}\n", js_str);
-        }
+            // 兼容旧版本的json格式
+            string js_str(buf.Byte(), buf.Length());
+            json js;
+            try
+            {
+                js = json::parse(js_str);
+            }
+            catch (...)
+            {
+                cout << fmt::format("json::parse error : {}\n", js_str);
+            }
 
-        ParseChunkMap(js);
+            ParseChunkMap(js);
+        }
     }
+    if (IsChunkFileEnable)
+        WriteToChunkFile();
     return IsChunkFileEnable;
 }
 
@@ -403,35 +499,33 @@ bool FileTransferDownLoadTask::ReadMD5ChcekPointFile()
     if (!exist)
         return false;
 
+    // 旧版本的json格式或损坏的记录直接丢弃，结束传输时会从文件重新计算MD5
     FileIOHandler md5checkfile_io(CheckPointFilePath, FileIOHandler::OpenMode::READ_ONLY);
-    bool isopen = md5checkfile_io.IsOpen();
-    if (isopen)
-    {
-        Buffer buf;
-        md5checkfile_io.Seek(FileIOHandler::SeekOrigin::BEGIN);
-        md5checkfile_io.Read(buf, md5checkfile_io.GetSize());
-        md5checkfile_io.Close();
-        string js_str(buf.Byte(), buf.Length());
-        json js;
-        try
-        {
-            js = json::parse(js_str);
-        }
-        catch (...)
-        {
-            cout << fmt::format("json::parse error : {}\n", js_str);
-        }
-        ParseMd5CheckPoint(js);
-    }
-    return isopen;
+    if (!md5checkfile_io.IsOpen() || md5checkfile_io.GetSize() != sizeof(MD5CheckPointRecord))
+        return false;
+
+    MD5CheckPointRecord record;
+    if (md5checkfile_io.Read((char *)&record, sizeof(record)) != sizeof(record))
+        return false;
+    md5checkfile_io.Close();
+
+    return ParseMd5CheckPoint(record);
 }
 
 bool FileTransferDownLoadTask::ParseFile()
 {
     ReleaseSource();
     IsFileEnable = file_io.Open(file_path, FileIOHandler::OpenMode::READ_WRITE);
+    if (IsFileEnable && file_size > 0 && (uint64_t)file_io.GetSize() < file_size)
+        file_io.Allocate(file_size);
     ReadChunkFile();
     ReadMD5ChcekPointFile();
+    {
+        LockGuard guard(WriteLock);
+        written_map = chunk_map; // 恢复的区间都已在文件中
+    }
+    IsAsyncWriteFailed = false;
+    last_flush_time = GetTimestampMilliseconds();
     return IsFileEnable && IsChunkFileEnable;
 }
 
@@ -444,15 +538,14 @@ void FileTransferDownLoadTask::AsyncMD5Update()
 {
     static constexpr uint64_t max_read_block_size = 5 * 1024 * 1024;
     uint64_t hasuploadsize = _asyncmd5.Count();
-    for (auto &chunk : chunk_map)
+    for (auto &chunk : WrittenChunkMap())
     {
         if (hasuploadsize >= chunk.range_left && hasuploadsize <= chunk.range_right)
         {
             uint64_t readpostion = hasuploadsize;
             uint64_t readsize = std::min((chunk.range_right + 1) - readpostion, max_read_block_size);
             Buffer buf;
-            file_io.Seek(FileIOHandler::SeekOrigin::BEGIN, readpostion);
-            file_io.Read(buf, readsize);
+            file_io.ReadAt(buf, readsize, readpostion);
             _asyncmd5.Update(buf);
             break;
         }
@@ -472,8 +565,7 @@ std::string FileTransferDownLoadTask::AsyncMD5Final()
             uint64_t readpostion = totalsize - remainsize;
             uint64_t readsize = std::min(remainsize, (uint64_t)max_read_block_size);
             Buffer buf;
-            file_io.Seek(FileIOHandler::SeekOrigin::BEGIN, readpostion);
-            file_io.Read(buf, readsize);
+            file_io.ReadAt(buf, readsize, readpostion);
             _asyncmd5.UpdateSync(buf);
             remainsize -= readsize;
         }
@@ -481,6 +573,93 @@ std::string FileTransferDownLoadTask::AsyncMD5Final()
     return _asyncmd5.Final();
 }
 
+// 被已写入区间与本分片完整覆盖的块立即计算叶子；分片本身覆盖整块时直接使用消息中的数据
+// 本分片尚在写回队列中，块内属于本分片的部分从消息数据中补上
+void FileTransferDownLoadTask::MerkleUpdate(uint64_t range_left, uint64_t range_right, const char *data, const vector<FileTransferChunkInfo> &written)
+{
+    size_t first = range_left / MerkleBlockSize;
+    size_t last = range_right / MerkleBlockSize;
+    vector<FileTransferChunkInfo> available = written;
+    insertChunk(available, range_left, range_right);
+    Buffer block;
+    for (size_t i = first; i <= last && i < merkle_tree.BlockCount(); i++)
+    {
+        if (merkle_tree.IsLeafReady(i))
+            continue;
+
+        uint64_t blockleft = merkle_tree.BlockLeft(i);
+        uint64_t blockright = merkle_tree.BlockRight(i);
+        uint64_t length = blockright - blockleft + 1;
+        if (blockleft >= range_left && blockright <= range_right)
+        {
+            merkle_tree.SetLeaf(i, ChunkHashHelper::XXH64(data + (blockleft - range_left), length));
+            continue;
+        }
+
+        bool covered = false;
+        for (auto &chunk : available)
+        {
+            if (chunk.range_left <= blockleft && chunk.range_right >= blockright)
+            {
+                covered = true;
+                break;
+            }
+        }
+        if (!covered)
+            continue;
+
+        block.Seek(0);
+        if (file_io.ReadAt(block, length, blockleft) != (long)length)
+            continue;
+        uint64_t left = std::max(blockleft, range_left);
+        uint64_t right = std::min(blockright, range_right);
+        memcpy(block.Byte() + (left - blockleft), data + (left - range_left), right - left + 1);
+        merkle_tree.SetLeaf(i, ChunkHashHelper::XXH64(block.Byte(), length));
+    }
+}
+
+// 补算恢复传输前已接收部分的叶子，再与发送端的Merkle根比较
+bool FileTransferDownLoadTask::MerkleFinal()
+{
+    std::vector<char> block(MerkleBlockSize);
+    for (size_t i = 0; i < merkle_tree.BlockCount(); i++)
+    {
+        if (merkle_tree.IsLeafReady(i))
+            continue;
+
+        uint64_t blockleft = merkle_tree.BlockLeft(i);
+        uint64_t length = merkle_tree.BlockRight(i) - blockleft + 1;
+        if (file_io.ReadAt(block.data(), length, blockleft) != (long)length)
+            return false;
+        merkle_tree.SetLeaf(i, ChunkHashHelper::XXH64(block.data(), length));
+    }
+    return merkle_tree.Root() == merkle_root;
+}
+
+bool FileTransferDownLoadTask::CheckFileIntegrity()
+{
+    if (IsChunkHash)
+        return MerkleFinal();
+    return _md5 == AsyncMD5Final();
+}
+
+// 在任务加锁前调用，多个分条会话上的分片可以并行校验；格式错误留给RecvChunkDataAndAck处理
+bool FileTransferDownLoadTask::VerifyChunkHash(const json &js, const Buffer &buf)
+{
+    if (!IsChunkHash)
+        return true;
+    if (!js.contains("chunk_size") || !js.at("chunk_size").is_number_unsigned())
+        return true;
+
+    uint64_t chunksize = js["chunk_size"];
+    if (buf.Remain() < chunksize + ChunkHashSize)
+        return true;
+
+    uint64_t expected = 0;
+    memcpy(&expected, buf.Byte() + buf.Position() + chunksize, sizeof(expected));
+    return ChunkHashHelper::XXH64(buf.Byte() + buf.Position(), chunksize) == expected;
+}
+
 void FileTransferDownLoadTask::OccurError(BaseNetWorkSession *session)
 {
     if (!IsError)
@@ -539,6 +718,8 @@ void FileTransferDownLoadTask::RecvTransReq(BaseNetWorkSession *session, const j
     }
 
     ParseFile();
+    ParseChunkMapEncoding(js);
+    ParseChunkHash(js);
 
     json js_reply;
     js_reply["command"] = 8000;
@@ -547,24 +728,22 @@ void FileTransferDownLoadTask::RecvTransReq(BaseNetWorkSession *session, const j
     js_reply["filesize"] = file_size;
     js_reply["result"] = IsFileEnable == true ? 1 : 0;
     js_reply["suggest_chunsize"] = GetSuggestChunsize(file_size);
+    if (js.contains("window") && js.at("window").is_number_unsigned())
+        js_reply["window"] = std::min((uint32_t)js["window"], GetTransferWindowSize());
+    if (IsChunkHash)
+        js_reply["chunk_hash"] = ChunkHashXXH64;
 
-    json js_chunkmap = json::array();
-    for (auto &chunkinfo : chunk_map)
+    Buffer buf_chunkmap;
+    if (IsBinaryChunkMap)
     {
-        json js_info;
-        js_info["index"] = chunkinfo.index;
-
-        json js_range = json::array();
-        js_range.emplace_back(chunkinfo.range_left);
-        js_range.emplace_back(chunkinfo.range_right);
-        js_info["range"] = js_range;
-        js_chunkmap.emplace_back(js_info);
+        js_reply["chunkmap_encoding"] = ChunkMapEncodingBinary;
+        EncodeChunkMap(chunk_map, buf_chunkmap);
     }
+    else
+        js_reply["chunk_map"] = ChunkMapToJson(chunk_map);
     displayTransferProgress(file_size, chunk_map);
 
-    js_reply["chunk_map"] = js_chunkmap;
-
-    if (!NetWorkHelper::SendMessagePackage(session, &js_reply))
+    if (!NetWorkHelper::SendMessagePackage(session, &js_reply, &buf_chunkmap))
     {
         IsNetworkEnable = false;
         OccurError(session);
@@ -591,6 +770,8 @@ void FileTransferDownLoadTask::AckTransReq(BaseNetWorkSession *session, const js
 
     if (ackresult)
         ParseFile();
+    ParseChunkMapEncoding(js);
+    ParseChunkHash(js);
 
     json js_reply;
     js_reply["command"] = 8000;
@@ -598,27 +779,25 @@ void FileTransferDownLoadTask::AckTransReq(BaseNetWorkSession *session, const js
     js_reply["filesize"] = file_size;
     js_reply["result"] = (ackresult && IsFileEnable) == true ? 1 : 0;
     js_reply["suggest_chunsize"] = GetSuggestChunsize(file_size);
+    if (js.contains("window") && js.at("window").is_number_unsigned())
+        js_reply["window"] = std::min((uint32_t)js["window"], GetTransferWindowSize());
+    if (IsChunkHash)
+        js_reply["chunk_hash"] = ChunkHashXXH64;
 
+    Buffer buf_chunkmap;
     if (ackresult)
     {
-        json js_chunkmap = json::array();
-        for (auto &chunkinfo : chunk_map)
+        if (IsBinaryChunkMap)
         {
-            json js_info;
-            js_info["index"] = chunkinfo.index;
-
-            json js_range = json::array();
-            js_range.emplace_back(chunkinfo.range_left);
-            js_range.emplace_back(chunkinfo.range_right);
-            js_info["range"] = js_range;
-            js_chunkmap.emplace_back(js_info);
+            js_reply["chunkmap_encoding"] = ChunkMapEncodingBinary;
+            EncodeChunkMap(chunk_map, buf_chunkmap);
         }
+        else
+            js_reply["chunk_map"] = ChunkMapToJson(chunk_map);
         displayTransferProgress(file_size, chunk_map);
-
-        js_reply["chunk_map"] = js_chunkmap;
     }
 
-    if (!NetWorkHelper::SendMessagePackage(session, &js_reply))
+    if (!NetWorkHelper::SendMessagePackage(session, &js_reply, &buf_chunkmap))
     {
         IsNetworkEnable = false;
         OccurError(session);
@@ -628,7 +807,7 @@ void FileTransferDownLoadTask::AckTransReq(BaseNetWorkSession *session, const js
         OccurProgressChange();
 }
 
-void FileTransferDownLoadTask::RecvChunkDataAndAck(BaseNetWorkSession *session, const json &js, Buffer &buf)
+void FileTransferDownLoadTask::RecvChunkDataAndAck(BaseNetWorkSession *session, const json &js, Buffer &buf, bool chunkhashok)
 {
     bool error = false;
     if (!js.contains("chunk_size") || !js.at("chunk_size").is_number_unsigned())
@@ -654,41 +833,52 @@ void FileTransferDownLoadTask::RecvChunkDataAndAck(BaseNetWorkSession *session,
     chunkdata.range_left = js.at("range").at(0);
     chunkdata.range_right = js.at("range").at(1);
 
-    if (buf.Remain() < chunksize)
+    if (buf.Remain() < chunksize + (IsChunkHash ? ChunkHashSize : 0))
     {
         error = true;
         OccurError(session);
         return;
     }
 
-    chunkdata.buf.Append(buf, chunksize);
+    // 分片损坏时不写入，只要求发送端重发该分片
+    if (!chunkhashok)
+    {
+        json js_nak;
+        js_nak["command"] = 8001;
+        js_nak["taskid"] = task_id;
+        js_nak["chunk_size"] = chunksize;
+        json js_range = json::array();
+        js_range.emplace_back(chunkdata.range_left);
+        js_range.emplace_back(chunkdata.range_right);
+        js_nak["range"] = js_range;
+        js_nak["result"] = 0;
+        js_nak["hash_mismatch"] = 1;
+        if (!NetWorkHelper::SendMessagePackage(session, &js_nak))
+        {
+            IsNetworkEnable = false;
+            OccurError(session);
+        }
+        return;
+    }
 
-    if (IsFileEnable)
+    if (IsFileEnable && !IsAsyncWriteFailed)
     {
-        file_io.Seek(FileIOHandler::SeekOrigin::BEGIN, chunkdata.range_left);
-        long truthwritecount = file_io.Write(chunkdata.buf.Byte(), chunksize);
-        if (truthwritecount < 0)
+        // Merkle叶子须在数据移交写回队列之前计算
+        if (IsChunkHash)
+            MerkleUpdate(chunkdata.range_left, chunkdata.range_right, buf.Byte() + buf.Position(), WrittenChunkMap());
+
+        // 直接以消息缓冲区作为写入源，确认不等待写入完成；写入失败在下一个分片或结束时处理
+        if (!WriteChunkBehind(buf, chunkdata.range_left, chunkdata.range_right))
         {
             error = true;
             OccurError(session);
             return;
         }
-        else
-        {
-            if (truthwritecount > chunksize)
-            {
-                error = true;
-                OccurError(session);
-            }
-        }
 
-        if (!error)
-        {
-            chunk_map.emplace_back(0, chunkdata.range_left, chunkdata.range_right);
-            chunk_map = mergeChunks(chunk_map);
-            displayTransferProgress(file_size, chunk_map);
+        insertChunk(chunk_map, chunkdata.range_left, chunkdata.range_right);
+        displayTransferProgress(file_size, chunk_map);
+        if (!IsChunkHash)
             AsyncMD5Update();
-        }
     }
     else
     {
@@ -696,16 +886,19 @@ void FileTransferDownLoadTask::RecvChunkDataAndAck(BaseNetWorkSession *session,
         return;
     }
 
-    if (IsChunkFileEnable)
-        WriteToChunkFile();
-    WriteToMD5CheckFile();
+    FlushBookkeeping(false);
 
     json js_reply;
     bool finished = CheckTransFinish();
     if (finished)
     {
+        if (!WaitChunkWrites())
+        {
+            OccurError(session);
+            return;
+        }
         file_io.Truncate(file_size);
-        if (_md5 != AsyncMD5Final())
+        if (!CheckFileIntegrity())
         {
             OccurError(session);
             return;
@@ -727,20 +920,16 @@ void FileTransferDownLoadTask::RecvChunkDataAndAck(BaseNetWorkSession *session,
         js_range.emplace_back(chunkdata.range_right);
         js_reply["range"] = js_range;
         js_reply["result"] = error == true ? 1 : 0;
-        json js_chunkmap = json::array();
-        for (auto &chunkinfo : chunk_map)
-        {
-            json js_info;
-            js_info["index"] = chunkinfo.index;
+        if (!IsBinaryChunkMap) // 二进制模式下发送端根据range自行累加，无需每次回传完整chunk_map
+            js_reply["chunk_map"] = ChunkMapToJson(chunk_map);
 
-            json js_range = json::array();
-            js_range.emplace_back(chunkinfo.range_left);
-            js_range.emplace_back(chunkinfo.range_right);
-            js_info["range"] = js_range;
-            js_chunkmap.emplace_back(js_info);
+        // 接收带宽不足时推迟确认，发送端窗口用尽后自然停止发送
+        if (!pending_acks.empty() || !TRANSFERSCHEDULER->Acquire(task_id, chunksize))
+        {
+            pending_acks.emplace_back(session, js_reply);
+            OccurProgressChange();
+            return;
         }
-
-        js_reply["chunk_map"] = js_chunkmap;
     }
     if (!NetWorkHelper::SendMessagePackage(session, &js_reply))
     {
@@ -756,9 +945,38 @@ void FileTransferDownLoadTask::RecvChunkDataAndAck(BaseNetWorkSession *session,
     }
 }
 
+void FileTransferDownLoadTask::ResumeTrans(BaseNetWorkSession *session)
+{
+    LockGuard guard(InterruptedLock);
+    if (IsClosed || IsFinished || IsError || IsInterrupted)
+        return;
+
+    // 确认从承载该分片的会话发回，所在会话已退出分条时改由发起会话发送
+    for (auto &pending : pending_acks)
+    {
+        BaseNetWorkSession *acksession = pending.first ? pending.first : session;
+        if (!NetWorkHelper::SendMessagePackage(acksession, &pending.second))
+        {
+            IsNetworkEnable = false;
+            OccurError(session);
+            return;
+        }
+    }
+    pending_acks.clear();
+}
+
+void FileTransferDownLoadTask::OnStripeSessionRemoved(BaseNetWorkSession *session)
+{
+    for (auto &pending : pending_acks)
+    {
+        if (pending.first == session)
+            pending.first = nullptr;
+    }
+}
+
 void FileTransferDownLoadTask::AckRecvFinished(BaseNetWorkSession *session, const json &js)
 {
-    IsFinished = CheckTransFinish();
+    IsFinished = CheckTransFinish() && WaitChunkWrites();
     if (IsFinished)
     {
         if (!IsFileEnable)
@@ -769,7 +987,7 @@ void FileTransferDownLoadTask::AckRecvFinished(BaseNetWorkSession *session, cons
 
     if (IsFinished)
     {
-        if (_md5 != AsyncMD5Final())
+        if (!CheckFileIntegrity())
         {
             OccurError(session);
             return;
@@ -832,13 +1050,17 @@ void FileTransferDownLoadTask::OnError()
         auto file_path = file_io.FilePath();
         auto chunkfile_path = chunkfile_io.FilePath();
         auto checkpoint_path = getMD5CheckPointFilePath(file_path);
+        auto checkpoint_temp_path = getMD5CheckPointTempFilePath(file_path);
         ReleaseSource();
         if (FileIOHandler::Exists(file_path))
             FileIOHandler::Remove(file_path);
+        FILERANGECACHE->Remove(file_path);
         if (FileIOHandler::Exists(chunkfile_path))
             FileIOHandler::Remove(chunkfile_path);
         if (FileIOHandler::Exists(checkpoint_path))
             FileIOHandler::Remove(checkpoint_path);
+        if (FileIOHandler::Exists(checkpoint_temp_path))
+            FileIOHandler::Remove(checkpoint_temp_path);
         if (_callbackError)
             _callbackError(this);
     }
@@ -853,11 +1075,14 @@ void FileTransferDownLoadTask::OnFinished()
     {
         auto chunkfile_path = chunkfile_io.FilePath();
         auto checkpoint_path = getMD5CheckPointFilePath(file_path);
+        auto checkpoint_temp_path = getMD5CheckPointTempFilePath(file_path);
         ReleaseSource();
         if (FileIOHandler::Exists(chunkfile_path))
             FileIOHandler::Remove(chunkfile_path);
         if (FileIOHandler::Exists(checkpoint_path))
             FileIOHandler::Remove(checkpoint_path);
+        if (FileIOHandler::Exists(checkpoint_temp_path))
+            FileIOHandler::Remove(checkpoint_temp_path);
         if (_callbackFinieshed)
             _callbackFinieshed(this);
     }
@@ -870,6 +1095,9 @@ void FileTransferDownLoadTask::OnInterrupted()
 {
     try
     {
+        // 保留已写入的进度，续传时从__chunks恢复
+        file_io.WaitAsync();
+        FlushBookkeeping(true);
         ReleaseSource();
         if (_callbackInterrupted)
             _callbackInterrupted(this);
@@ -906,7 +1134,14 @@ void FileTransferDownLoadTask::ProcessMsg(BaseNetWorkSession *session, const jso
         if (command != 7000 && command != 7001 && command != 7010 && command != 7080 && command != 7070)
             return;
 
-        InterruptedLock.Enter();
+        bool chunkhashok = command != 7001 || VerifyChunkHash(js, buf);
+
+        // 分条传输时消息可能来自多个会话线程，整个处理过程须串行，提前返回时也要释放锁
+        LockGuard guard(InterruptedLock);
+
+        // 发起会话关闭后任务已移除，附加会话上仍在处理的消息直接忽略
+        if (IsClosed)
+            return;
 
         if (IsFinished)
         {
@@ -945,7 +1180,7 @@ void FileTransferDownLoadTask::ProcessMsg(BaseNetWorkSession *session, const jso
         }
         if (command == 7001)
         {
-            RecvChunkDataAndAck(session, js, buf);
+            RecvChunkDataAndAck(session, js, buf, chunkhashok);
         }
         if (command == 7010)
         {
@@ -955,8 +1190,6 @@ void FileTransferDownLoadTask::ProcessMsg(BaseNetWorkSession *session, const jso
         {
             RecvPeerInterrupt(js);
         }
-
-        InterruptedLock.Leave();
     }
 }
 
@@ -980,6 +1213,11 @@ void FileTransferDownLoadTask::BindProgressCallBack(std::function<void(FileTrans
     _callbackProgress = callback;
 }
 
+void FileTransferDownLoadTask::BindWrittenCallBack(std::function<void(FileTransferDownLoadTask *)> callback)
+{
+    _callbackWritten = callback;
+}
+
 void FileTransferDownLoadTask::RegisterTransInfo(const string &filepath, const string &md5, uint64_t filesize)
 {
     file_path = filepath;
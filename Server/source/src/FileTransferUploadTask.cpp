@@ -1,21 +1,74 @@
 #include "FileTransferUploadTask.h"
 #include "NetWorkHelper.h"
+#include "TransferScheduler.h"
+#include "OutboundLimiter.h"
 #include "MD5Helper.h"
+#include "ChunkHashHelper.h"
+
+constexpr int64_t chunkretransmitms = 15 * 1000; // 在途分片超过该时间未确认则重传
+
+static int64_t GetTimestampMilliseconds()
+{
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+}
+
+void FileRelaySource::Update(const vector<FileTransferChunkInfo> &chunkmap)
+{
+    LockGuard guard(_lock);
+    _chunkmap = chunkmap;
+}
+
+void FileRelaySource::MarkCompleted()
+{
+    LockGuard guard(_lock);
+    _completed = true;
+}
+
+void FileRelaySource::MarkFailed()
+{
+    LockGuard guard(_lock);
+    _failed = true;
+}
+
+void FileRelaySource::Snapshot(vector<FileTransferChunkInfo> &chunkmap, bool &completed, bool &failed)
+{
+    LockGuard guard(_lock);
+    chunkmap = _chunkmap;
+    completed = _completed;
+    failed = _failed;
+}
+
+void FileRelaySource::AddWaiter(const string &taskid)
+{
+    LockGuard guard(_lock);
+    if (std::find(_waiters.begin(), _waiters.end(), taskid) == _waiters.end())
+        _waiters.emplace_back(taskid);
+}
+
+vector<string> FileRelaySource::Waiters()
+{
+    LockGuard guard(_lock);
+    return _waiters;
+}
 
 FileTransferUploadTask::FileTransferUploadTask(const string &taskid, const string &filepath, const string &md5)
     : FileTransferTask(taskid, filepath, md5)
 {
-    ParseFile();
 }
 FileTransferUploadTask::~FileTransferUploadTask()
 {
+    CancelRetransmitTimer();
+    file_io.Close(); // 等待在途的异步读取回调结束，回调中引用了本对象
 }
 
 void FileTransferUploadTask::ReleaseSource()
 {
+    CancelRetransmitTimer();
     file_io.Close();
     file_size = 0;
     chunk_map.clear();
+    send_window.Clear();
     // file_path.clear();
     // task_id.clear();
 }
@@ -24,7 +77,8 @@ void FileTransferUploadTask::InterruptTrans(BaseNetWorkSession *session)
 {
     InterruptedLock.Enter();
 
-    if (!IsFinished)
+    CancelRetransmitTimer();
+    if (!IsFinished && !IsClosed)
     {
         json js_error;
         js_error["command"] = 7070;
@@ -66,7 +120,7 @@ bool FileTransferUploadTask::ParseFile()
 
 void FileTransferUploadTask::SendTransReq(BaseNetWorkSession *session)
 {
-    if (!IsFileEnable)
+    if (!IsFileEnable && !relay_source)
         return;
 
     json js;
@@ -74,12 +128,24 @@ void FileTransferUploadTask::SendTransReq(BaseNetWorkSession *session)
     js["taskid"] = task_id;
     js["filename"] = getFilenameFromPath(file_path);
     js["filesize"] = file_size;
+    js["window"] = GetTransferWindowSize();
+    js["chunkmap_encoding"] = ChunkMapEncodingBinary;
+
+    // 同时提供分片哈希与Merkle根，对端不支持时忽略这些字段，仍按MD5校验
+    // 转发中的文件尚未完整，无法计算Merkle根，只使用上传者登记的MD5
+    uint64_t merkleroot = 0;
+    if (!relay_source && GetFileMerkleRoot(file_io, file_size, merkleroot))
+    {
+        js["chunk_hash"] = ChunkHashXXH64;
+        js["merkle_block"] = MerkleBlockSize;
+        js["merkle_root"] = ChunkHashHelper::ToHex(merkleroot);
+    }
 
     if (!NetWorkHelper::SendMessagePackage(session, &js))
         IsNetworkEnable = false;
 }
 
-void FileTransferUploadTask::AckTransReqResult(BaseNetWorkSession *session, const json &js)
+void FileTransferUploadTask::AckTransReqResult(BaseNetWorkSession *session, const json &js, Buffer &buf)
 {
     if (!ParseReqResult(js))
     {
@@ -92,18 +158,51 @@ void FileTransferUploadTask::AckTransReqResult(BaseNetWorkSession *session, cons
         OccurError(session);
         return;
     }
-    if (!ParseChunkMap(js))
+    if (!ParseChunkMap(js, buf))
     {
         OccurError(session);
         return;
     }
+    ParseWindowSize(js);
+    ParseChunkHash(js);
+    chunk_policy = CreateChunkSizePolicy(suggest_chunksize, send_window.WindowSize());
     OccurProgressChange();
     SendNextChunkData(session);
 }
 
 void FileTransferUploadTask::RecvChunkMapAndSendNextData(BaseNetWorkSession *session, const json &js)
 {
-    if (!ParseChunkMap(js))
+    if (js.contains("hash_mismatch"))
+    {
+        if (!RecvChunkHashMismatch(js))
+        {
+            OccurError(session);
+            return;
+        }
+    }
+    else if (js.contains("chunk_map"))
+    {
+        Buffer empty;
+        if (!ParseChunkMap(js, empty))
+        {
+            OccurError(session);
+            return;
+        }
+    }
+    else if (js.contains("range") && js.at("range").is_array() && js.at("range").size() == 2 &&
+             js.at("range").at(0).is_number_unsigned() && js.at("range").at(1).is_number_unsigned())
+    {
+        // 二进制模式下8001仅携带本次确认的区间
+        uint64_t left = js.at("range").at(0);
+        uint64_t right = js.at("range").at(1);
+        if (left > right || right >= file_size)
+        {
+            OccurError(session);
+            return;
+        }
+        insertChunk(chunk_map, left, right);
+    }
+    else
     {
         OccurError(session);
         return;
@@ -112,6 +211,26 @@ void FileTransferUploadTask::RecvChunkMapAndSendNextData(BaseNetWorkSession *ses
     SendNextChunkData(session);
 }
 
+// 分片在传输中损坏，只将该分片标记为立即超时，由RetransmitExpiredChunks单独重发
+bool FileTransferUploadTask::RecvChunkHashMismatch(const json &js)
+{
+    if (!IsChunkHash || !js.contains("range") || !js.at("range").is_array() || js.at("range").size() != 2 ||
+        !js.at("range").at(0).is_number_unsigned() || !js.at("range").at(1).is_number_unsigned())
+        return false;
+
+    uint64_t left = js.at("range").at(0);
+    uint64_t right = js.at("range").at(1);
+    send_window.ExpireRange(left, right);
+    return true;
+}
+
+// 退出分条的会话上未确认的分片可能已随连接丢失，标记为立即超时，下次发送时改由其余会话重传
+void FileTransferUploadTask::OnStripeSessionRemoved(BaseNetWorkSession *session)
+{
+    send_window.ExpireSession(session);
+    ArmRetransmitTimer();
+}
+
 bool FileTransferUploadTask::ParseReqResult(const json &js)
 {
     if (js.contains("result") && js.at("result").is_number_unsigned())
@@ -133,10 +252,33 @@ bool FileTransferUploadTask::ParseSuggestChunkSize(const json &js)
         return false;
 }
 
-bool FileTransferUploadTask::ParseChunkMap(const json &js)
+// 对端未携带window字段时视为旧版本，按停等模式发送
+void FileTransferUploadTask::ParseWindowSize(const json &js)
+{
+    uint32_t window = 1;
+    if (js.contains("window") && js.at("window").is_number_unsigned())
+    {
+        window = js["window"];
+        window = std::clamp(window, (uint32_t)1, GetTransferWindowSize());
+    }
+    send_window.Reset(window);
+}
+
+// 接收端在8000中回传chunk_hash表示接受分片哈希
+void FileTransferUploadTask::ParseChunkHash(const json &js)
+{
+    IsChunkHash = js.contains("chunk_hash") && js.at("chunk_hash").is_number_unsigned() && js["chunk_hash"] == ChunkHashXXH64;
+}
+
+bool FileTransferUploadTask::ParseChunkMap(const json &js, Buffer &buf)
 {
     bool parseresult = true;
-    if (js.contains("chunk_map") && js.at("chunk_map").is_array())
+    if (js.contains("chunkmap_encoding") && js.at("chunkmap_encoding").is_number_unsigned() && js["chunkmap_encoding"] == ChunkMapEncodingBinary)
+    {
+        buf.Seek(0);
+        parseresult = DecodeChunkMap(buf, chunk_map);
+    }
+    else if (js.contains("chunk_map") && js.at("chunk_map").is_array())
     {
         vector<FileTransferChunkInfo> chunkmap;
         json js_chunkmap = js.at("chunk_map");
@@ -214,11 +356,98 @@ uint32_t FileTransferUploadTask::Progress()
     return CountProgress(chunk_map, file_size);
 }
 
+// 移除已被对端chunk_map覆盖的在途分片，并将确认结果反馈给分片大小策略
+void FileTransferUploadTask::ReleaseAckedChunks()
+{
+    int64_t now = GetTimestampMilliseconds();
+    send_window.Release(chunk_map, now,
+                        [this, now](uint64_t chunksize, int64_t rttms)
+                        {
+                            if (chunk_policy)
+                                chunk_policy->OnChunkAcked(chunksize, rttms, now);
+                        });
+}
+
+// 选择性重传：仅重发超时未确认的分片；同一轮的多个超时视为一次拥塞信号，分片大小只回退一次
+bool FileTransferUploadTask::RetransmitExpiredChunks(BaseNetWorkSession *session)
+{
+    int retransmitted = send_window.RetransmitExpired(GetTimestampMilliseconds(), chunkretransmitms,
+                                                      [this, session](uint64_t left, uint64_t right) -> BaseNetWorkSession *
+                                                      {
+                                                          BaseNetWorkSession *stripe = NextStripeSession(session);
+                                                          return SendChunkData(stripe, left, right) ? stripe : nullptr;
+                                                      });
+    if (retransmitted < 0)
+        return false;
+    if (retransmitted > 0 && chunk_policy)
+        chunk_policy->OnChunkTimeout();
+    return true;
+}
+
+// 按最早在途分片的超时时间设置重传定时器，在时间轮线程触发后经管理者转到会话处理线程执行ResumeTrans
+// 接收端长时间没有任何确认时也能重传，不依赖下一个8001到达
+void FileTransferUploadTask::ArmRetransmitTimer()
+{
+    CancelRetransmitTimer();
+    int64_t deadline = send_window.NextDeadline(chunkretransmitms);
+    if (deadline < 0 || !_callbackRetransmit)
+        return;
+    int64_t delay = std::max(deadline - GetTimestampMilliseconds(), (int64_t)0);
+    retransmit_timer = TIMINGWHEEL->Schedule(delay, _callbackRetransmit);
+}
+
+void FileTransferUploadTask::CancelRetransmitTimer()
+{
+    if (retransmit_timer)
+    {
+        TIMINGWHEEL->Cancel(retransmit_timer);
+        retransmit_timer = 0;
+    }
+}
+
+bool FileTransferUploadTask::SendChunkData(BaseNetWorkSession *stripe, uint64_t range_left, uint64_t range_right)
+{
+    uint64_t chunksize = range_right - range_left + 1;
+
+    json js_data;
+    js_data["command"] = 7001;
+    js_data["taskid"] = task_id;
+    js_data["chunk_size"] = chunksize;
+    json js_range = json::array();
+    js_range.emplace_back(range_left);
+    js_range.emplace_back(range_right);
+    js_data["range"] = js_range;
+
+    // 文件数据直接读入最终的发送缓冲区，读取完成后在io_uring完成线程中发送
+    // 回调中不直接触发错误，只记录标志，由下一次消息处理统一处理
+    // 分片哈希在读取完成后计算，填入预留在数据之后的位置
+    bool chunkhash = IsChunkHash;
+    std::shared_ptr<Buffer> buf = std::make_shared<Buffer>();
+    uint64_t bodypos = GenerateMessagePackageHeaderToBuffer(js_data, chunksize + (chunkhash ? ChunkHashSize : 0), buf.get());
+    // 回调持有会话的裸指针：会话关闭时先经SessionClose关闭任务或RemoveStripeSession，二者都等待在途读取结束，之后才释放会话
+    return file_io.ReadAsync(buf->Byte() + bodypos, chunksize, range_left,
+                             [this, stripe, buf, bodypos, chunksize, chunkhash](long result)
+                             {
+                                 if (result == (long)chunksize && chunkhash)
+                                 {
+                                     uint64_t hash = ChunkHashHelper::XXH64(buf->Byte() + bodypos, chunksize);
+                                     memcpy(buf->Byte() + bodypos + chunksize, &hash, sizeof(hash));
+                                 }
+                                 if (result != (long)chunksize || !OUTBOUNDLIMITER->Send(stripe, *buf))
+                                     IsAsyncSendFailed = true;
+                             });
+}
+
 void FileTransferUploadTask::SendNextChunkData(BaseNetWorkSession *session)
 {
     vector<FileTransferChunkInfo> untrans_chunks = getUntransferredChunks(chunk_map, file_size);
     if (untrans_chunks.empty()) // 发送完毕
     {
+        send_window.Clear();
+        CancelRetransmitTimer();
+        if (IsFinishSent)
+            return;
+
         json js_success;
         js_success["command"] = 7010;
         js_success["taskid"] = task_id;
@@ -230,38 +459,128 @@ void FileTransferUploadTask::SendNextChunkData(BaseNetWorkSession *session)
             OccurError(session);
             return;
         }
+        IsFinishSent = true;
+        return;
     }
-    else
+
+    if (IsAsyncSendFailed)
     {
-        FileTransferChunkInfo &chunkinfo = untrans_chunks[0];
-        uint64_t size = chunkinfo.range_right - chunkinfo.range_left + 1;
+        OccurError(session);
+        return;
+    }
 
-        uint64_t nextchunksize = std::min(suggest_chunksize, size);
+    // 接收方读取过慢，连接发送队列超过高水位时暂停，降到低水位后经_callbackResume继续
+    if (!OUTBOUNDLIMITER->WaitWritable(session, this, _callbackResume))
+        return;
 
-        FileTransferChunkData chunkdata;
-        chunkdata.range_left = chunkinfo.range_left;
-        chunkdata.range_right = chunkinfo.range_left + nextchunksize - 1;
+    ReleaseAckedChunks();
+    if (!RetransmitExpiredChunks(session))
+    {
+        OccurError(session);
+        return;
+    }
 
-        file_io.Seek(FileIOHandler::SeekOrigin::BEGIN, chunkdata.range_left);
-        file_io.Read(chunkdata.buf, nextchunksize);
+    // 已确认与在途的区间都不再发送，从剩余区间中填满窗口
+    vector<FileTransferChunkInfo> occupied = chunk_map;
+    send_window.AppendInflight(occupied);
+    vector<FileTransferChunkInfo> unsent_chunks = getUntransferredChunks(occupied, file_size);
+    if (relay_source && !FilterRelayChunks(unsent_chunks))
+    {
+        OccurError(session);
+        return;
+    }
+    if (!unsent_chunks.empty() && !OpenRelayFile())
+    {
+        OccurError(session);
+        return;
+    }
 
-        json js_data;
-        js_data["command"] = 7001;
-        js_data["taskid"] = task_id;
-        js_data["chunk_size"] = nextchunksize;
-        json js_range = json::array();
-        js_range.emplace_back(chunkdata.range_left);
-        js_range.emplace_back(chunkdata.range_right);
-        js_data["range"] = js_range;
+    int64_t now = GetTimestampMilliseconds();
+    uint64_t chunksize = chunk_policy ? chunk_policy->ChunkSize() : suggest_chunksize;
+    bool throttled = false; // 发送带宽不足，等待调度器回调ResumeTrans
+    for (auto &chunkinfo : unsent_chunks)
+    {
+        uint64_t left = chunkinfo.range_left;
+        while (left <= chunkinfo.range_right && !send_window.IsFull())
+        {
+            uint64_t nextchunksize = std::min(chunksize, chunkinfo.range_right - left + 1);
+            uint64_t right = left + nextchunksize - 1;
 
-        // js_data["data"] = json::binary(chunkdata.ToBinary());
+            if (!TRANSFERSCHEDULER->Acquire(task_id, nextchunksize))
+            {
+                throttled = true;
+                break;
+            }
 
-        if (!NetWorkHelper::SendMessagePackage(session, &js_data, &chunkdata.buf))
+            BaseNetWorkSession *stripe = NextStripeSession(session);
+            if (!SendChunkData(stripe, left, right))
+            {
+                OccurError(session);
+                return;
+            }
+            send_window.Add(left, right, now, stripe);
+            left = right + 1;
+        }
+        if (throttled || send_window.IsFull())
+            break;
+    }
+
+    // 重传与新分片的读取一次性提交
+    file_io.SubmitAsync();
+    ArmRetransmitTimer();
+}
+
+// 只保留上传者已送达的部分，剩余区间等接收任务有新进度后由ResumeTrans继续发送
+bool FileTransferUploadTask::FilterRelayChunks(vector<FileTransferChunkInfo> &chunks)
+{
+    vector<FileTransferChunkInfo> available;
+    bool completed = false;
+    bool failed = false;
+    relay_source->Snapshot(available, completed, failed);
+    if (failed)
+        return false;
+    if (completed)
+    {
+        relay_source = nullptr;
+        return true;
+    }
+
+    vector<FileTransferChunkInfo> result;
+    for (auto &chunk : chunks)
+    {
+        for (auto &avail : available)
         {
-            OccurError(session);
-            return;
+            uint64_t left = std::max(chunk.range_left, avail.range_left);
+            uint64_t right = std::min(chunk.range_right, avail.range_right);
+            if (left <= right)
+                result.emplace_back(0, left, right);
         }
     }
+    chunks.swap(result);
+    return true;
+}
+
+// 转发任务创建时文件可能尚未被接收任务创建，等第一次有已落盘的区间可发送时再打开
+bool FileTransferUploadTask::OpenRelayFile()
+{
+    if (!IsFileEnable)
+        IsFileEnable = file_io.Open(file_path, FileIOHandler::OpenMode::READ_ONLY);
+    return IsFileEnable;
+}
+
+void FileTransferUploadTask::SetRelaySource(std::shared_ptr<FileRelaySource> source, uint64_t filesize)
+{
+    relay_source = source;
+    file_size = filesize;
+    suggest_chunksize = GetSuggestChunsize(file_size);
+}
+
+void FileTransferUploadTask::ResumeTrans(BaseNetWorkSession *session)
+{
+    LockGuard guard(InterruptedLock);
+    if (IsClosed || IsFinished || IsError || IsInterrupted || !chunk_policy)
+        return;
+    SendNextChunkData(session);
 }
 
 void FileTransferUploadTask::SendErrorInfo(BaseNetWorkSession *session)
@@ -355,7 +674,8 @@ void FileTransferUploadTask::OnProgress(uint32_t progress)
 
 bool FileTransferUploadTask::StartSendFile(BaseNetWorkSession *session)
 {
-    bool result = IsFileEnable;
+    // 转发任务不在此打开文件，文件大小与MD5取自上传者登记的信息
+    bool result = relay_source ? true : ParseFile();
     if (result)
         SendTransReq(session);
     else
@@ -379,7 +699,12 @@ void FileTransferUploadTask::ProcessMsg(BaseNetWorkSession *session, const json
         if (command != 8000 && command != 8001 && command != 8010 && command != 7080 && command != 7070)
             return;
 
-        InterruptedLock.Enter();
+        // 分条传输时消息可能来自多个会话线程，整个处理过程须串行，提前返回时也要释放锁
+        LockGuard guard(InterruptedLock);
+
+        // 发起会话关闭后任务已移除，附加会话上仍在处理的消息直接忽略
+        if (IsClosed)
+            return;
 
         if (IsFinished)
         {
@@ -408,7 +733,7 @@ void FileTransferUploadTask::ProcessMsg(BaseNetWorkSession *session, const json
         }
         if (command == 8000)
         {
-            AckTransReqResult(session, js);
+            AckTransReqResult(session, js, buf);
         }
         if (command == 8001)
         {
@@ -422,8 +747,6 @@ void FileTransferUploadTask::ProcessMsg(BaseNetWorkSession *session, const json
         {
             RecvPeerInterrupt(js);
         }
-
-        InterruptedLock.Leave();
     }
 }
 
@@ -446,3 +769,13 @@ void FileTransferUploadTask::BindProgressCallBack(std::function<void(FileTransfe
 {
     _callbackProgress = callback;
 }
+
+void FileTransferUploadTask::BindResumeCallBack(std::function<void()> callback)
+{
+    _callbackResume = callback;
+}
+
+void FileTransferUploadTask::BindRetransmitCallBack(std::function<void()> callback)
+{
+    _callbackRetransmit = callback;
+}
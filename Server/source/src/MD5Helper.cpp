@@ -110,6 +110,138 @@ namespace MD5Calculate
         *d += D;
     }
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MD5_MULTILANE_ENABLE 1
+
+    typedef unsigned int md5v4 __attribute__((vector_size(16)));
+    typedef unsigned int md5v8 __attribute__((vector_size(32)));
+
+    // 与processBlock相同的64步运算，每个向量元素对应一路Context
+    // 强制内联到带target属性的调用方，由调用方决定生成SSE2还是AVX2指令
+    template <typename V, int N>
+    static inline __attribute__((always_inline)) void processBlockLanes(const MD5LaneBlock *lanes, int lanecount)
+    {
+        static const unsigned char zeroblock[MD5_BLOCK_SIZE] = {0};
+        static const unsigned int zerostatus[4] = {0};
+
+        V a, b, c, d;
+        V m[16];
+        for (int j = 0; j < N; j++)
+        {
+            // 不足N路时空闲的路计算全零分组，结果丢弃
+            const unsigned int *status = j < lanecount ? lanes[j].status : zerostatus;
+            const unsigned char *block = j < lanecount ? lanes[j].block : zeroblock;
+            a[j] = status[0];
+            b[j] = status[1];
+            c[j] = status[2];
+            d[j] = status[3];
+            for (int i = 0; i < 16; i++)
+            {
+                unsigned int word;
+                memcpy(&word, block + i * 4, sizeof(word));
+                m[i][j] = word;
+            }
+        }
+
+        V A = a;
+        V B = b;
+        V C = c;
+        V D = d;
+
+#define MD5_VSTEP(f, a, b, c, d, x, t, s)               \
+    {                                                   \
+        V value = a + f(b, c, d) + x + (unsigned int)t; \
+        a = b + ((value << s) | (value >> (32 - s)));   \
+    }
+
+        unsigned int count = 0;
+        unsigned int ptr = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            MD5_VSTEP(MD5_F, a, b, c, d, m[ptr++], T[count++], 7);
+            MD5_VSTEP(MD5_F, d, a, b, c, m[ptr++], T[count++], 12);
+            MD5_VSTEP(MD5_F, c, d, a, b, m[ptr++], T[count++], 17);
+            MD5_VSTEP(MD5_F, b, c, d, a, m[ptr++], T[count++], 22);
+        }
+
+        ptr = 12;
+        for (int i = 0; i < 4; i++)
+        {
+            ptr = (ptr + 5) % 16;
+            MD5_VSTEP(MD5_G, a, b, c, d, m[ptr], T[count++], 5);
+            ptr = (ptr + 5) % 16;
+            MD5_VSTEP(MD5_G, d, a, b, c, m[ptr], T[count++], 9);
+            ptr = (ptr + 5) % 16;
+            MD5_VSTEP(MD5_G, c, d, a, b, m[ptr], T[count++], 14);
+            ptr = (ptr + 5) % 16;
+            MD5_VSTEP(MD5_G, b, c, d, a, m[ptr], T[count++], 20);
+        }
+
+        ptr = 2;
+        for (int i = 0; i < 4; i++)
+        {
+            ptr = (ptr + 3) % 16;
+            MD5_VSTEP(MD5_H, a, b, c, d, m[ptr], T[count++], 4);
+            ptr = (ptr + 3) % 16;
+            MD5_VSTEP(MD5_H, d, a, b, c, m[ptr], T[count++], 11);
+            ptr = (ptr + 3) % 16;
+            MD5_VSTEP(MD5_H, c, d, a, b, m[ptr], T[count++], 16);
+            ptr = (ptr + 3) % 16;
+            MD5_VSTEP(MD5_H, b, c, d, a, m[ptr], T[count++], 23);
+        }
+
+        ptr = 9;
+        for (int i = 0; i < 4; i++)
+        {
+            ptr = (ptr + 7) % 16;
+            MD5_VSTEP(MD5_I, a, b, c, d, m[ptr], T[count++], 6);
+            ptr = (ptr + 7) % 16;
+            MD5_VSTEP(MD5_I, d, a, b, c, m[ptr], T[count++], 10);
+            ptr = (ptr + 7) % 16;
+            MD5_VSTEP(MD5_I, c, d, a, b, m[ptr], T[count++], 15);
+            ptr = (ptr + 7) % 16;
+            MD5_VSTEP(MD5_I, b, c, d, a, m[ptr], T[count++], 21);
+        }
+
+#undef MD5_VSTEP
+
+        a += A;
+        b += B;
+        c += C;
+        d += D;
+
+        for (int j = 0; j < lanecount; j++)
+        {
+            lanes[j].status[0] = a[j];
+            lanes[j].status[1] = b[j];
+            lanes[j].status[2] = c[j];
+            lanes[j].status[3] = d[j];
+        }
+    }
+
+    __attribute__((target("sse2"))) static void processBlockLanesSSE2(const MD5LaneBlock *lanes, int lanecount)
+    {
+        processBlockLanes<md5v4, 4>(lanes, lanecount);
+    }
+
+    __attribute__((target("avx2"))) static void processBlockLanesAVX2(const MD5LaneBlock *lanes, int lanecount)
+    {
+        processBlockLanes<md5v8, 8>(lanes, lanecount);
+    }
+#endif
+
+    static int detectLaneWidth()
+    {
+#ifdef MD5_MULTILANE_ENABLE
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return 8;
+        if (__builtin_cpu_supports("sse2"))
+            return 4;
+#endif
+        return 1;
+    }
+
     // 计算MD5
     void computeMD5(const unsigned char *message, unsigned long long messageLength, unsigned char *hash)
     {
@@ -314,3 +446,25 @@ std::string MD5Helper::MD5Ctx_Final(std::shared_ptr<MD5Context> ctx)
     return MD5Calculate::toHexString(reinterpret_cast<unsigned char *>(ctx->status));
 }
 
+
+int MD5Helper::MD5LaneWidth()
+{
+    static const int width = MD5Calculate::detectLaneWidth();
+    return width;
+}
+
+void MD5Helper::MD5ProcessLanes(const MD5LaneBlock *lanes, int count)
+{
+    int width = MD5LaneWidth();
+    if (count <= 0 || count > width)
+        return;
+
+#ifdef MD5_MULTILANE_ENABLE
+    if (width == 8)
+        return MD5Calculate::processBlockLanesAVX2(lanes, count);
+    if (width == 4)
+        return MD5Calculate::processBlockLanesSSE2(lanes, count);
+#endif
+    for (int i = 0; i < count; i++)
+        MD5Calculate::processBlock(&lanes[i].status[0], &lanes[i].status[1], &lanes[i].status[2], &lanes[i].status[3], lanes[i].block);
+}
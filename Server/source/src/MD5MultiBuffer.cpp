@@ -0,0 +1,171 @@
+#include "MD5MultiBuffer.h"
+#include <cstring>
+#include <algorithm>
+
+constexpr uint64_t md5blocksize = 64;
+constexpr uint64_t md5batchblocks = 1024; // 每批最多推进的分组数，之后检查是否有新请求可以换入空闲的路
+constexpr unsigned maxmd5workers = 4;
+
+MD5MultiBuffer *MD5MultiBuffer::Instance()
+{
+    static MD5MultiBuffer *instance = new MD5MultiBuffer();
+    return instance;
+}
+
+MD5MultiBuffer::MD5MultiBuffer()
+    : _stop(false)
+{
+    unsigned workers = std::clamp(std::thread::hardware_concurrency() / 2, 1u, maxmd5workers);
+    for (unsigned i = 0; i < workers; i++)
+        _workers.emplace_back(&MD5MultiBuffer::WorkLoop, this);
+}
+
+MD5MultiBuffer::~MD5MultiBuffer()
+{
+    {
+        LockGuard guard(_lock);
+        _stop = true;
+    }
+    _cv.NotifyAll();
+    for (auto &worker : _workers)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+}
+
+void MD5MultiBuffer::Submit(std::shared_ptr<MD5Context> ctx, std::shared_ptr<Buffer> data,
+                            CriticalSectionLock *ctxlock, std::function<void()> callback)
+{
+    {
+        LockGuard guard(_lock);
+        _jobs.emplace_back(Job{ctx, data, ctxlock, callback});
+    }
+    _cv.NotifyOne();
+}
+
+const unsigned char *MD5MultiBuffer::Lane::NextBlock() const
+{
+    if (hashead && processed == 0)
+        return head;
+    uint64_t index = hashead ? processed - 1 : processed;
+    return reinterpret_cast<const unsigned char *>(job.data->Byte()) + dataoffset + index * md5blocksize;
+}
+
+bool MD5MultiBuffer::TakeJob(Job &job, bool wait)
+{
+    LockGuard guard(_lock);
+    while (wait && _jobs.empty() && !_stop)
+        _cv.Wait(guard);
+    if (_jobs.empty())
+        return false;
+
+    job = std::move(_jobs.front());
+    _jobs.pop_front();
+    return true;
+}
+
+bool MD5MultiBuffer::LoadLane(Lane &lane, Job &job)
+{
+    job.ctxlock->Enter();
+
+    Buffer &cache = job.ctx->cacheBuffer;
+    uint64_t cachesize = cache.Length();
+    uint64_t datasize = job.data->Length();
+    if (cachesize + datasize < md5blocksize)
+    {
+        cache.Seek(cachesize);
+        cache.Write(job.data->Byte(), datasize);
+        cache.Seek(0);
+        job.ctxlock->Leave();
+        if (job.callback)
+            job.callback();
+        return false;
+    }
+
+    lane.job = std::move(job);
+    lane.hashead = cachesize > 0;
+    if (lane.hashead)
+    {
+        memcpy(lane.head, cache.Byte(), cachesize);
+        memcpy(lane.head + cachesize, lane.job.data->Byte(), md5blocksize - cachesize);
+        lane.dataoffset = md5blocksize - cachesize;
+    }
+    lane.blocks = (lane.hashead ? 1 : 0) + (datasize - lane.dataoffset) / md5blocksize;
+    return true;
+}
+
+// 不足一个分组的尾部留在缓存中，与MD5Ctx_Update的结果一致
+void MD5MultiBuffer::FinishLane(Lane &lane)
+{
+    MD5Context &ctx = *lane.job.ctx;
+    uint64_t consumed = lane.dataoffset + (lane.blocks - (lane.hashead ? 1 : 0)) * md5blocksize;
+
+    Buffer tail;
+    tail.Write(lane.job.data->Byte() + consumed, lane.job.data->Length() - consumed);
+    tail.Seek(0);
+    ctx.cacheBuffer = tail;
+    ctx.count += lane.blocks * md5blocksize;
+
+    lane.job.ctxlock->Leave();
+    if (lane.job.callback)
+        lane.job.callback();
+    lane.job = Job();
+}
+
+void MD5MultiBuffer::WorkLoop()
+{
+    int width = MD5Helper::MD5LaneWidth();
+    std::vector<Lane> lanes;
+    lanes.reserve(width);
+    MD5LaneBlock laneblocks[8];
+
+    while (true)
+    {
+        // 补满空闲的路，只有没有进行中的路时才阻塞等待
+        while ((int)lanes.size() < width)
+        {
+            Job job;
+            if (!TakeJob(job, lanes.empty()))
+                break;
+            Lane lane;
+            if (LoadLane(lane, job))
+                lanes.emplace_back(std::move(lane));
+        }
+
+        if (lanes.empty())
+        {
+            LockGuard guard(_lock);
+            if (_stop)
+                return;
+            continue;
+        }
+
+        uint64_t steps = md5batchblocks;
+        for (auto &lane : lanes)
+            steps = std::min(steps, lane.blocks - lane.processed);
+
+        int count = lanes.size();
+        for (uint64_t step = 0; step < steps; step++)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                laneblocks[i].status = lanes[i].job.ctx->status;
+                laneblocks[i].block = lanes[i].NextBlock();
+                lanes[i].processed++;
+            }
+            MD5Helper::MD5ProcessLanes(laneblocks, count);
+        }
+
+        for (auto it = lanes.begin(); it != lanes.end();)
+        {
+            if (it->processed == it->blocks)
+            {
+                FinishLane(*it);
+                it = lanes.erase(it);
+            }
+            else
+                ++it;
+        }
+    }
+}
@@ -112,3 +112,18 @@ void GenerateMessagePackageToBuffer(MessagePackage *package, Buffer *buf)
     buf->WriteFromOtherBufferPos(package->jsondata);
     buf->WriteFromOtherBufferPos(package->bufferdata);
 }
+
+uint64_t GenerateMessagePackageHeaderToBuffer(json &nlmjson, uint64_t bufferlen, Buffer *buf)
+{
+    std::string jsonstr = nlmjson.dump();
+    uint32_t jsonlen = jsonstr.size();
+
+    buf->ReSize(sizeof(jsonlen) + sizeof(bufferlen) + jsonlen + bufferlen);
+    buf->Seek(0);
+
+    buf->Write(&jsonlen, sizeof(jsonlen));
+    buf->Write(&bufferlen, sizeof(bufferlen));
+    buf->Write(jsonstr.data(), jsonlen);
+
+    return buf->Position();
+}
@@ -15,24 +15,29 @@ int64_t GetTimeStampSecond()
 
 bool MsgManager::ProcessMsg(BaseNetWorkSession *session, Buffer *buf)
 {
-    MessagePackage package;
-    if (!AnalysisMessagePackageFromBuffer(buf, &package))
+    std::shared_ptr<MessagePackage> package = std::make_shared<MessagePackage>();
+    if (!AnalysisMessagePackageFromBuffer(buf, package.get()))
         return false;
 
-    if (!package.jsonenable)
+    if (!package->jsonenable)
         return false;
 
-    json &js_src = package.nlmjson;
-    Buffer &buf_src = package.bufferdata;
+    json &js_src = package->nlmjson;
+    Buffer &buf_src = package->bufferdata;
 
     if (!js_src.contains("command"))
         return false;
     int command = js_src.at("command");
 
-    if (command == 7000 || command == 7001 || command == 7010 || command == 7080 || command == 7070 ||
-        command == 8000 || command == 8001 || command == 8010 || command == 4001)
+    // 文件传输的校验与读写较重，交给处理线程，网络线程只负责解包；聊天与登录消息仍在网络线程处理
+    if (IsFileTransCommand(command))
     {
-        FILETRANSMANAGER->ProcessMsg(session, js_src, buf_src);
+        if (HandleLoops)
+            HandleLoops->Post(session, [session, package]()
+                              { FILETRANSMANAGER->ProcessMsg(session, package->nlmjson, package->bufferdata); });
+        else
+            FILETRANSMANAGER->ProcessMsg(session, js_src, buf_src);
+        return true;
     }
 
     if (!js_src.contains("jwt"))
@@ -163,7 +168,8 @@ bool MsgManager::BroadCastPublicChatMsg(const string &token, json &js_src, Buffe
             if(HandleLoginUser->IsPublicChat(user->token))
                 continue;
 
-            NetWorkHelper::SendMessagePackage(user->session, &js,&buf);
+            // 公共频道广播可丢弃，不因个别接收过慢的客户端堆积
+            NetWorkHelper::SendMessagePackage(user->session, &js, &buf, SendPriority::DROPPABLE);
         } });
 
     return true;
@@ -340,4 +346,29 @@ bool MsgManager::ProcessFetchRecord(BaseNetWorkSession *session, const string &t
 void MsgManager::SetLoginUserManager(LoginUserManager *m)
 {
     HandleLoginUser = m;
-}
\ No newline at end of file
+}
+void MsgManager::SetSessionLoopGroup(SessionLoopGroup *g)
+{
+    HandleLoops = g;
+}
+
+bool MsgManager::IsFileTransCommand(int command)
+{
+    switch (command)
+    {
+    case 4001:
+    case 4002:
+    case 4003:
+    case 7000:
+    case 7001:
+    case 7010:
+    case 7070:
+    case 7080:
+    case 8000:
+    case 8001:
+    case 8010:
+        return true;
+    default:
+        return false;
+    }
+}
@@ -1,26 +1,26 @@
 #include "NetWorkHelper.h"
 
-bool NetWorkHelper::SendMessagePackage(BaseNetWorkSession *session, json *json)
+bool NetWorkHelper::SendMessagePackage(BaseNetWorkSession *session, json *json, SendPriority priority)
 {
     MessagePackage package(*json);
-    return NetWorkHelper::SendMessagePackage(session, &package);
+    return NetWorkHelper::SendMessagePackage(session, &package, priority);
 }
 
-bool NetWorkHelper::SendMessagePackage(BaseNetWorkSession *session, Buffer *buf)
+bool NetWorkHelper::SendMessagePackage(BaseNetWorkSession *session, Buffer *buf, SendPriority priority)
 {
     MessagePackage package(*buf);
-    return NetWorkHelper::SendMessagePackage(session, &package);
+    return NetWorkHelper::SendMessagePackage(session, &package, priority);
 }
 
-bool NetWorkHelper::SendMessagePackage(BaseNetWorkSession *session, json *json, Buffer *buf)
+bool NetWorkHelper::SendMessagePackage(BaseNetWorkSession *session, json *json, Buffer *buf, SendPriority priority)
 {
     MessagePackage package(*json, *buf);
-    return NetWorkHelper::SendMessagePackage(session, &package);
+    return NetWorkHelper::SendMessagePackage(session, &package, priority);
 }
 
-bool NetWorkHelper::SendMessagePackage(BaseNetWorkSession *session, MessagePackage *package)
+bool NetWorkHelper::SendMessagePackage(BaseNetWorkSession *session, MessagePackage *package, SendPriority priority)
 {
     Buffer buf;
     GenerateMessagePackageToBuffer(package, &buf);
-    return session->AsyncSend(buf);
+    return OUTBOUNDLIMITER->Send(session, buf, priority);
 }
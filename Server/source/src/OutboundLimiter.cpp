@@ -0,0 +1,172 @@
+#include "OutboundLimiter.h"
+#include <sys/socket.h>
+
+constexpr int64_t pollintervalms = 50;
+
+static int64_t GetTimestampMilliseconds()
+{
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+}
+
+OutboundLimiter *OutboundLimiter::Instance()
+{
+    static OutboundLimiter *instance = new OutboundLimiter();
+    return instance;
+}
+
+OutboundLimiter::OutboundLimiter()
+{
+    PollTimer = TIMINGWHEEL->Schedule(pollintervalms,
+                                      std::bind(&OutboundLimiter::Poll, this),
+                                      pollintervalms);
+}
+
+OutboundLimiter::~OutboundLimiter()
+{
+    TIMINGWHEEL->Cancel(PollTimer);
+}
+
+void OutboundLimiter::SetLimits(const OutboundLimits &limits)
+{
+    LockGuard guard(_lock);
+    _limits = limits;
+    _limits.lowwatermark = std::min(_limits.lowwatermark, _limits.highwatermark);
+}
+
+bool OutboundLimiter::Send(BaseNetWorkSession *session, const Buffer &buf, SendPriority priority)
+{
+    if (!session)
+        return false;
+
+    // 持锁入队：记录的帧顺序须与连接发送队列一致，Refresh才能按剩余帧数对应到最近发出的帧
+    LockGuard guard(_lock);
+    OutboundSession &state = _sessions[session];
+    Refresh(session, state);
+
+    if (state.congested && priority == SendPriority::DROPPABLE && _limits.dropdroppable)
+    {
+        state.droppedframes++;
+        return false;
+    }
+
+    if (!session->AsyncSend(buf))
+        return false;
+
+    state.frames.push_back(buf.Length());
+    state.queuedbytes += buf.Length();
+    if (!state.congested && state.queuedbytes > _limits.highwatermark)
+    {
+        state.congested = true;
+        state.congestedsince = GetTimestampMilliseconds();
+    }
+    return true;
+}
+
+bool OutboundLimiter::WaitWritable(BaseNetWorkSession *session, const void *waiter, std::function<void()> resume)
+{
+    LockGuard guard(_lock);
+    auto it = _sessions.find(session);
+    if (it == _sessions.end())
+        return true;
+
+    OutboundSession &state = it->second;
+    Refresh(session, state);
+    if (!state.congested || !_limits.pausetransfers)
+        return true;
+
+    if (resume)
+        state.resumes[waiter] = resume;
+    return false;
+}
+
+bool OutboundLimiter::IsCongested(BaseNetWorkSession *session)
+{
+    LockGuard guard(_lock);
+    auto it = _sessions.find(session);
+    return it != _sessions.end() && it->second.congested;
+}
+
+uint64_t OutboundLimiter::QueuedBytes(BaseNetWorkSession *session)
+{
+    LockGuard guard(_lock);
+    auto it = _sessions.find(session);
+    if (it == _sessions.end())
+        return 0;
+    Refresh(session, it->second);
+    return it->second.queuedbytes;
+}
+
+void OutboundLimiter::RemoveSession(BaseNetWorkSession *session)
+{
+    LockGuard guard(_lock);
+    _sessions.erase(session);
+}
+
+uint64_t OutboundLimiter::PendingFrames(BaseNetWorkSession *session)
+{
+    TCPEndPoint *client = session->GetBaseClient();
+    if (!client)
+        return 0;
+    std::shared_ptr<TCPTransportConnection> con = client->GetBaseCon();
+    if (!con)
+        return 0;
+    return con->GetSendData().size();
+}
+
+// 只关闭套接字，由连接的正常关闭流程回收会话与其上的任务
+void OutboundLimiter::Disconnect(BaseNetWorkSession *session)
+{
+    TCPEndPoint *client = session->GetBaseClient();
+    std::shared_ptr<TCPTransportConnection> con = client ? client->GetBaseCon() : nullptr;
+    if (!con)
+        return;
+
+    std::cout << fmt::format("Slow consumer disconnected: RemoteIpAddr={}:{}\n",
+                             session->GetIPAddr(), session->GetPort());
+    shutdown(con->GetSocket(), SHUT_RDWR);
+}
+
+void OutboundLimiter::Refresh(BaseNetWorkSession *session, OutboundSession &state)
+{
+    uint64_t pending = PendingFrames(session);
+    while (state.frames.size() > pending)
+    {
+        state.queuedbytes -= state.frames.front();
+        state.frames.pop_front();
+    }
+}
+
+void OutboundLimiter::Poll()
+{
+    std::vector<std::function<void()>> callbacks;
+    {
+        LockGuard guard(_lock);
+        int64_t now = GetTimestampMilliseconds();
+        for (auto &pair : _sessions)
+        {
+            OutboundSession &state = pair.second;
+            if (!state.congested)
+                continue;
+
+            Refresh(pair.first, state);
+            if (state.queuedbytes <= _limits.lowwatermark)
+            {
+                state.congested = false;
+                for (auto &resume : state.resumes)
+                    callbacks.emplace_back(std::move(resume.second));
+                state.resumes.clear();
+            }
+            else if (_limits.disconnectms > 0 && !state.disconnecting &&
+                     now - state.congestedsince >= _limits.disconnectms)
+            {
+                // 持锁关闭，会话关闭时RemoveSession先于回收，此时会话仍然有效
+                state.disconnecting = true;
+                Disconnect(pair.first);
+            }
+        }
+    }
+
+    for (auto &callback : callbacks)
+        callback();
+}
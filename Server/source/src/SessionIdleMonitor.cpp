@@ -0,0 +1,144 @@
+#include "SessionIdleMonitor.h"
+#include "OutboundLimiter.h"
+#include "FileTransManager.h"
+#include <sys/socket.h>
+
+const char HeartBuffer[] = "23388990"; // 与客户端一致，不经过消息封装
+
+static int64_t GetTimestampMilliseconds()
+{
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+}
+
+SessionIdleMonitor::SessionIdleMonitor()
+    : _serial(0)
+{
+}
+
+SessionIdleMonitor::~SessionIdleMonitor()
+{
+    LockGuard guard(_lock);
+    for (auto &pair : _sessions)
+        TIMINGWHEEL->Cancel(pair.second.timer);
+    _sessions.clear();
+}
+
+void SessionIdleMonitor::SetPolicy(const IdlePolicy &policy)
+{
+    LockGuard guard(_lock);
+    _policy = policy;
+}
+
+void SessionIdleMonitor::AddSession(BaseNetWorkSession *session)
+{
+    LockGuard guard(_lock);
+    if (_policy.heartbeatms <= 0 && _policy.timeoutms <= 0)
+        return;
+
+    IdleSession &state = _sessions[session];
+    TIMINGWHEEL->Cancel(state.timer);
+    state.serial = ++_serial;
+    state.lastactive = GetTimestampMilliseconds();
+    state.lastheartbeat = 0;
+
+    int64_t delay = _policy.timeoutms;
+    if (_policy.heartbeatms > 0 && (delay <= 0 || _policy.heartbeatms < delay))
+        delay = _policy.heartbeatms;
+    Schedule(session, state, delay);
+}
+
+void SessionIdleMonitor::RemoveSession(BaseNetWorkSession *session)
+{
+    LockGuard guard(_lock);
+    auto it = _sessions.find(session);
+    if (it == _sessions.end())
+        return;
+    TIMINGWHEEL->Cancel(it->second.timer);
+    _sessions.erase(it);
+}
+
+void SessionIdleMonitor::Touch(BaseNetWorkSession *session)
+{
+    LockGuard guard(_lock);
+    auto it = _sessions.find(session);
+    if (it != _sessions.end())
+        it->second.lastactive = GetTimestampMilliseconds();
+}
+
+IdleStats SessionIdleMonitor::GetStats()
+{
+    LockGuard guard(_lock);
+    return _stats;
+}
+
+bool SessionIdleMonitor::IsHeartBeat(const Buffer &buf)
+{
+    static uint64_t HeartSize = sizeof(HeartBuffer) - 1;
+    return buf.Length() == HeartSize && 0 == strncmp(HeartBuffer, buf.Byte(), HeartSize);
+}
+
+void SessionIdleMonitor::Schedule(BaseNetWorkSession *session, IdleSession &state, int64_t delayms)
+{
+    uint64_t serial = state.serial;
+    state.timer = TIMINGWHEEL->Schedule(std::max<int64_t>(delayms, 0),
+                                        [this, session, serial]()
+                                        { OnTimer(session, serial); });
+}
+
+void SessionIdleMonitor::OnTimer(BaseNetWorkSession *session, uint64_t serial)
+{
+    // 持锁处理，会话关闭时RemoveSession先于回收，此时会话仍然有效
+    LockGuard guard(_lock);
+    auto it = _sessions.find(session);
+    if (it == _sessions.end() || it->second.serial != serial)
+        return;
+
+    IdleSession &state = it->second;
+    int64_t now = GetTimestampMilliseconds();
+    int64_t idle = now - state.lastactive;
+
+    if (_policy.timeoutms > 0 && idle >= _policy.timeoutms)
+    {
+        Reclaim(session, idle);
+        state.timer = 0; // 等连接关闭流程调用RemoveSession
+        return;
+    }
+
+    int64_t next = _policy.timeoutms > 0 ? state.lastactive + _policy.timeoutms : INT64_MAX;
+    if (_policy.heartbeatms > 0)
+    {
+        // 心跳按静默时长计：对端回应后从回应时刻重新计时，未回应则每隔heartbeatms再发一次
+        int64_t due = std::max(state.lastactive, state.lastheartbeat) + _policy.heartbeatms;
+        if (now >= due)
+        {
+            Buffer heartbeat(HeartBuffer, sizeof(HeartBuffer) - 1);
+            OUTBOUNDLIMITER->Send(session, heartbeat);
+            state.lastheartbeat = now;
+            _stats.heartbeats++;
+            due = now + _policy.heartbeatms;
+        }
+        next = std::min(next, due);
+    }
+    Schedule(session, state, next - now);
+}
+
+// 只关闭套接字，由连接的正常关闭流程回收用户、发送队列与传输任务
+void SessionIdleMonitor::Reclaim(BaseNetWorkSession *session, int64_t idlems)
+{
+    TCPEndPoint *client = session->GetBaseClient();
+    std::shared_ptr<TCPTransportConnection> con = client ? client->GetBaseCon() : nullptr;
+    if (!con)
+        return;
+
+    uint64_t bytes = OUTBOUNDLIMITER->QueuedBytes(session);
+    uint64_t tasks = FILETRANSMANAGER->SessionTaskCount(session);
+    _stats.reclaimedsessions++;
+    _stats.reclaimedbytes += bytes;
+    _stats.reclaimedtasks += tasks;
+
+    std::cout << fmt::format("Idle session reclaimed: RemoteIpAddr={}:{} idle={}ms queuedbytes={} tasks={}, total sessions={} bytes={} tasks={}\n",
+                             session->GetIPAddr(), session->GetPort(), idlems, bytes, tasks,
+                             _stats.reclaimedsessions, _stats.reclaimedbytes, _stats.reclaimedtasks);
+    shutdown(con->GetSocket(), SHUT_RDWR);
+}
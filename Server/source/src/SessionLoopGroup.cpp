@@ -0,0 +1,177 @@
+#include "SessionLoopGroup.h"
+#include <future>
+
+SessionLoopGroup::SessionLoopGroup()
+{
+}
+
+SessionLoopGroup::~SessionLoopGroup()
+{
+    Stop();
+}
+
+void SessionLoopGroup::Start(unsigned count)
+{
+    if (count == 0)
+        count = std::max(std::thread::hardware_concurrency(), 1u);
+
+    LockGuard guard(_lock);
+    if (!_loops.empty())
+        return;
+    for (unsigned i = 0; i < count; i++)
+    {
+        std::unique_ptr<Loop> loop = std::make_unique<Loop>();
+        loop->thread = std::thread(&SessionLoopGroup::LoopRun, this, loop.get());
+        _loops.emplace_back(std::move(loop));
+    }
+}
+
+void SessionLoopGroup::Stop()
+{
+    std::vector<std::unique_ptr<Loop>> loops;
+    {
+        LockGuard guard(_lock);
+        loops.swap(_loops);
+        _pinned.clear();
+    }
+    for (auto &loop : loops)
+    {
+        {
+            LockGuard guard(loop->lock);
+            loop->stop = true;
+        }
+        loop->cv.NotifyAll();
+    }
+    for (auto &loop : loops)
+    {
+        if (loop->thread.joinable())
+            loop->thread.join();
+    }
+}
+
+size_t SessionLoopGroup::LoopCount()
+{
+    LockGuard guard(_lock);
+    return _loops.size();
+}
+
+SessionLoopGroup::Loop *SessionLoopGroup::PinnedLoop(BaseNetWorkSession *session, bool create)
+{
+    LockGuard guard(_lock);
+    auto it = _pinned.find(session);
+    if (it != _pinned.end())
+        return it->second;
+    if (!create || _loops.empty())
+        return nullptr;
+
+    Loop *loop = std::min_element(_loops.begin(), _loops.end(),
+                                  [](const std::unique_ptr<Loop> &a, const std::unique_ptr<Loop> &b)
+                                  { return a->sessions < b->sessions; })
+                     ->get();
+    loop->sessions++;
+    _pinned[session] = loop;
+    return loop;
+}
+
+void SessionLoopGroup::Post(BaseNetWorkSession *session, std::function<void()> work)
+{
+    Loop *loop = PinnedLoop(session, true);
+    if (!loop)
+    {
+        work();
+        return;
+    }
+
+    {
+        LockGuard guard(loop->lock);
+        loop->works.emplace_back(LoopWork{session, std::move(work)});
+    }
+    loop->cv.NotifyOne();
+}
+
+bool SessionLoopGroup::PostPinned(BaseNetWorkSession *session, std::function<void()> work)
+{
+    {
+        // 持_lock入队：Release解除绑定后才排入等待标记，已入队的任务必然在等待标记之前执行
+        LockGuard guard(_lock);
+        if (!_loops.empty())
+        {
+            auto it = _pinned.find(session);
+            if (it == _pinned.end())
+                return false;
+            Loop *loop = it->second;
+            {
+                LockGuard loopguard(loop->lock);
+                loop->works.emplace_back(LoopWork{session, std::move(work)});
+            }
+            loop->cv.NotifyOne();
+            return true;
+        }
+    }
+
+    work();
+    return true;
+}
+
+void SessionLoopGroup::Release(BaseNetWorkSession *session)
+{
+    Loop *loop = nullptr;
+    {
+        LockGuard guard(_lock);
+        auto it = _pinned.find(session);
+        if (it == _pinned.end())
+            return;
+        loop = it->second;
+        loop->sessions--;
+        _pinned.erase(it);
+    }
+
+    // 在本会话的处理线程内关闭时，丢弃排在后面的消息即可；否则排队等待之前的消息处理完
+    if (loop->thread.get_id() == std::this_thread::get_id())
+    {
+        LockGuard guard(loop->lock);
+        auto removed = std::remove_if(loop->works.begin(), loop->works.end(),
+                                      [session](const LoopWork &work)
+                                      { return work.session == session; });
+        loop->works.erase(removed, loop->works.end());
+        return;
+    }
+
+    std::shared_ptr<std::promise<void>> drained = std::make_shared<std::promise<void>>();
+    std::future<void> done = drained->get_future();
+    {
+        LockGuard guard(loop->lock);
+        if (loop->stop)
+            return;
+        loop->works.emplace_back(LoopWork{session, [drained]()
+                                          { drained->set_value(); }});
+    }
+    loop->cv.NotifyOne();
+    done.wait();
+}
+
+void SessionLoopGroup::LoopRun(Loop *loop)
+{
+    while (true)
+    {
+        LoopWork work;
+        {
+            LockGuard guard(loop->lock);
+            while (loop->works.empty() && !loop->stop)
+                loop->cv.Wait(guard);
+            if (loop->works.empty())
+                return;
+            work = std::move(loop->works.front());
+            loop->works.pop_front();
+        }
+
+        try
+        {
+            work.work();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "SessionLoopGroup work error!" << e.what() << '\n';
+        }
+    }
+}
@@ -0,0 +1,294 @@
+#include "TimingWheel.h"
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <chrono>
+
+constexpr uint32_t rootbits = 8;
+constexpr uint32_t levelbits = 6;
+constexpr uint32_t levelcount = 4;
+constexpr uint32_t rootsize = 1u << rootbits;
+constexpr uint32_t levelsize = 1u << levelbits;
+constexpr uint64_t maxspan = 1ull << (rootbits + levelbits * (levelcount - 1));
+
+// 第level层(1~3)中expire对应的槽位
+static uint32_t LevelSlot(uint32_t level, uint64_t expire)
+{
+    uint32_t shift = rootbits + (level - 1) * levelbits;
+    return rootsize + (level - 1) * levelsize + ((expire >> shift) & (levelsize - 1));
+}
+
+TimingWheel *TimingWheel::Instance()
+{
+    static TimingWheel *instance = []()
+    {
+        TimingWheel *wheel = new TimingWheel();
+        wheel->Start();
+        return wheel;
+    }();
+    return instance;
+}
+
+TimingWheel::TimingWheel(uint64_t tickms)
+    : _current(0), _count(0), _tickms(std::max<uint64_t>(tickms, 1)), _fd(-1), _running(false)
+{
+    _slots.assign(rootsize + (levelcount - 1) * levelsize, NIL);
+}
+
+TimingWheel::~TimingWheel()
+{
+    Stop();
+}
+
+bool TimingWheel::Start()
+{
+    if (_running)
+        return true;
+
+    _fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (_fd < 0)
+        return false;
+
+    itimerspec spec{};
+    spec.it_interval.tv_sec = _tickms / 1000;
+    spec.it_interval.tv_nsec = (_tickms % 1000) * 1000000;
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(_fd, 0, &spec, nullptr) < 0)
+    {
+        close(_fd);
+        _fd = -1;
+        return false;
+    }
+
+    _running = true;
+    _thread = std::thread(&TimingWheel::Run, this);
+    return true;
+}
+
+// 驱动线程最多在一个tick内察觉停止
+void TimingWheel::Stop()
+{
+    if (!_running.exchange(false))
+        return;
+    if (_thread.joinable())
+        _thread.join();
+    close(_fd);
+    _fd = -1;
+}
+
+TimingWheel::TimerId TimingWheel::Schedule(uint64_t delayms, Callback callback, uint64_t intervalms)
+{
+    if (!callback)
+        return 0;
+
+    LockGuard guard(_lock);
+    uint32_t index = Allocate();
+    Node &node = _nodes[index];
+    node.callback = std::move(callback);
+    node.expire = _current + ToTicks(delayms);
+    node.interval = intervalms == 0 ? 0 : std::max<uint64_t>(ToTicks(intervalms), 1);
+    Link(index);
+    return ((uint64_t)node.generation << 32) | (index + 1);
+}
+
+bool TimingWheel::Cancel(TimerId id)
+{
+    LockGuard guard(_lock);
+    uint32_t index = Find(id);
+    if (index == NIL)
+        return false;
+    Unlink(index);
+    Free(index);
+    return true;
+}
+
+bool TimingWheel::Reschedule(TimerId id, uint64_t delayms)
+{
+    LockGuard guard(_lock);
+    uint32_t index = Find(id);
+    if (index == NIL)
+        return false;
+    Unlink(index);
+    _nodes[index].expire = _current + ToTicks(delayms);
+    Link(index);
+    return true;
+}
+
+void TimingWheel::Advance(uint64_t ticks)
+{
+    std::vector<Callback> expired;
+    for (uint64_t i = 0; i < ticks; i++)
+    {
+        {
+            LockGuard guard(_lock);
+            Tick(expired);
+        }
+        for (auto &callback : expired)
+            callback();
+        expired.clear();
+    }
+}
+
+uint64_t TimingWheel::TickMs() const
+{
+    return _tickms;
+}
+
+size_t TimingWheel::Size()
+{
+    LockGuard guard(_lock);
+    return _count;
+}
+
+TimingWheel::SleepAwaiter TimingWheel::Sleep(uint64_t delayms)
+{
+    return SleepAwaiter{this, delayms};
+}
+
+// 向上取整，保证不早于请求的时间触发
+uint64_t TimingWheel::ToTicks(uint64_t ms) const
+{
+    return (ms + _tickms - 1) / _tickms;
+}
+
+uint32_t TimingWheel::Find(TimerId id)
+{
+    uint64_t low = id & 0xFFFFFFFF;
+    if (low == 0 || low > _nodes.size())
+        return NIL;
+    uint32_t index = low - 1;
+    Node &node = _nodes[index];
+    if (node.generation != (id >> 32) || node.slot == NIL)
+        return NIL;
+    return index;
+}
+
+uint32_t TimingWheel::Allocate()
+{
+    _count++;
+    if (!_freelist.empty())
+    {
+        uint32_t index = _freelist.back();
+        _freelist.pop_back();
+        return index;
+    }
+    _nodes.emplace_back();
+    return _nodes.size() - 1;
+}
+
+void TimingWheel::Free(uint32_t index)
+{
+    Node &node = _nodes[index];
+    node.callback = nullptr;
+    node.generation++;
+    _freelist.emplace_back(index);
+    _count--;
+}
+
+void TimingWheel::Link(uint32_t index)
+{
+    Node &node = _nodes[index];
+    uint64_t expire = node.expire;
+    uint32_t slot;
+    if (expire < _current)
+        slot = _current & (rootsize - 1);
+    else
+    {
+        uint64_t span = expire - _current;
+        if (span < rootsize)
+            slot = expire & (rootsize - 1);
+        else if (span < (1ull << (rootbits + levelbits)))
+            slot = LevelSlot(1, expire);
+        else if (span < (1ull << (rootbits + levelbits * 2)))
+            slot = LevelSlot(2, expire);
+        else
+            slot = LevelSlot(3, span < maxspan ? expire : _current + maxspan - 1);
+    }
+
+    node.slot = slot;
+    node.prev = NIL;
+    node.next = _slots[slot];
+    if (node.next != NIL)
+        _nodes[node.next].prev = index;
+    _slots[slot] = index;
+}
+
+void TimingWheel::Unlink(uint32_t index)
+{
+    Node &node = _nodes[index];
+    if (node.prev != NIL)
+        _nodes[node.prev].next = node.next;
+    else
+        _slots[node.slot] = node.next;
+    if (node.next != NIL)
+        _nodes[node.next].prev = node.prev;
+    node.prev = node.next = node.slot = NIL;
+}
+
+void TimingWheel::Cascade(uint32_t slot)
+{
+    uint32_t index = _slots[slot];
+    _slots[slot] = NIL;
+    while (index != NIL)
+    {
+        uint32_t next = _nodes[index].next;
+        _nodes[index].slot = NIL;
+        Link(index);
+        index = next;
+    }
+}
+
+// 第0层转完一圈时，依次把上一层当前槽位的节点级联下来，某层未回绕则更高层无需处理
+void TimingWheel::Tick(std::vector<Callback> &expired)
+{
+    uint32_t root = _current & (rootsize - 1);
+    if (root == 0)
+    {
+        for (uint32_t level = 1; level < levelcount; level++)
+        {
+            uint32_t slot = LevelSlot(level, _current);
+            Cascade(slot);
+            if (slot != rootsize + (level - 1) * levelsize)
+                break;
+        }
+    }
+
+    while (_slots[root] != NIL)
+    {
+        uint32_t index = _slots[root];
+        Unlink(index);
+        Node &node = _nodes[index];
+        if (node.interval)
+        {
+            expired.emplace_back(node.callback);
+            node.expire = _current + node.interval;
+            Link(index);
+        }
+        else
+        {
+            expired.emplace_back(std::move(node.callback));
+            Free(index);
+        }
+    }
+    _current++;
+}
+
+// 按单调时钟计算应处理的tick数，timerfd的唤醒次数只作为节拍，错过的tick在下次唤醒时补齐
+void TimingWheel::Run()
+{
+    auto start = std::chrono::steady_clock::now();
+    uint64_t processed = 0;
+    while (_running)
+    {
+        uint64_t expirations = 0;
+        if (read(_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+            continue;
+
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        uint64_t target = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() / _tickms;
+        if (target > processed)
+        {
+            Advance(target - processed);
+            processed = target;
+        }
+    }
+}
@@ -0,0 +1,286 @@
+#include "TransferScheduler.h"
+
+constexpr int64_t dispatchintervalms = 10;
+constexpr int64_t statsintervalms = 1000;
+constexpr double burstseconds = 0.1; // 令牌桶容量，允许的突发时长
+
+static int64_t GetTimestampMilliseconds()
+{
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+}
+
+void TransferScheduler::TokenBucket::Refill(double seconds)
+{
+    if (rate == 0)
+        return;
+    tokens = std::min(tokens + rate * seconds, rate * burstseconds);
+}
+
+// 允许透支：分片可能大于桶容量，只要余额为正就放行，欠下的额度由之后的补充偿还
+bool TransferScheduler::TokenBucket::Available() const
+{
+    return rate == 0 || tokens > 0;
+}
+
+void TransferScheduler::TokenBucket::Consume(uint64_t bytes)
+{
+    if (rate != 0)
+        tokens -= bytes;
+}
+
+TransferScheduler *TransferScheduler::Instance()
+{
+    static TransferScheduler *instance = new TransferScheduler();
+    return instance;
+}
+
+TransferScheduler::TransferScheduler()
+{
+    _lastrefill = GetTimestampMilliseconds();
+    _laststats = _lastrefill;
+    DispatchTimer = TIMINGWHEEL->Schedule(dispatchintervalms,
+                                          std::bind(&TransferScheduler::Dispatch, this),
+                                          dispatchintervalms);
+}
+
+TransferScheduler::~TransferScheduler()
+{
+    TIMINGWHEEL->Cancel(DispatchTimer);
+}
+
+void TransferScheduler::SetRateLimit(TransferDirection direction, uint64_t globalrate, uint64_t userrate)
+{
+    LockGuard guard(_lock);
+    DirectionLimit &limit = Limit(direction);
+    limit.global.rate = globalrate;
+    limit.global.tokens = 0;
+    limit.userrate = userrate;
+    for (auto &pair : limit.users)
+    {
+        pair.second.rate = userrate;
+        pair.second.tokens = 0;
+    }
+}
+
+// 小文件权重更高，避免被大文件的持续传输饿死；图片通常用于聊天内的即时显示，再翻倍
+uint32_t TransferScheduler::FlowWeight(uint64_t filesize, const std::string &filepath)
+{
+    const uint64_t MB = 1024 * 1024;
+
+    uint32_t weight = 1;
+    if (filesize <= 1 * MB)
+        weight = 8;
+    else if (filesize <= 16 * MB)
+        weight = 4;
+    else if (filesize <= 256 * MB)
+        weight = 2;
+
+    static const std::vector<std::string> pictureexts{".png", ".jpg", ".jpeg", ".gif", ".bmp", ".webp"};
+    size_t pos = filepath.find_last_of('.');
+    if (pos != std::string::npos)
+    {
+        std::string ext = filepath.substr(pos);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (std::find(pictureexts.begin(), pictureexts.end(), ext) != pictureexts.end())
+            weight *= 2;
+    }
+    return weight;
+}
+
+void TransferScheduler::AddFlow(const std::string &taskid, const std::string &token, TransferDirection direction,
+                                uint64_t filesize, const std::string &filepath, std::function<void()> resume)
+{
+    LockGuard guard(_lock);
+    TransferFlow flow;
+    flow.taskid = taskid;
+    flow.token = token;
+    flow.direction = direction;
+    flow.weight = FlowWeight(filesize, filepath);
+    flow.vtime = Limit(direction).vclock;
+    flow.resume = resume;
+    _flows[taskid] = flow;
+}
+
+void TransferScheduler::RemoveFlow(const std::string &taskid)
+{
+    LockGuard guard(_lock);
+    _flows.erase(taskid);
+}
+
+bool TransferScheduler::Acquire(const std::string &taskid, uint64_t bytes)
+{
+    LockGuard guard(_lock);
+    auto it = _flows.find(taskid);
+    if (it == _flows.end()) // 未登记的任务不受调度
+        return true;
+
+    TransferFlow &flow = it->second;
+    if (flow.credit > 0)
+    {
+        flow.credit = flow.credit > bytes ? flow.credit - bytes : 0;
+        return true;
+    }
+
+    Refill();
+    DirectionLimit &limit = Limit(flow.direction);
+
+    // 已有流在排队时，新的申请也须排队，由Dispatch按虚拟时间决定先后
+    bool queued = false;
+    for (auto &pair : _flows)
+    {
+        TransferFlow &other = pair.second;
+        if (other.waiting && other.direction == flow.direction &&
+            (limit.global.rate != 0 || other.token == flow.token))
+        {
+            queued = true;
+            break;
+        }
+    }
+
+    if (!queued && HasBudget(limit, flow.token))
+    {
+        Charge(flow, bytes);
+        return true;
+    }
+
+    // 接收方向每个分片都已落盘，等待的字节数累加；发送方向只有下一个分片在等待
+    if (flow.waiting && flow.direction == TransferDirection::INBOUND)
+        flow.pendingbytes += bytes;
+    else
+        flow.pendingbytes = bytes;
+    flow.waiting = true;
+    return false;
+}
+
+bool TransferScheduler::GetFlowStats(const std::string &taskid, TransferFlowStats &stats)
+{
+    LockGuard guard(_lock);
+    auto it = _flows.find(taskid);
+    if (it == _flows.end())
+        return false;
+
+    const TransferFlow &flow = it->second;
+    stats = TransferFlowStats{flow.taskid, flow.token, flow.direction, flow.weight, flow.rate};
+    return true;
+}
+
+std::vector<TransferFlowStats> TransferScheduler::GetAllFlowStats()
+{
+    LockGuard guard(_lock);
+    std::vector<TransferFlowStats> result;
+    for (auto &pair : _flows)
+    {
+        const TransferFlow &flow = pair.second;
+        result.emplace_back(TransferFlowStats{flow.taskid, flow.token, flow.direction, flow.weight, flow.rate});
+    }
+    return result;
+}
+
+TransferScheduler::DirectionLimit &TransferScheduler::Limit(TransferDirection direction)
+{
+    return _limits[direction == TransferDirection::OUTBOUND ? 0 : 1];
+}
+
+TransferScheduler::TokenBucket &TransferScheduler::UserBucket(DirectionLimit &limit, const std::string &token)
+{
+    auto it = limit.users.find(token);
+    if (it == limit.users.end())
+    {
+        TokenBucket bucket;
+        bucket.rate = limit.userrate;
+        it = limit.users.emplace(token, bucket).first;
+    }
+    return it->second;
+}
+
+bool TransferScheduler::HasBudget(DirectionLimit &limit, const std::string &token)
+{
+    return limit.global.Available() && UserBucket(limit, token).Available();
+}
+
+// 起始虚拟时间取流自身与系统虚拟时钟的较大值，空闲后重新活跃的流不会积攒优先权
+void TransferScheduler::Charge(TransferFlow &flow, uint64_t bytes)
+{
+    DirectionLimit &limit = Limit(flow.direction);
+    limit.global.Consume(bytes);
+    UserBucket(limit, flow.token).Consume(bytes);
+
+    double start = std::max(flow.vtime, limit.vclock);
+    flow.vtime = start + (double)bytes / flow.weight;
+    limit.vclock = start;
+    flow.grantedbytes += bytes;
+}
+
+void TransferScheduler::Refill()
+{
+    int64_t now = GetTimestampMilliseconds();
+    double seconds = (now - _lastrefill) / 1000.0;
+    if (seconds <= 0)
+        return;
+    _lastrefill = now;
+
+    for (auto &limit : _limits)
+    {
+        limit.global.Refill(seconds);
+        for (auto &pair : limit.users)
+            pair.second.Refill(seconds);
+    }
+}
+
+void TransferScheduler::Dispatch()
+{
+    std::vector<std::function<void()>> callbacks;
+    {
+        LockGuard guard(_lock);
+        Refill();
+
+        int64_t now = GetTimestampMilliseconds();
+        if (now - _laststats >= statsintervalms)
+        {
+            double seconds = (now - _laststats) / 1000.0;
+            for (auto &pair : _flows)
+            {
+                TransferFlow &flow = pair.second;
+                flow.rate = flow.rate * 0.5 + (flow.grantedbytes / seconds) * 0.5;
+                flow.grantedbytes = 0;
+            }
+            _laststats = now;
+        }
+
+        // 每轮选出有预算且起始虚拟时间最小的等待流，直到没有可调度的流
+        while (true)
+        {
+            TransferFlow *next = nullptr;
+            double nextstart = 0;
+            for (auto &pair : _flows)
+            {
+                TransferFlow &flow = pair.second;
+                if (!flow.waiting)
+                    continue;
+                DirectionLimit &limit = Limit(flow.direction);
+                if (!HasBudget(limit, flow.token))
+                    continue;
+                double start = std::max(flow.vtime, limit.vclock);
+                if (!next || start < nextstart)
+                {
+                    next = &flow;
+                    nextstart = start;
+                }
+            }
+            if (!next)
+                break;
+
+            Charge(*next, next->pendingbytes);
+            if (next->direction == TransferDirection::OUTBOUND) // 发送端恢复后会重新申请，由credit抵扣
+                next->credit += next->pendingbytes;
+            next->waiting = false;
+            next->pendingbytes = 0;
+            if (next->resume)
+                callbacks.emplace_back(next->resume);
+        }
+    }
+
+    for (auto &callback : callbacks)
+        callback();
+}
@@ -4,6 +4,8 @@
 #include "MsgManager.h"
 #include "MessageRecordStore.h"
 #include "FileTransManager.h"
+#include "FileIOUring.h"
+#include "TransferScheduler.h"
 
 void signal_handler(int sig)
 {
@@ -38,6 +40,20 @@ int main()
     MESSAGERECORDSTORE->SetEnable(true);
     // 文件传输系统注入用户管理，用以校验用户请求
     FILETRANSMANAGER->SetLoginUserManager(&LoginUserHost);
+    // 文件分片发送窗口，同时在途的最大分片数
+    SetTransferWindowSize(8);
+    // 发送文件时根据RTT与吞吐动态调整分片大小
+    SetChunkSizePolicyType(ChunkSizePolicyType::ADAPTIVE);
+    // 文件异步读写，初始化失败时退化为同步读写
+    FILEIOURING->Init();
+    // 文件传输限速(字节/秒)，依次为全局与单用户上限，0表示不限速；限速生效时按权重在任务间公平分配
+    TRANSFERSCHEDULER->SetRateLimit(TransferDirection::OUTBOUND, 0, 0);
+    TRANSFERSCHEDULER->SetRateLimit(TransferDirection::INBOUND, 0, 0);
+
+    // 文件传输消息按会话分配到多个处理线程，0表示按CPU核数
+    ConnectHost.SetSessionLoops(0);
+    // 连续30秒未收到数据时发送心跳，90秒仍无数据视为死连接并断开，回收其用户、发送队列与传输任务
+    ConnectHost.SetIdlePolicy(IdlePolicy{30000, 90000});
 
     std::string IP = "192.168.58.130";
     int port = 8888;
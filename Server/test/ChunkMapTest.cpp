@@ -0,0 +1,162 @@
+#include "FileTransferTask.h"
+#include "TestHelper.h"
+
+// 区间表有序、不重叠、不相邻，且index与位置一致
+static bool IsNormalized(const vector<FileTransferChunkInfo> &chunks)
+{
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        if (chunks[i].index != (int)i || chunks[i].range_left > chunks[i].range_right)
+            return false;
+        if (i > 0 && chunks[i - 1].range_right + 1 >= chunks[i].range_left)
+            return false;
+    }
+    return true;
+}
+
+static void TestInsertDisjoint()
+{
+    vector<FileTransferChunkInfo> chunks;
+    insertChunk(chunks, 100, 199);
+    insertChunk(chunks, 300, 399);
+    insertChunk(chunks, 0, 49); // 插入到最前，其后区间的index随之后移
+    TEST_CHECK(chunks.size() == 3);
+    TEST_CHECK(chunks[0].range_left == 0 && chunks[1].range_left == 100 && chunks[2].range_left == 300);
+    TEST_CHECK(IsNormalized(chunks));
+}
+
+static void TestInsertMerge()
+{
+    vector<FileTransferChunkInfo> chunks;
+    insertChunk(chunks, 0, 9);
+    insertChunk(chunks, 20, 29);
+    insertChunk(chunks, 40, 49);
+    insertChunk(chunks, 60, 69);
+
+    // 相邻的区间合并
+    insertChunk(chunks, 10, 19);
+    TEST_CHECK(chunks.size() == 3);
+    TEST_CHECK(chunks[0].range_left == 0 && chunks[0].range_right == 29);
+    TEST_CHECK(IsNormalized(chunks));
+
+    // 跨越多个区间的重叠合并为一个
+    insertChunk(chunks, 25, 65);
+    TEST_CHECK(chunks.size() == 1);
+    TEST_CHECK(chunks[0].range_left == 0 && chunks[0].range_right == 69);
+
+    // 已包含的区间不改变区间表
+    insertChunk(chunks, 5, 15);
+    TEST_CHECK(chunks.size() == 1 && chunks[0].range_right == 69);
+    TEST_CHECK(IsNormalized(chunks));
+}
+
+static void TestInsertMiddleReindex()
+{
+    vector<FileTransferChunkInfo> chunks;
+    for (uint64_t i = 0; i < 5; i++)
+        insertChunk(chunks, i * 100, i * 100 + 9);
+
+    insertChunk(chunks, 150, 159);
+    TEST_CHECK(chunks.size() == 6);
+    TEST_CHECK(IsNormalized(chunks));
+
+    insertChunk(chunks, 120, 299); // 覆盖[150,159]、[200,209]并与[300,309]相邻，之后的区间前移
+    TEST_CHECK(chunks.size() == 4);
+    TEST_CHECK(chunks[1].range_left == 100 && chunks[1].range_right == 109);
+    TEST_CHECK(chunks[2].range_left == 120 && chunks[2].range_right == 309);
+    TEST_CHECK(IsNormalized(chunks));
+
+    insertChunk(chunks, 110, 119); // 两侧相邻，三个区间合并为一个
+    TEST_CHECK(chunks.size() == 3);
+    TEST_CHECK(chunks[1].range_left == 100 && chunks[1].range_right == 309);
+    TEST_CHECK(IsNormalized(chunks));
+}
+
+static void TestUntransferred()
+{
+    vector<FileTransferChunkInfo> chunks;
+    insertChunk(chunks, 10, 19);
+    insertChunk(chunks, 30, 39);
+    vector<FileTransferChunkInfo> untransferred = getUntransferredChunks(chunks, 50);
+    TEST_CHECK(untransferred.size() == 3);
+    TEST_CHECK(untransferred[0].range_left == 0 && untransferred[0].range_right == 9);
+    TEST_CHECK(untransferred[1].range_left == 20 && untransferred[1].range_right == 29);
+    TEST_CHECK(untransferred[2].range_left == 40 && untransferred[2].range_right == 49);
+}
+
+static void TestEncodeDecode()
+{
+    vector<FileTransferChunkInfo> chunks;
+    insertChunk(chunks, 0, 1023);
+    insertChunk(chunks, 4096, 8191);
+    insertChunk(chunks, (uint64_t)1 << 40, ((uint64_t)1 << 40) + 99);
+
+    Buffer buf;
+    EncodeChunkMap(chunks, buf);
+    TEST_CHECK(buf.Length() == sizeof(uint32_t) + chunks.size() * sizeof(uint64_t) * 2);
+
+    buf.Seek(0);
+    vector<FileTransferChunkInfo> decoded;
+    TEST_CHECK(DecodeChunkMap(buf, decoded));
+    TEST_CHECK(decoded.size() == chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++)
+        TEST_CHECK(decoded[i].range_left == chunks[i].range_left && decoded[i].range_right == chunks[i].range_right);
+    TEST_CHECK(IsNormalized(decoded));
+
+    // 空表
+    Buffer empty;
+    EncodeChunkMap({}, empty);
+    empty.Seek(0);
+    TEST_CHECK(DecodeChunkMap(empty, decoded) && decoded.empty());
+}
+
+static void TestDecodeInvalid()
+{
+    vector<FileTransferChunkInfo> chunks{FileTransferChunkInfo(0, 0, 9)};
+
+    // 数量声明超出实际数据
+    Buffer truncated;
+    uint32_t count = 2;
+    truncated.Write(&count, sizeof(count));
+    uint64_t left = 0, right = 9;
+    truncated.Write(&left, sizeof(left));
+    truncated.Write(&right, sizeof(right));
+    truncated.Seek(0);
+    TEST_CHECK(!DecodeChunkMap(truncated, chunks));
+
+    // 左端大于右端
+    Buffer reversed;
+    count = 1;
+    left = 10;
+    right = 0;
+    reversed.Write(&count, sizeof(count));
+    reversed.Write(&left, sizeof(left));
+    reversed.Write(&right, sizeof(right));
+    reversed.Seek(0);
+    TEST_CHECK(!DecodeChunkMap(reversed, chunks));
+
+    // 解码失败不修改输出
+    TEST_CHECK(chunks.size() == 1 && chunks[0].range_right == 9);
+
+    // 乱序、重叠的区间解码后合并
+    Buffer unordered;
+    count = 3;
+    unordered.Write(&count, sizeof(count));
+    uint64_t ranges[] = {50, 59, 0, 9, 5, 20};
+    unordered.Write(ranges, sizeof(ranges));
+    unordered.Seek(0);
+    TEST_CHECK(DecodeChunkMap(unordered, chunks));
+    TEST_CHECK(chunks.size() == 2 && chunks[0].range_right == 20 && chunks[1].range_left == 50);
+    TEST_CHECK(IsNormalized(chunks));
+}
+
+int main()
+{
+    RUN_TEST(TestInsertDisjoint);
+    RUN_TEST(TestInsertMerge);
+    RUN_TEST(TestInsertMiddleReindex);
+    RUN_TEST(TestUntransferred);
+    RUN_TEST(TestEncodeDecode);
+    RUN_TEST(TestDecodeInvalid);
+    return 0;
+}
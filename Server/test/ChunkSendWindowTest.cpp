@@ -0,0 +1,131 @@
+#include "FileTransferTask.h"
+#include "TestHelper.h"
+
+static BaseNetWorkSession *const sessionA = reinterpret_cast<BaseNetWorkSession *>(0x10);
+static BaseNetWorkSession *const sessionB = reinterpret_cast<BaseNetWorkSession *>(0x20);
+
+static void TestInOrderAck()
+{
+    ChunkSendWindow window;
+    window.Reset(4);
+    for (uint64_t i = 0; i < 4; i++)
+        window.Add(i * 10, i * 10 + 9, 100, sessionA);
+    TEST_CHECK(window.IsFull());
+
+    vector<FileTransferChunkInfo> acked{FileTransferChunkInfo(0, 0, 19)};
+    vector<int64_t> rtts;
+    window.Release(acked, 150, [&](uint64_t chunksize, int64_t rttms)
+                   { TEST_CHECK(chunksize == 10); rtts.emplace_back(rttms); });
+    TEST_CHECK(rtts.size() == 2 && rtts[0] == 50 && rtts[1] == 50);
+    TEST_CHECK(window.InflightCount() == 2);
+    TEST_CHECK(!window.IsFull());
+}
+
+static void TestOutOfOrderAck()
+{
+    ChunkSendWindow window;
+    window.Reset(3);
+    window.Add(0, 9, 0, sessionA);
+    window.Add(10, 19, 0, sessionB);
+    window.Add(20, 29, 0, sessionA);
+
+    // 只确认中间的分片，两侧仍在途，填充窗口时排除
+    vector<FileTransferChunkInfo> acked{FileTransferChunkInfo(0, 10, 19)};
+    int released = 0;
+    window.Release(acked, 10, [&](uint64_t, int64_t)
+                   { released++; });
+    TEST_CHECK(released == 1);
+    TEST_CHECK(window.InflightCount() == 2);
+
+    vector<FileTransferChunkInfo> occupied = acked;
+    window.AppendInflight(occupied);
+    TEST_CHECK(getUntransferredChunks(occupied, 40).size() == 1);
+    TEST_CHECK(getUntransferredChunks(occupied, 40)[0].range_left == 30);
+
+    // 部分覆盖不视为确认
+    window.Release({FileTransferChunkInfo(0, 0, 5)}, 20, nullptr);
+    TEST_CHECK(window.InflightCount() == 2);
+}
+
+static void TestTimeout()
+{
+    ChunkSendWindow window;
+    window.Reset(2);
+    TEST_CHECK(window.NextDeadline(1000) == -1);
+    window.Add(0, 9, 0, sessionA);
+    window.Add(10, 19, 500, sessionA);
+    TEST_CHECK(window.NextDeadline(1000) == 1000);
+
+    vector<uint64_t> resent;
+    auto resend = [&](uint64_t left, uint64_t) -> BaseNetWorkSession *
+    {
+        resent.emplace_back(left);
+        return sessionB;
+    };
+    TEST_CHECK(window.RetransmitExpired(999, 1000, resend) == 0);
+    TEST_CHECK(window.RetransmitExpired(1000, 1000, resend) == 1);
+    TEST_CHECK(resent.size() == 1 && resent[0] == 0);
+    TEST_CHECK(window.NextDeadline(1000) == 1500);
+
+    // 重传过的分片不参与RTT采样
+    int64_t rtt = 0;
+    window.Release({FileTransferChunkInfo(0, 0, 9)}, 1200, [&](uint64_t, int64_t rttms)
+                   { rtt = rttms; });
+    TEST_CHECK(rtt == -1);
+
+    // 发送失败时返回-1
+    TEST_CHECK(window.RetransmitExpired(5000, 1000, [](uint64_t, uint64_t) -> BaseNetWorkSession *
+                                        { return nullptr; }) == -1);
+}
+
+static void TestExpire()
+{
+    ChunkSendWindow window;
+    window.Reset(4);
+    window.Add(0, 9, 100, sessionA);
+    window.Add(10, 19, 100, sessionB);
+    window.Add(20, 29, 100, sessionB);
+
+    // 会话退出分条后其上的分片立即超时，改由其他会话重发
+    window.ExpireSession(sessionB);
+    TEST_CHECK(window.NextDeadline(1000) == 0);
+    vector<uint64_t> resent;
+    TEST_CHECK(window.RetransmitExpired(100, 1000, [&](uint64_t left, uint64_t) -> BaseNetWorkSession *
+                                        { resent.emplace_back(left); return sessionA; }) == 2);
+    TEST_CHECK(resent.size() == 2 && resent[0] == 10 && resent[1] == 20);
+    TEST_CHECK(window.NextDeadline(1000) == 1100);
+
+    // 分片哈希校验失败时只重发该分片
+    window.ExpireRange(0, 9);
+    resent.clear();
+    TEST_CHECK(window.RetransmitExpired(100, 1000, [&](uint64_t left, uint64_t) -> BaseNetWorkSession *
+                                        { resent.emplace_back(left); return sessionA; }) == 1);
+    TEST_CHECK(resent.size() == 1 && resent[0] == 0);
+}
+
+static void TestStopAndWait()
+{
+    ChunkSendWindow window;
+    window.Reset(0);
+    TEST_CHECK(window.WindowSize() == 1);
+
+    // 每次只有一个在途分片，确认后才能发送下一个
+    for (uint64_t i = 0; i < 3; i++)
+    {
+        TEST_CHECK(!window.IsFull());
+        window.Add(i * 10, i * 10 + 9, i, sessionA);
+        TEST_CHECK(window.IsFull());
+        window.Release({FileTransferChunkInfo(0, 0, i * 10 + 9)}, i + 1, nullptr);
+        TEST_CHECK(window.InflightCount() == 0);
+    }
+}
+
+int main()
+{
+    RUN_TEST(TestInOrderAck);
+    RUN_TEST(TestOutOfOrderAck);
+    RUN_TEST(TestTimeout);
+    RUN_TEST(TestExpire);
+    RUN_TEST(TestStopAndWait);
+    return 0;
+}
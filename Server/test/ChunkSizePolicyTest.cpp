@@ -0,0 +1,97 @@
+#include "FileTransferTask.h"
+#include "TestHelper.h"
+
+constexpr uint64_t KB = 1024;
+constexpr uint64_t MB = 1024 * 1024;
+
+static void TestClamp()
+{
+    TEST_CHECK(AdaptiveChunkSizePolicy(1, 4).ChunkSize() == 64 * KB);
+    TEST_CHECK(AdaptiveChunkSizePolicy(100 * MB, 4).ChunkSize() == 8 * MB);
+    // 在途数据总量受限，窗口越大单个分片越小
+    TEST_CHECK(AdaptiveChunkSizePolicy(100 * MB, 64).ChunkSize() == 1 * MB);
+    TEST_CHECK(AdaptiveChunkSizePolicy(100 * MB, 0).ChunkSize() == 8 * MB);
+}
+
+static void TestGrowOnFastLink()
+{
+    // 每10ms确认1MB，RTT 100ms，带宽时延积约10MB，窗口4时目标约5MB
+    AdaptiveChunkSizePolicy policy(64 * KB, 4);
+    int64_t now = 1000;
+    uint64_t last = policy.ChunkSize();
+    for (int i = 0; i < 200; i++)
+    {
+        now += 10;
+        policy.OnChunkAcked(MB, 100, now);
+        uint64_t size = policy.ChunkSize();
+        TEST_CHECK(size >= last && size <= last * 2); // 每次调整不超过两倍
+        last = size;
+    }
+    TEST_CHECK(last > 4 * MB && last <= 8 * MB);
+}
+
+static void TestShrinkOnSlowLink()
+{
+    // 每100ms确认64KB，带宽时延积远小于最小分片
+    AdaptiveChunkSizePolicy policy(4 * MB, 4);
+    int64_t now = 1000;
+    uint64_t last = policy.ChunkSize();
+    for (int i = 0; i < 50; i++)
+    {
+        now += 100;
+        policy.OnChunkAcked(64 * KB, 100, now);
+        uint64_t size = policy.ChunkSize();
+        TEST_CHECK(size <= last && size >= last / 2); // 每次调整不低于一半
+        last = size;
+    }
+    TEST_CHECK(last == 64 * KB);
+}
+
+static void TestTimeout()
+{
+    AdaptiveChunkSizePolicy policy(1 * MB, 4);
+    policy.OnChunkTimeout();
+    TEST_CHECK(policy.ChunkSize() == 512 * KB);
+    for (int i = 0; i < 10; i++)
+        policy.OnChunkTimeout();
+    TEST_CHECK(policy.ChunkSize() == 64 * KB);
+}
+
+static void TestRetransmittedSamples()
+{
+    // 重传分片的确认不参与RTT采样，没有RTT时不调整分片大小
+    AdaptiveChunkSizePolicy policy(1 * MB, 4);
+    int64_t now = 1000;
+    for (int i = 0; i < 50; i++)
+    {
+        now += 100;
+        policy.OnChunkAcked(64 * KB, -1, now);
+    }
+    TEST_CHECK(policy.ChunkSize() == 1 * MB);
+}
+
+static void TestCreatePolicy()
+{
+    SetChunkSizePolicyType(ChunkSizePolicyType::FIXED);
+    std::unique_ptr<ChunkSizePolicy> fixed = CreateChunkSizePolicy(3 * MB, 4);
+    fixed->OnChunkTimeout();
+    fixed->OnChunkAcked(3 * MB, 10, 1000);
+    TEST_CHECK(fixed->ChunkSize() == 3 * MB);
+
+    SetChunkSizePolicyType(ChunkSizePolicyType::ADAPTIVE);
+    std::unique_ptr<ChunkSizePolicy> adaptive = CreateChunkSizePolicy(3 * MB, 4);
+    adaptive->OnChunkTimeout();
+    TEST_CHECK(adaptive->ChunkSize() < 3 * MB);
+    SetChunkSizePolicyType(ChunkSizePolicyType::FIXED);
+}
+
+int main()
+{
+    RUN_TEST(TestClamp);
+    RUN_TEST(TestGrowOnFastLink);
+    RUN_TEST(TestShrinkOnSlowLink);
+    RUN_TEST(TestTimeout);
+    RUN_TEST(TestRetransmittedSamples);
+    RUN_TEST(TestCreatePolicy);
+    return 0;
+}
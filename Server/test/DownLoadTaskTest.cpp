@@ -0,0 +1,323 @@
+#include "FileTransferDownLoadTask.h"
+#include "MessagePackage.h"
+#include "MD5Helper.h"
+#include "TestHelper.h"
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
+
+constexpr uint64_t ChunkSize = 256 * 1024;
+constexpr uint64_t FileSize = ChunkSize * 40 + 1234;
+const std::string TaskId = "DownLoadTaskTest";
+
+// 代替真实连接，记录任务发出的消息
+class FakeSession : public BaseNetWorkSession
+{
+public:
+    virtual bool AsyncSend(const Buffer &buffer)
+    {
+        Buffer buf((const char *)buffer.Data(), buffer.Length());
+        MessagePackage package;
+        if (!AnalysisMessagePackageFromBuffer(&buf, &package))
+            return false;
+        LockGuard guard(_lock);
+        _sent.emplace_back(package.nlmjson);
+        return true;
+    }
+    virtual bool TryHandshake(uint32_t timeOutMs) { return true; }
+    virtual Task<bool> TryHandshakeAsync(uint32_t timeOutMs) { co_return true; }
+    virtual CheckHandshakeStatus CheckHandshakeTryMsg(Buffer &buffer) { return CheckHandshakeStatus::Success; }
+    virtual CheckHandshakeStatus CheckHandshakeConfirmMsg(Buffer &buffer) { return CheckHandshakeStatus::Success; }
+
+    json Last()
+    {
+        LockGuard guard(_lock);
+        return _sent.empty() ? json() : _sent.back();
+    }
+
+    int Count(int command)
+    {
+        LockGuard guard(_lock);
+        int count = 0;
+        for (auto &js : _sent)
+        {
+            if (js.contains("command") && js["command"] == command)
+                count++;
+        }
+        return count;
+    }
+
+protected:
+    virtual bool OnSessionClose() { return true; }
+    virtual bool OnRecvData(Buffer *buffer) { return true; }
+    virtual void OnBindRecvDataCallBack() {}
+    virtual void OnBindSessionCloseCallBack() {}
+
+private:
+    CriticalSectionLock _lock;
+    std::vector<json> _sent;
+};
+
+static std::string TestFilePath()
+{
+    return fmt::format("/tmp/ChataApp_DownLoadTaskTest_{}", getpid());
+}
+
+static void RemoveFiles(const std::string &path)
+{
+    for (auto &file : {path, path + "__chunks", path + "__check", path + "__check__tmp"})
+    {
+        if (FileIOHandler::Exists(file))
+            FileIOHandler::Remove(file);
+    }
+}
+
+static std::vector<char> RandomData(uint64_t length)
+{
+    std::mt19937 rng(1);
+    std::vector<char> data(length);
+    for (auto &c : data)
+        c = (char)rng();
+    return data;
+}
+
+static void SendTransReq(FileTransferDownLoadTask &task, FakeSession &session)
+{
+    json js;
+    js["command"] = 7000;
+    js["taskid"] = TaskId;
+    js["filesize"] = FileSize;
+    js["filename"] = "file";
+    Buffer buf;
+    task.ProcessMsg(&session, js, buf);
+}
+
+static void SendChunk(FileTransferDownLoadTask &task, FakeSession &session, const std::vector<char> &data, uint64_t left, uint64_t right)
+{
+    json js;
+    js["command"] = 7001;
+    js["taskid"] = TaskId;
+    js["chunk_size"] = right - left + 1;
+    js["range"] = json::array({left, right});
+    Buffer buf(data.data() + left, right - left + 1);
+    task.ProcessMsg(&session, js, buf);
+}
+
+static void SendInterrupt(FileTransferDownLoadTask &task, FakeSession &session)
+{
+    json js;
+    js["command"] = 7070;
+    js["taskid"] = TaskId;
+    Buffer buf;
+    task.ProcessMsg(&session, js, buf);
+}
+
+static bool ReadCheckPoint(const std::string &path, MD5CheckPointRecord &record)
+{
+    FileIOHandler file(path + "__check", FileIOHandler::OpenMode::READ_ONLY);
+    if (!file.IsOpen() || file.GetSize() != sizeof(record))
+        return false;
+    return file.Read((char *)&record, sizeof(record)) == sizeof(record);
+}
+
+static bool FileMatches(const std::string &path, const std::vector<char> &data)
+{
+    FileIOHandler file(path, FileIOHandler::OpenMode::READ_ONLY);
+    std::vector<char> content(data.size());
+    return file.GetSize() == (long)data.size() &&
+           file.ReadAt(content.data(), content.size(), 0) == (long)content.size() &&
+           content == data;
+}
+
+// 按顺序接收前received字节后由对端中断，中断时保存__chunks与MD5检查点
+static void ReceiveAndInterrupt(const std::string &path, const std::vector<char> &data, const std::string &md5, uint64_t received)
+{
+    FileTransferDownLoadTask task(TaskId);
+    task.RegisterTransInfo(path, md5, FileSize);
+    bool interrupted = false;
+    task.BindInterruptedCallBack([&](FileTransferDownLoadTask *)
+                                 { interrupted = true; });
+
+    FakeSession session;
+    SendTransReq(task, session);
+    TEST_CHECK(session.Last()["command"] == 8000 && session.Last()["result"] == 1);
+    for (uint64_t left = 0; left < received; left += ChunkSize)
+        SendChunk(task, session, data, left, std::min(left + ChunkSize, received) - 1);
+    SendInterrupt(task, session);
+    TEST_CHECK(interrupted);
+}
+
+// 续传时只发送对端尚未接收的区间，结束后文件完整且记录文件被删除
+static void ResumeAndFinish(const std::string &path, const std::vector<char> &data, const std::string &md5, uint64_t received)
+{
+    FileTransferDownLoadTask task(TaskId);
+    task.RegisterTransInfo(path, md5, FileSize);
+    bool finished = false;
+    task.BindFinishedCallBack([&](FileTransferDownLoadTask *)
+                              { finished = true; });
+
+    FakeSession session;
+    SendTransReq(task, session);
+    json reply = session.Last();
+    TEST_CHECK(reply["command"] == 8000 && reply["result"] == 1);
+
+    std::vector<FileTransferChunkInfo> chunkmap;
+    for (auto &js_chunk : reply["chunk_map"])
+        insertChunk(chunkmap, js_chunk["range"][0], js_chunk["range"][1]);
+    TEST_CHECK(chunkmap.size() == 1 && chunkmap[0].range_left == 0 && chunkmap[0].range_right == received - 1);
+
+    for (auto &chunk : getUntransferredChunks(chunkmap, FileSize))
+    {
+        for (uint64_t left = chunk.range_left; left <= chunk.range_right; left += ChunkSize)
+            SendChunk(task, session, data, left, std::min(left + ChunkSize - 1, chunk.range_right));
+    }
+    TEST_CHECK(finished);
+    TEST_CHECK(session.Last()["command"] == 8010);
+    TEST_CHECK(FileMatches(path, data));
+    TEST_CHECK(!FileIOHandler::Exists(path + "__chunks"));
+    TEST_CHECK(!FileIOHandler::Exists(path + "__check"));
+}
+
+static void TestCheckPointRecord()
+{
+    MD5CheckPointRecord record;
+    record.progress = 40;
+    record.count = 64 * 100;
+    record.cachesize = 10;
+    record.checksum = record.CalcChecksum();
+    TEST_CHECK(record.IsValid());
+
+    // 填充字节也参与校验，按字节复制
+    MD5CheckPointRecord modified;
+    memcpy(&modified, &record, sizeof(record));
+    modified.status[2] ^= 1;
+    TEST_CHECK(!modified.IsValid());
+
+    // cache中的字节数须小于一个分组
+    memcpy(&modified, &record, sizeof(record));
+    modified.cachesize = sizeof(modified.cache);
+    modified.checksum = modified.CalcChecksum();
+    TEST_CHECK(!modified.IsValid());
+
+    memcpy(&modified, &record, sizeof(record));
+    modified.version++;
+    modified.checksum = modified.CalcChecksum();
+    TEST_CHECK(!modified.IsValid());
+}
+
+// 中断时的检查点恢复出的MD5状态与已接收数据一致，续传后文件完整
+static void TestCheckPointResume()
+{
+    std::string path = TestFilePath();
+    RemoveFiles(path);
+    std::vector<char> data = RandomData(FileSize);
+    std::string md5 = MD5Helper::computeMD5(data.data(), data.size());
+    uint64_t received = ChunkSize * 24;
+
+    ReceiveAndInterrupt(path, data, md5, received);
+
+    MD5CheckPointRecord record;
+    TEST_CHECK(ReadCheckPoint(path, record));
+    TEST_CHECK(record.IsValid());
+    TEST_CHECK(record.progress >= 20);
+    TEST_CHECK(record.count % 64 == 0);
+    TEST_CHECK(record.count + record.cachesize > 0);
+    TEST_CHECK(record.count + record.cachesize <= received);
+    TEST_CHECK(!FileIOHandler::Exists(path + "__check__tmp"));
+
+    MD5SnapShot shot;
+    memcpy(shot.status, record.status, sizeof(shot.status));
+    shot.count = record.count;
+    shot.cacheBuffer.Write(record.cache, record.cachesize);
+    AsyncMD5 resumed(shot);
+    uint64_t hashed = record.count + record.cachesize;
+    Buffer rest(data.data() + hashed, data.size() - hashed);
+    resumed.UpdateSync(rest);
+    TEST_CHECK(resumed.Final() == md5);
+
+    ResumeAndFinish(path, data, md5, received);
+    RemoveFiles(path);
+}
+
+// 检查点损坏时丢弃，结束时从文件重新计算MD5
+static void TestCorruptCheckPoint()
+{
+    std::string path = TestFilePath();
+    RemoveFiles(path);
+    std::vector<char> data = RandomData(FileSize);
+    std::string md5 = MD5Helper::computeMD5(data.data(), data.size());
+    uint64_t received = ChunkSize * 30;
+
+    ReceiveAndInterrupt(path, data, md5, received);
+    {
+        FileIOHandler file(path + "__check", FileIOHandler::OpenMode::READ_WRITE);
+        char byte = 0;
+        TEST_CHECK(file.ReadAt(&byte, 1, 20) == 1);
+        byte ^= 0x5A;
+        TEST_CHECK(file.WriteAt(&byte, 1, 20) == 1);
+    }
+
+    ResumeAndFinish(path, data, md5, received);
+    RemoveFiles(path);
+}
+
+// 确认传输后文件预分配到完整大小；乱序到达的分片写入完成后才计入已写入区间，全部写入后结束传输
+static void TestPreallocateAndWriteBehind()
+{
+    std::string path = TestFilePath();
+    RemoveFiles(path);
+    std::vector<char> data = RandomData(FileSize);
+    std::string md5 = MD5Helper::computeMD5(data.data(), data.size());
+
+    FileTransferDownLoadTask task(TaskId);
+    task.RegisterTransInfo(path, md5, FileSize);
+    bool finished = false;
+    task.BindFinishedCallBack([&](FileTransferDownLoadTask *)
+                              { finished = true; });
+    CriticalSectionLock lock;
+    int writtencount = 0;
+    bool fullywritten = false;
+    task.BindWrittenCallBack([&](FileTransferDownLoadTask *t)
+                             {
+        std::vector<FileTransferChunkInfo> written = t->WrittenChunkMap();
+        LockGuard guard(lock);
+        writtencount++;
+        if (written.size() == 1 && written[0].range_left == 0 && written[0].range_right == FileSize - 1)
+            fullywritten = true; });
+
+    FakeSession session;
+    SendTransReq(task, session);
+    TEST_CHECK(session.Last()["command"] == 8000 && session.Last()["result"] == 1);
+    {
+        FileIOHandler file(path, FileIOHandler::OpenMode::READ_ONLY);
+        TEST_CHECK(file.GetSize() == (long)FileSize);
+    }
+
+    std::vector<uint64_t> lefts;
+    for (uint64_t left = 0; left < FileSize; left += ChunkSize)
+        lefts.emplace_back(left);
+    std::shuffle(lefts.begin(), lefts.end(), std::mt19937(2));
+    for (auto left : lefts)
+        SendChunk(task, session, data, left, std::min(left + ChunkSize, FileSize) - 1);
+
+    TEST_CHECK(finished);
+    TEST_CHECK(session.Count(8001) == (int)lefts.size() - 1);
+    TEST_CHECK(session.Last()["command"] == 8010);
+    {
+        LockGuard guard(lock);
+        TEST_CHECK(writtencount == (int)lefts.size());
+        TEST_CHECK(fullywritten);
+    }
+    TEST_CHECK(FileMatches(path, data));
+    RemoveFiles(path);
+}
+
+int main()
+{
+    RUN_TEST(TestCheckPointRecord);
+    RUN_TEST(TestCheckPointResume);
+    RUN_TEST(TestCorruptCheckPoint);
+    RUN_TEST(TestPreallocateAndWriteBehind);
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include "FileIOHandler.h"
+#include "FileIOUring.h"
+#include "TestHelper.h"
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <cstring>
+
+static std::string TestFilePath()
+{
+    return fmt::format("/tmp/ChataApp_FileIOHandlerTest_{}", getpid());
+}
+
+// 超过提交队列容量的一批请求分多次提交，全部完成后WaitAsync返回
+static void TestAsyncWriteRead()
+{
+    std::string path = TestFilePath();
+    FileIOHandler file;
+    TEST_CHECK(file.Open(path, FileIOHandler::OpenMode::READ_WRITE));
+
+    constexpr size_t blocksize = 4096;
+    constexpr size_t blockcount = 512;
+    std::vector<char> data(blocksize * blockcount);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (char)(i * 31 + i / blocksize);
+
+    std::atomic<size_t> written{0};
+    for (size_t i = 0; i < blockcount; i++)
+    {
+        TEST_CHECK(file.WriteAsync(data.data() + i * blocksize, blocksize, i * blocksize, [&](long result)
+                                   { if (result == (long)blocksize) written++; }));
+    }
+    file.SubmitAsync();
+    file.WaitAsync();
+    TEST_CHECK(written == blockcount);
+
+    std::vector<char> readback(data.size());
+    std::atomic<size_t> read{0};
+    for (size_t i = blockcount; i > 0; i--)
+    {
+        size_t index = i - 1;
+        TEST_CHECK(file.ReadAsync(readback.data() + index * blocksize, blocksize, index * blocksize, [&](long result)
+                                  { if (result == (long)blocksize) read++; }));
+    }
+    file.SubmitAsync();
+    file.WaitAsync();
+    TEST_CHECK(read == blockcount);
+    TEST_CHECK(readback == data);
+
+    file.Close();
+    unlink(path.c_str());
+}
+
+// 在完成回调中关闭文件不能等待自身，fd在最后一个请求完成后才关闭
+static void TestCloseInCallback()
+{
+    std::string path = TestFilePath();
+    FileIOHandler file;
+    TEST_CHECK(file.Open(path, FileIOHandler::OpenMode::READ_WRITE));
+
+    char buf[64] = "close in completion callback";
+    std::atomic<int> completed{0};
+    for (int i = 0; i < 4; i++)
+    {
+        TEST_CHECK(file.WriteAsync(buf, sizeof(buf), i * sizeof(buf), [&](long result)
+                                   {
+                                       TEST_CHECK(result == (long)sizeof(buf));
+                                       if (completed++ == 0)
+                                           file.Close(); }));
+    }
+    file.SubmitAsync();
+    file.WaitAsync();
+    TEST_CHECK(completed == 4);
+    TEST_CHECK(!file.IsOpen());
+
+    // 未提交的请求在关闭时取消，回调收到-ECANCELED
+    TEST_CHECK(file.Open(path, FileIOHandler::OpenMode::READ_WRITE));
+    long cancelled = 0;
+    TEST_CHECK(file.ReadAsync(buf, sizeof(buf), 0, [&](long result)
+                              { cancelled = result; }));
+    file.Close();
+    TEST_CHECK(cancelled == -ECANCELED);
+    unlink(path.c_str());
+}
+
+// 多个线程按绝对偏移并发读写同一文件，不影响同步接口的文件位置
+static void TestPositionalReadWrite()
+{
+    std::string path = TestFilePath();
+    FileIOHandler file;
+    TEST_CHECK(file.Open(path, FileIOHandler::OpenMode::READ_WRITE));
+    TEST_CHECK(file.Write("head", 4) == 4);
+
+    constexpr size_t blocksize = 8192;
+    constexpr size_t threadcount = 4;
+    constexpr size_t blocksperthread = 16;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadcount; t++)
+    {
+        threads.emplace_back([&file, t]()
+                             {
+            std::vector<char> block(blocksize);
+            for (size_t i = t; i < threadcount * blocksperthread; i += threadcount)
+            {
+                memset(block.data(), (int)i, blocksize);
+                TEST_CHECK(file.WriteAt(block.data(), blocksize, i * blocksize) == (long)blocksize);
+            }
+            std::vector<char> readback(blocksize);
+            for (size_t i = t; i < threadcount * blocksperthread; i += threadcount)
+            {
+                TEST_CHECK(file.ReadAt(readback.data(), blocksize, i * blocksize) == (long)blocksize);
+                TEST_CHECK(readback[0] == (char)i && readback[blocksize - 1] == (char)i);
+            } });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    TEST_CHECK(file.Seek(FileIOHandler::CURRENT) == 4);
+    TEST_CHECK(file.GetSize() == (long)(threadcount * blocksperthread * blocksize));
+
+    // 读到文件末尾时返回实际读取的字节数
+    long filesize = file.GetSize();
+    char tail[16];
+    TEST_CHECK(file.ReadAt(tail, sizeof(tail), filesize - 10) == 10);
+    TEST_CHECK(file.ReadAt(tail, sizeof(tail), filesize) == 0);
+
+    // Buffer版本写入Position之后，不移动Position
+    Buffer buf;
+    TEST_CHECK(file.ReadAt(buf, blocksize, blocksize) == (long)blocksize);
+    TEST_CHECK(buf.Position() == 0 && buf.Byte()[0] == 1);
+
+    file.Close();
+    TEST_CHECK(file.ReadAt(tail, sizeof(tail), 0) == -1);
+    TEST_CHECK(file.WriteAt(tail, sizeof(tail), 0) == -1);
+    unlink(path.c_str());
+}
+
+int main()
+{
+    FILEIOURING->Init(); // 不支持io_uring时请求在提交线程同步完成，结果相同
+    RUN_TEST(TestAsyncWriteRead);
+    RUN_TEST(TestCloseInCallback);
+    RUN_TEST(TestPositionalReadWrite);
+    FILEIOURING->Stop();
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include "MD5Helper.h"
+#include "AsyncMD5.h"
+#include "TestHelper.h"
+#include <random>
+#include <cstring>
+
+static std::vector<char> RandomData(std::mt19937 &rng, size_t length)
+{
+    std::vector<char> data(length);
+    for (auto &c : data)
+        c = (char)rng();
+    return data;
+}
+
+static void TestKnownDigests()
+{
+    TEST_CHECK(MD5Helper::computeMD5(std::string("")) == "d41d8cd98f00b204e9800998ecf8427e");
+    TEST_CHECK(MD5Helper::computeMD5(std::string("abc")) == "900150983cd24fb0d6963f7d28e17f72");
+    TEST_CHECK(MD5Helper::computeMD5(std::string("The quick brown fox jumps over the lazy dog")) == "9e107d9d372bb6826bd81d3542a419d6");
+}
+
+// 多路计算的每一路与单独用MD5Ctx_Update处理同一分组的结果一致，路数不足或超过向量宽度时同样正确
+static void TestProcessLanes()
+{
+    std::mt19937 rng(1);
+    int width = MD5Helper::MD5LaneWidth();
+    TEST_CHECK(width >= 1);
+
+    for (int count = 1; count <= width * 2 + 1; count++)
+    {
+        std::vector<std::vector<char>> blocks;
+        std::vector<std::shared_ptr<MD5Context>> lanectx, scalarctx;
+        std::vector<MD5LaneBlock> lanes;
+        for (int i = 0; i < count; i++)
+        {
+            blocks.emplace_back(RandomData(rng, 64));
+            lanectx.emplace_back(MD5Helper::MD5Ctx_Init());
+            scalarctx.emplace_back(MD5Helper::MD5Ctx_Init());
+            // 各路起始状态不同
+            for (int k = 0; k < 4; k++)
+                lanectx[i]->status[k] = scalarctx[i]->status[k] = (unsigned int)rng();
+        }
+        for (int i = 0; i < count; i++)
+            lanes.emplace_back(MD5LaneBlock{lanectx[i]->status, (const unsigned char *)blocks[i].data()});
+
+        for (int offset = 0; offset < count; offset += width)
+            MD5Helper::MD5ProcessLanes(lanes.data() + offset, std::min(width, count - offset));
+        for (int i = 0; i < count; i++)
+        {
+            MD5Helper::MD5Ctx_Update(scalarctx[i], (const unsigned char *)blocks[i].data(), 64);
+            TEST_CHECK(memcmp(lanectx[i]->status, scalarctx[i]->status, sizeof(lanectx[i]->status)) == 0);
+        }
+    }
+}
+
+// 多个流并发异步更新，数据按随机大小分段，结果与一次性计算一致
+static void TestConcurrentStreams()
+{
+    constexpr int streamcount = 16;
+    std::mt19937 rng(2);
+
+    std::vector<std::vector<char>> data;
+    std::vector<std::unique_ptr<AsyncMD5>> streams;
+    std::vector<size_t> positions(streamcount, 0);
+    for (int i = 0; i < streamcount; i++)
+    {
+        data.emplace_back(RandomData(rng, 100000 + rng() % 300000));
+        streams.emplace_back(std::make_unique<AsyncMD5>());
+    }
+
+    bool remaining = true;
+    while (remaining)
+    {
+        remaining = false;
+        for (int i = 0; i < streamcount; i++)
+        {
+            size_t left = data[i].size() - positions[i];
+            if (left == 0)
+                continue;
+            size_t length = std::min(left, (size_t)(rng() % 20000 + 1));
+            Buffer piece(data[i].data() + positions[i], length);
+            streams[i]->Update(piece);
+            positions[i] += length;
+            remaining = true;
+        }
+    }
+
+    for (int i = 0; i < streamcount; i++)
+    {
+        TEST_CHECK(streams[i]->Count() == data[i].size());
+        TEST_CHECK(streams[i]->Final() == MD5Helper::computeMD5(data[i].data(), data[i].size()));
+    }
+}
+
+// 中途保存的快照恢复后继续计算，结果不变；快照中的缓存不足一个分组
+static void TestSnapShot()
+{
+    std::mt19937 rng(3);
+    std::vector<char> data = RandomData(rng, 200003);
+    size_t split = 100001;
+
+    AsyncMD5 first;
+    Buffer head(data.data(), split);
+    first.UpdateSync(head);
+    MD5SnapShot shot = first.SnapShot();
+    TEST_CHECK(shot.cacheBuffer.Length() < 64);
+    TEST_CHECK(shot.count + shot.cacheBuffer.Length() == split);
+
+    AsyncMD5 second(shot);
+    Buffer tail(data.data() + split, data.size() - split);
+    second.Update(tail);
+    TEST_CHECK(second.Count() == data.size());
+    TEST_CHECK(second.Final() == MD5Helper::computeMD5(data.data(), data.size()));
+}
+
+int main()
+{
+    RUN_TEST(TestKnownDigests);
+    RUN_TEST(TestProcessLanes);
+    RUN_TEST(TestConcurrentStreams);
+    RUN_TEST(TestSnapShot);
+    return 0;
+}
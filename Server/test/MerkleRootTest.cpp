@@ -0,0 +1,107 @@
+#include "FileTransferTask.h"
+#include "ChunkHashHelper.h"
+#include "TestHelper.h"
+#include <unistd.h>
+
+static std::string TestFilePath()
+{
+    return fmt::format("/tmp/ChataApp_MerkleRootTest_{}", getpid());
+}
+
+static uint64_t HashPair(uint64_t left, uint64_t right)
+{
+    uint64_t pair[2] = {left, right};
+    return ChunkHashHelper::XXH64(pair, sizeof(pair));
+}
+
+static void TestXXH64()
+{
+    // xxHash64官方测试向量，seed为0
+    TEST_CHECK(ChunkHashHelper::XXH64("", 0) == 0xEF46DB3751D8E999ull);
+    TEST_CHECK(ChunkHashHelper::XXH64("a", 1) == 0xD24EC4F1A98C6E5Bull);
+    TEST_CHECK(ChunkHashHelper::XXH64("abc", 3) == 0x44BC2CF5AD770999ull);
+
+    uint64_t hash = 0;
+    TEST_CHECK(ChunkHashHelper::ToHex(0x0123456789ABCDEFull) == "0123456789abcdef");
+    TEST_CHECK(ChunkHashHelper::FromHex("0123456789ABCDEF", hash) && hash == 0x0123456789ABCDEFull);
+    TEST_CHECK(!ChunkHashHelper::FromHex("0123", hash));
+    TEST_CHECK(!ChunkHashHelper::FromHex("0123456789abcdeg", hash));
+}
+
+static void TestMerkleRoot()
+{
+    uint64_t a = 1, b = 2, c = 3, d = 4, e = 5;
+    TEST_CHECK(ChunkHashHelper::MerkleRoot({a}) == a);
+    TEST_CHECK(ChunkHashHelper::MerkleRoot({a, b}) == HashPair(a, b));
+    // 奇数个节点时末尾节点直接提升
+    TEST_CHECK(ChunkHashHelper::MerkleRoot({a, b, c}) == HashPair(HashPair(a, b), c));
+    TEST_CHECK(ChunkHashHelper::MerkleRoot({a, b, c, d}) == HashPair(HashPair(a, b), HashPair(c, d)));
+    TEST_CHECK(ChunkHashHelper::MerkleRoot({a, b, c, d, e}) == HashPair(HashPair(HashPair(a, b), HashPair(c, d)), e));
+    TEST_CHECK(ChunkHashHelper::MerkleRoot({}) == ChunkHashHelper::XXH64(nullptr, 0));
+}
+
+static void TestMerkleTree()
+{
+    MerkleTree tree;
+    tree.Reset(2500, 1000);
+    TEST_CHECK(tree.BlockCount() == 3);
+    TEST_CHECK(tree.BlockLeft(2) == 2000 && tree.BlockRight(2) == 2499);
+
+    // 叶子乱序填入，结果与按顺序计算一致
+    std::vector<uint64_t> leaves{11, 22, 33};
+    tree.SetLeaf(2, leaves[2]);
+    tree.SetLeaf(0, leaves[0]);
+    TEST_CHECK(!tree.IsLeafReady(1));
+    tree.SetLeaf(1, leaves[1]);
+    TEST_CHECK(tree.IsLeafReady(1));
+    TEST_CHECK(tree.Root() == ChunkHashHelper::MerkleRoot(leaves));
+}
+
+static void TestFileMerkleRoot()
+{
+    std::string path = TestFilePath();
+    FileIOHandler file;
+    TEST_CHECK(file.Open(path, FileIOHandler::OpenMode::READ_WRITE));
+    TEST_CHECK(file.Truncate(0));
+
+    // 两个完整块加一个不足一块的尾块
+    uint64_t filesize = MerkleBlockSize * 2 + 12345;
+    std::vector<char> data(filesize);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (char)(i * 131 + i / MerkleBlockSize);
+    TEST_CHECK(file.WriteAt(data.data(), data.size(), 0) == (long)data.size());
+
+    std::vector<uint64_t> leaves;
+    for (uint64_t left = 0; left < filesize; left += MerkleBlockSize)
+        leaves.emplace_back(ChunkHashHelper::XXH64(data.data() + left, std::min(MerkleBlockSize, filesize - left)));
+    uint64_t expected = ChunkHashHelper::MerkleRoot(leaves);
+
+    uint64_t root = 0;
+    TEST_CHECK(ComputeFileMerkleRoot(file, filesize, root) && root == expected);
+    TEST_CHECK(GetFileMerkleRoot(file, filesize, root) && root == expected);
+    TEST_CHECK(GetFileMerkleRoot(file, filesize, root) && root == expected);
+
+    // 文件改变后大小与修改时间不同，缓存失效重新计算
+    data[0] ^= 1;
+    data.push_back(7);
+    TEST_CHECK(file.WriteAt(data.data(), data.size(), 0) == (long)data.size());
+    leaves[0] = ChunkHashHelper::XXH64(data.data(), MerkleBlockSize);
+    leaves[2] = ChunkHashHelper::XXH64(data.data() + MerkleBlockSize * 2, data.size() - MerkleBlockSize * 2);
+    TEST_CHECK(GetFileMerkleRoot(file, data.size(), root) && root == ChunkHashHelper::MerkleRoot(leaves));
+    TEST_CHECK(root != expected);
+
+    // 读取失败
+    TEST_CHECK(!ComputeFileMerkleRoot(file, data.size() + MerkleBlockSize, root));
+
+    file.Close();
+    FileIOHandler::Remove(path);
+}
+
+int main()
+{
+    RUN_TEST(TestXXH64);
+    RUN_TEST(TestMerkleRoot);
+    RUN_TEST(TestMerkleTree);
+    RUN_TEST(TestFileMerkleRoot);
+    return 0;
+}
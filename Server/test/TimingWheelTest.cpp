@@ -0,0 +1,122 @@
+#include "TimingWheel.h"
+#include "TestHelper.h"
+#include <map>
+
+// 未调用Start，由测试以Advance逐tick驱动，tick为1ms时delay即到期的tick
+static void TestCascade()
+{
+    TimingWheel wheel(1);
+    uint64_t now = 0;
+
+    // 覆盖第0层、各层边界与需要多次级联的超时
+    std::vector<uint64_t> delays{0, 1, 255, 256, 257, 300, 16383, 16384, 16385, 70000,
+                                 (1ull << 20) - 1, 1ull << 20, (1ull << 20) + 7, (1ull << 22) + 3};
+    std::map<uint64_t, uint64_t> fired; // delay->触发时已经过的tick
+    for (auto delay : delays)
+        TEST_CHECK(wheel.Schedule(delay, [&, delay]()
+                                  { fired[delay] = now; }) != 0);
+    TEST_CHECK(wheel.Size() == delays.size());
+
+    uint64_t last = delays.back();
+    while (now <= last)
+    {
+        wheel.Advance(1);
+        now++;
+    }
+
+    TEST_CHECK(fired.size() == delays.size());
+    for (auto delay : delays)
+        TEST_CHECK(fired[delay] == delay);
+    TEST_CHECK(wheel.Size() == 0);
+}
+
+static void TestScheduleAfterAdvance()
+{
+    // 当前tick不在槽位边界时，跨层的超时同样准时
+    TimingWheel wheel(1);
+    uint64_t now = 0;
+    wheel.Advance(1000);
+    now = 1000;
+
+    uint64_t firedat = 0;
+    wheel.Schedule(20000, [&]()
+                   { firedat = now; });
+    while (firedat == 0 && now < 30000)
+    {
+        wheel.Advance(1);
+        now++;
+    }
+    TEST_CHECK(firedat == 1000 + 20000);
+}
+
+static void TestCancelAndReschedule()
+{
+    TimingWheel wheel(1);
+    int canceled = 0;
+    int rescheduled = 0;
+    TimingWheel::TimerId a = wheel.Schedule(500, [&]()
+                                            { canceled++; });
+    TimingWheel::TimerId b = wheel.Schedule(500, [&]()
+                                            { rescheduled++; });
+    TEST_CHECK(wheel.Cancel(a));
+    TEST_CHECK(!wheel.Cancel(a));
+    TEST_CHECK(wheel.Reschedule(b, 1000));
+
+    wheel.Advance(600);
+    TEST_CHECK(canceled == 0 && rescheduled == 0);
+    wheel.Advance(500);
+    TEST_CHECK(rescheduled == 1);
+
+    // 已触发的定时器不能再取消，节点复用后旧id失效
+    TEST_CHECK(!wheel.Cancel(b));
+    TimingWheel::TimerId c = wheel.Schedule(10, []() {});
+    TEST_CHECK(c != b);
+    TEST_CHECK(!wheel.Cancel(b));
+    TEST_CHECK(wheel.Cancel(c));
+}
+
+static void TestPeriodic()
+{
+    TimingWheel wheel(10);
+    int count = 0;
+    TimingWheel::TimerId id = wheel.Schedule(15, [&]()
+                                             { count++; }, 100); // 不足一个tick向上取整
+    wheel.Advance(2);
+    TEST_CHECK(count == 0);
+    wheel.Advance(1);
+    TEST_CHECK(count == 1);
+    wheel.Advance(300); // 之后每10个tick一次，跨越第0层的一圈
+    TEST_CHECK(count == 31);
+    TEST_CHECK(wheel.Cancel(id));
+    wheel.Advance(100);
+    TEST_CHECK(count == 31);
+}
+
+static void TestScheduleInCallback()
+{
+    TimingWheel wheel(1);
+    int count = 0;
+    std::function<void()> again = [&]()
+    {
+        if (++count < 3)
+            wheel.Schedule(300, again);
+    };
+    wheel.Schedule(300, again);
+    wheel.Advance(301);
+    TEST_CHECK(count == 1);
+    wheel.Advance(301); // 回调在tick推进后执行，重新添加的定时器从下一个tick起算
+    TEST_CHECK(count == 2);
+    wheel.Advance(301);
+    TEST_CHECK(count == 3);
+    TEST_CHECK(wheel.Size() == 0);
+}
+
+int main()
+{
+    RUN_TEST(TestCascade);
+    RUN_TEST(TestScheduleAfterAdvance);
+    RUN_TEST(TestCancelAndReschedule);
+    RUN_TEST(TestPeriodic);
+    RUN_TEST(TestScheduleInCallback);
+    return 0;
+}